@@ -43,13 +43,27 @@ LOCAL_SRC_FILES := \
 	src/fs.c \
 	src/json.c \
 	src/log.c \
+	src/log-sink.c \
 	src/memory.c \
+	src/pool.c \
+	src/arena.c \
+	src/alloc-debug.c \
+	src/alloc-prof.c \
 	src/proc.c \
 	src/sort.c \
+	src/swap.c \
+	src/utf.c \
 	src/hash.c \
 	src/list.c \
+	src/lock-prof.c \
+	src/buffer.c \
 	src/queue.c \
+	src/vec.c \
 	src/thread.c \
+	src/pacer.c \
+	src/profile.c \
+	src/metrics.c \
+	src/timer.c \
 	src/gfx-gl.c \
 	src/render.c \
 	src/unix/crypto.c \
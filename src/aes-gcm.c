@@ -10,6 +10,8 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "metrics.h"
+
 #if defined(__arm__) || defined(__aarch64__)
 	#include "sse2neon.h"
 #else
@@ -357,8 +359,14 @@ MTY_AESGCM *MTY_AESGCMCreate(const void *key)
 bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
 	void *hash, void *cipherText)
 {
+	MTY_ProfileBegin("MTY_AESGCMEncrypt");
+
 	aes_gcm_full(ctx->k, ctx->H, nonce, cipherText, plainText, cipherText, size, hash);
 
+	MTY_ProfileEnd();
+
+	metrics_encrypted(size);
+
 	return true;
 }
 
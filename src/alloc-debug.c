@@ -0,0 +1,317 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "alloc-debug.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc-prof.h"
+
+#define ALLOC_LIVE       0xA110CA7E
+#define ALLOC_FREED      0xF2EED000
+#define ALLOC_GUARD_BYTE 0xFD
+#define ALLOC_FREED_BYTE 0xDD
+#define ALLOC_QUARANTINE 256
+#define ALLOC_LEAK_LINES 32
+#define ALLOC_FREED_SET  4096
+
+struct alloc_finding {
+	const void *mem;
+	size_t size;
+	const void *site;
+	const char *tag;
+	bool freed;
+};
+
+struct alloc_freed {
+	const struct alloc_header *hdr;
+	size_t size;
+	const void *site;
+};
+
+static MTY_Atomic32 ALLOC_DEBUG_LOCK;
+static struct alloc_header *ALLOC_DEBUG_LIVE;
+
+// Freed blocks are held back for a while so that double frees and writes
+// after free can still be recognized
+static struct alloc_header *ALLOC_DEBUG_QUARANTINE[ALLOC_QUARANTINE];
+static uint32_t ALLOC_DEBUG_QPOS;
+
+// Recently freed addresses, checked before touching a header so a double free of a
+// block already released to the system never reads its memory. Direct mapped, so a
+// collision forgets the older address but can never report a false double free
+static struct alloc_freed ALLOC_DEBUG_FREED[ALLOC_FREED_SET];
+
+
+// Blocks
+
+static uint8_t *alloc_debug_mem(struct alloc_header *hdr)
+{
+	return (uint8_t *) hdr + ALLOC_HEADER;
+}
+
+static const char *alloc_debug_tag(struct alloc_header *hdr)
+{
+	const char *tag = alloc_prof_tag_name(hdr->tag);
+
+	return tag ? tag : "untagged";
+}
+
+static bool alloc_debug_guard_ok(struct alloc_header *hdr)
+{
+	uint8_t *guard = alloc_debug_mem(hdr) + hdr->size;
+
+	for (uint32_t x = 0; x < ALLOC_GUARD; x++)
+		if (guard[x] != ALLOC_GUARD_BYTE)
+			return false;
+
+	return true;
+}
+
+static bool alloc_debug_poison_ok(struct alloc_header *hdr)
+{
+	uint8_t *mem = alloc_debug_mem(hdr);
+
+	for (size_t x = 0; x < hdr->size; x++)
+		if (mem[x] != ALLOC_FREED_BYTE)
+			return false;
+
+	return true;
+}
+
+static void alloc_debug_finding(struct alloc_finding *f, struct alloc_header *hdr)
+{
+	f->mem = alloc_debug_mem(hdr);
+	f->size = hdr->size;
+	f->site = hdr->site;
+	f->tag = alloc_debug_tag(hdr);
+	f->freed = false;
+}
+
+static struct alloc_freed *alloc_debug_freed(const struct alloc_header *hdr)
+{
+	uintptr_t h = (uintptr_t) hdr >> 4;
+
+	return &ALLOC_DEBUG_FREED[(h ^ (h >> 12)) % ALLOC_FREED_SET];
+}
+
+
+// Internal
+
+void alloc_debug_track(struct alloc_header *hdr)
+{
+	hdr->magic = ALLOC_LIVE;
+	memset(alloc_debug_mem(hdr) + hdr->size, ALLOC_GUARD_BYTE, ALLOC_GUARD);
+
+	MTY_GlobalLock(&ALLOC_DEBUG_LOCK);
+
+	// The address is live again, a later free of it is legitimate
+	struct alloc_freed *freed = alloc_debug_freed(hdr);
+
+	if (freed->hdr == hdr)
+		memset(freed, 0, sizeof(struct alloc_freed));
+
+	hdr->prev = NULL;
+	hdr->next = ALLOC_DEBUG_LIVE;
+
+	if (ALLOC_DEBUG_LIVE)
+		ALLOC_DEBUG_LIVE->prev = hdr;
+
+	ALLOC_DEBUG_LIVE = hdr;
+
+	MTY_GlobalUnlock(&ALLOC_DEBUG_LOCK);
+}
+
+void alloc_debug_untrack(struct alloc_header *hdr)
+{
+	MTY_GlobalLock(&ALLOC_DEBUG_LOCK);
+
+	if (hdr->prev) {
+		hdr->prev->next = hdr->next;
+
+	} else {
+		ALLOC_DEBUG_LIVE = hdr->next;
+	}
+
+	if (hdr->next)
+		hdr->next->prev = hdr->prev;
+
+	hdr->prev = hdr->next = NULL;
+
+	MTY_GlobalUnlock(&ALLOC_DEBUG_LOCK);
+}
+
+bool alloc_debug_check(struct alloc_header *hdr, bool aligned, const void *site)
+{
+	void *mem = alloc_debug_mem(hdr);
+
+	MTY_GlobalLock(&ALLOC_DEBUG_LOCK);
+
+	struct alloc_freed freed = *alloc_debug_freed(hdr);
+
+	MTY_GlobalUnlock(&ALLOC_DEBUG_LOCK);
+
+	if (freed.hdr == hdr) {
+		MTY_Log("Double free of %p (%zu bytes from %p) at %p", mem, freed.size, freed.site, site);
+		return false;
+	}
+
+	if (hdr->magic != ALLOC_LIVE) {
+		MTY_Log("Free of %p at %p which is not a live allocation or has been underrun", mem, site);
+		return false;
+	}
+
+	if (hdr->aligned != aligned)
+		MTY_Log("Mismatched %s of %p (%zu bytes from %p) at %p", aligned ? "MTY_FreeAligned" : "MTY_Free",
+			mem, hdr->size, hdr->site, site);
+
+	if (!alloc_debug_guard_ok(hdr))
+		MTY_Log("Buffer overrun past %p (%zu bytes from %p, tag '%s') detected at %p",
+			mem, hdr->size, hdr->site, alloc_debug_tag(hdr), site);
+
+	return true;
+}
+
+struct alloc_header *alloc_debug_quarantine(struct alloc_header *hdr)
+{
+	alloc_debug_untrack(hdr);
+
+	hdr->magic = ALLOC_FREED;
+	memset(alloc_debug_mem(hdr), ALLOC_FREED_BYTE, hdr->size);
+
+	MTY_GlobalLock(&ALLOC_DEBUG_LOCK);
+
+	struct alloc_freed *freed = alloc_debug_freed(hdr);
+	freed->hdr = hdr;
+	freed->size = hdr->size;
+	freed->site = hdr->site;
+
+	struct alloc_header *evicted = ALLOC_DEBUG_QUARANTINE[ALLOC_DEBUG_QPOS];
+	ALLOC_DEBUG_QUARANTINE[ALLOC_DEBUG_QPOS] = hdr;
+	ALLOC_DEBUG_QPOS = (ALLOC_DEBUG_QPOS + 1) % ALLOC_QUARANTINE;
+
+	MTY_GlobalUnlock(&ALLOC_DEBUG_LOCK);
+
+	if (evicted && !alloc_debug_poison_ok(evicted))
+		MTY_Log("%p (%zu bytes from %p, tag '%s') was written after it was freed",
+			alloc_debug_mem(evicted), evicted->size, evicted->site, alloc_debug_tag(evicted));
+
+	return evicted;
+}
+
+static void alloc_debug_exit(void)
+{
+	struct alloc_finding leaks[ALLOC_LEAK_LINES];
+	size_t count = 0;
+	size_t bytes = 0;
+
+	// Logging may allocate, so findings are copied out and logged after unlocking
+	MTY_GlobalLock(&ALLOC_DEBUG_LOCK);
+
+	for (struct alloc_header *hdr = ALLOC_DEBUG_LIVE; hdr; hdr = hdr->next, count++) {
+		if (count < ALLOC_LEAK_LINES)
+			alloc_debug_finding(&leaks[count], hdr);
+
+		bytes += hdr->size;
+	}
+
+	MTY_GlobalUnlock(&ALLOC_DEBUG_LOCK);
+
+	for (size_t x = 0; x < count && x < ALLOC_LEAK_LINES; x++)
+		MTY_Log("Leaked %zu bytes at %p from %p, tag '%s'", leaks[x].size,
+			leaks[x].mem, leaks[x].site, leaks[x].tag);
+
+	if (count > 0)
+		MTY_Log("%zu allocations totaling %zu bytes were not freed", count, bytes);
+}
+
+void alloc_debug_init(void)
+{
+	atexit(alloc_debug_exit);
+}
+
+
+// Public
+
+uint32_t MTY_AllocDebugCheck(void)
+{
+	struct alloc_finding found[ALLOC_LEAK_LINES];
+	uint32_t errors = 0;
+
+	MTY_GlobalLock(&ALLOC_DEBUG_LOCK);
+
+	for (struct alloc_header *hdr = ALLOC_DEBUG_LIVE; hdr; hdr = hdr->next) {
+		if (!alloc_debug_guard_ok(hdr)) {
+			if (errors < ALLOC_LEAK_LINES) {
+				alloc_debug_finding(&found[errors], hdr);
+			}
+
+			errors++;
+		}
+	}
+
+	for (uint32_t x = 0; x < ALLOC_QUARANTINE; x++) {
+		struct alloc_header *hdr = ALLOC_DEBUG_QUARANTINE[x];
+
+		if (hdr && !alloc_debug_poison_ok(hdr)) {
+			if (errors < ALLOC_LEAK_LINES) {
+				alloc_debug_finding(&found[errors], hdr);
+				found[errors].freed = true;
+			}
+
+			errors++;
+		}
+	}
+
+	MTY_GlobalUnlock(&ALLOC_DEBUG_LOCK);
+
+	for (uint32_t x = 0; x < errors && x < ALLOC_LEAK_LINES; x++) {
+		if (found[x].freed) {
+			MTY_Log("%p (%zu bytes from %p, tag '%s') was written after it was freed",
+				found[x].mem, found[x].size, found[x].site, found[x].tag);
+
+		} else {
+			MTY_Log("Buffer overrun past %p (%zu bytes from %p, tag '%s')",
+				found[x].mem, found[x].size, found[x].site, found[x].tag);
+		}
+	}
+
+	return errors;
+}
+
+char *MTY_AllocDebugReport(void)
+{
+	// Built with plain malloc so the report does not show up in itself
+	MTY_GlobalLock(&ALLOC_DEBUG_LOCK);
+
+	size_t count = 0;
+
+	for (struct alloc_header *hdr = ALLOC_DEBUG_LIVE; hdr; hdr = hdr->next)
+		count++;
+
+	size_t size = 128 * (count + 1);
+	char *report = malloc(size);
+
+	if (!report) {
+		MTY_GlobalUnlock(&ALLOC_DEBUG_LOCK);
+		MTY_Fatal("'malloc' failed");
+	}
+
+	size_t n = snprintf(report, size, "%-18s %12s %-18s %s\n", "address", "bytes", "site", "tag");
+
+	for (struct alloc_header *hdr = ALLOC_DEBUG_LIVE; hdr && n < size; hdr = hdr->next)
+		n += snprintf(report + n, size - n, "%-18p %12zu %-18p %s\n",
+			(void *) alloc_debug_mem(hdr), hdr->size, hdr->site, alloc_debug_tag(hdr));
+
+	MTY_GlobalUnlock(&ALLOC_DEBUG_LOCK);
+
+	char *dup = MTY_Strdup(report);
+	free(report);
+
+	return dup;
+}
@@ -0,0 +1,40 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "matoya.h"
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+	#define ALLOC_SITE() _ReturnAddress()
+#else
+	#define ALLOC_SITE() __builtin_return_address(0)
+#endif
+
+// When profiling or debugging, every block is prefixed by a header that sits
+// directly below the returned pointer
+struct alloc_header {
+	struct alloc_header *prev;
+	struct alloc_header *next;
+	const void *site;
+	size_t size;
+	uint32_t offset;
+	uint16_t tag;
+	bool aligned;
+	uint32_t magic;
+};
+
+#define ALLOC_HEADER \
+	((sizeof(struct alloc_header) + 15) & ~((size_t) 15))
+
+#define ALLOC_GUARD 16
+
+void alloc_debug_init(void);
+void alloc_debug_track(struct alloc_header *hdr);
+void alloc_debug_untrack(struct alloc_header *hdr);
+bool alloc_debug_check(struct alloc_header *hdr, bool aligned, const void *site);
+struct alloc_header *alloc_debug_quarantine(struct alloc_header *hdr);
@@ -0,0 +1,185 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "alloc-prof.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mty-tls.h"
+
+#define ALLOC_PROF_TAGS 64
+#define ALLOC_PROF_NAME 32
+
+struct alloc_prof {
+	char name[ALLOC_PROF_NAME];
+	MTY_Atomic64 live;
+	MTY_Atomic64 peak;
+	MTY_Atomic64 allocs;
+	MTY_Atomic64 frees;
+	MTY_Atomic64 histogram[MTY_ALLOC_HISTOGRAM];
+};
+
+// Tag 0 collects everything allocated outside of a tagged scope. The table
+// is fixed so that accounting itself never allocates
+static struct alloc_prof ALLOC_PROF[ALLOC_PROF_TAGS];
+static MTY_Atomic32 ALLOC_PROF_LEN;
+static MTY_Atomic32 ALLOC_PROF_LOCK;
+static MTY_TLS uint16_t ALLOC_PROF_TAG;
+
+
+// Internal
+
+uint16_t alloc_prof_tag(void)
+{
+	return ALLOC_PROF_TAG;
+}
+
+const char *alloc_prof_tag_name(uint16_t tag)
+{
+	return tag > 0 ? ALLOC_PROF[tag].name : NULL;
+}
+
+static uint32_t alloc_prof_bucket(size_t size)
+{
+	// Bucket 0 is <= 16 bytes, each following bucket doubles
+	uint32_t bucket = 0;
+
+	for (size_t x = 16; x < size && bucket < MTY_ALLOC_HISTOGRAM - 1; x <<= 1)
+		bucket++;
+
+	return bucket;
+}
+
+void alloc_prof_add(uint16_t tag, size_t size)
+{
+	struct alloc_prof *ctx = &ALLOC_PROF[tag];
+
+	MTY_Atomic64Add(&ctx->allocs, 1);
+	MTY_Atomic64Add(&ctx->histogram[alloc_prof_bucket(size)], 1);
+
+	int64_t live = MTY_Atomic64Add(&ctx->live, (int64_t) size);
+
+	for (int64_t peak = MTY_Atomic64Get(&ctx->peak); live > peak; peak = MTY_Atomic64Get(&ctx->peak))
+		if (MTY_Atomic64CAS(&ctx->peak, peak, live))
+			break;
+}
+
+void alloc_prof_remove(uint16_t tag, size_t size)
+{
+	struct alloc_prof *ctx = &ALLOC_PROF[tag];
+
+	MTY_Atomic64Add(&ctx->frees, 1);
+	MTY_Atomic64Add(&ctx->live, -(int64_t) size);
+}
+
+static int32_t alloc_prof_find(const char *tag, bool create)
+{
+	int32_t len = MTY_Atomic32Get(&ALLOC_PROF_LEN);
+
+	for (int32_t x = 1; x < len; x++)
+		if (!strcmp(ALLOC_PROF[x].name, tag))
+			return x;
+
+	if (!create)
+		return -1;
+
+	if (len == 0)
+		len = 1;
+
+	if (len == ALLOC_PROF_TAGS) {
+		MTY_Log("Could not register allocation tag '%s', maximum is %u", tag, ALLOC_PROF_TAGS - 1);
+		return 0;
+	}
+
+	snprintf(ALLOC_PROF[len].name, ALLOC_PROF_NAME, "%s", tag);
+	MTY_Atomic32Set(&ALLOC_PROF_LEN, len + 1);
+
+	return len;
+}
+
+
+// Public
+
+const char *MTY_AllocProfileTag(const char *tag)
+{
+	const char *prev = ALLOC_PROF_TAG > 0 ? ALLOC_PROF[ALLOC_PROF_TAG].name : NULL;
+
+	if (!tag) {
+		ALLOC_PROF_TAG = 0;
+
+	} else {
+		MTY_GlobalLock(&ALLOC_PROF_LOCK);
+		ALLOC_PROF_TAG = (uint16_t) alloc_prof_find(tag, true);
+		MTY_GlobalUnlock(&ALLOC_PROF_LOCK);
+	}
+
+	return prev;
+}
+
+static void alloc_prof_stats(struct alloc_prof *ctx, MTY_AllocStats *stats)
+{
+	stats->live = MTY_Atomic64Get(&ctx->live);
+	stats->peak = MTY_Atomic64Get(&ctx->peak);
+	stats->allocs = MTY_Atomic64Get(&ctx->allocs);
+	stats->frees = MTY_Atomic64Get(&ctx->frees);
+
+	for (uint32_t x = 0; x < MTY_ALLOC_HISTOGRAM; x++)
+		stats->histogram[x] = MTY_Atomic64Get(&ctx->histogram[x]);
+}
+
+bool MTY_AllocProfileGetStats(const char *tag, MTY_AllocStats *stats)
+{
+	int32_t index = 0;
+
+	if (tag) {
+		MTY_GlobalLock(&ALLOC_PROF_LOCK);
+		index = alloc_prof_find(tag, false);
+		MTY_GlobalUnlock(&ALLOC_PROF_LOCK);
+	}
+
+	if (index < 0)
+		return false;
+
+	alloc_prof_stats(&ALLOC_PROF[index], stats);
+
+	return true;
+}
+
+char *MTY_AllocProfileReport(void)
+{
+	MTY_AllocStats rows[ALLOC_PROF_TAGS];
+
+	int32_t len = MTY_Atomic32Get(&ALLOC_PROF_LEN);
+
+	if (len == 0)
+		len = 1;
+
+	for (int32_t x = 0; x < len; x++)
+		alloc_prof_stats(&ALLOC_PROF[x], &rows[x]);
+
+	size_t size = 512 * (len + 1);
+	char *report = MTY_Alloc(size, 1);
+
+	size_t n = snprintf(report, size, "%-32s %14s %14s %12s %12s   %s\n",
+		"tag", "live", "peak", "allocs", "frees", "<=16 <=32 ... >256K");
+
+	for (int32_t x = 0; x < len && n < size; x++) {
+		MTY_AllocStats *row = &rows[x];
+
+		n += snprintf(report + n, size - n, "%-32.32s %14lld %14lld %12lld %12lld  ",
+			x == 0 ? "(untagged)" : ALLOC_PROF[x].name, (long long) row->live,
+			(long long) row->peak, (long long) row->allocs, (long long) row->frees);
+
+		for (uint32_t y = 0; y < MTY_ALLOC_HISTOGRAM && n < size; y++)
+			n += snprintf(report + n, size - n, " %lld", (long long) row->histogram[y]);
+
+		if (n < size)
+			n += snprintf(report + n, size - n, "\n");
+	}
+
+	return report;
+}
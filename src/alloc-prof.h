@@ -0,0 +1,14 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "matoya.h"
+
+uint16_t alloc_prof_tag(void);
+const char *alloc_prof_tag_name(uint16_t tag);
+void alloc_prof_add(uint16_t tag, size_t size);
+void alloc_prof_remove(uint16_t tag, size_t size);
@@ -0,0 +1,168 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "matoya.h"
+
+#define ARENA_CHUNK_SIZE    (1024 * 1024)
+#define ARENA_CHUNK_GRANULE (64 * 1024)
+#define ARENA_ALIGN         16
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	size_t base;
+};
+
+struct MTY_Arena {
+	size_t chunk_size;
+	struct arena_chunk *first;
+	struct arena_chunk *cur;
+	size_t used;
+};
+
+#define ARENA_HEADER \
+	((sizeof(struct arena_chunk) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+
+// Chunks
+
+static size_t arena_round(size_t size)
+{
+	return (size + ARENA_CHUNK_GRANULE - 1) & ~((size_t) ARENA_CHUNK_GRANULE - 1);
+}
+
+static uint8_t *arena_chunk_data(struct arena_chunk *chunk)
+{
+	return (uint8_t *) chunk + ARENA_HEADER;
+}
+
+static size_t arena_chunk_capacity(struct arena_chunk *chunk)
+{
+	return chunk->size - ARENA_HEADER;
+}
+
+static struct arena_chunk *arena_chunk_create(size_t size)
+{
+	struct arena_chunk *chunk = MTY_AllocPages(size, 0);
+	chunk->size = size;
+	chunk->next = NULL;
+	chunk->base = 0;
+
+	return chunk;
+}
+
+static void arena_advance(MTY_Arena *ctx, size_t need)
+{
+	struct arena_chunk *cur = ctx->cur;
+	struct arena_chunk *next = cur->next;
+
+	// Reuse a chunk left over from a previous rewind if it is big enough,
+	// otherwise splice a new one in front of it
+	if (!next || arena_chunk_capacity(next) < need) {
+		size_t size = ctx->chunk_size;
+
+		if (need + ARENA_HEADER > size)
+			size = arena_round(need + ARENA_HEADER);
+
+		struct arena_chunk *chunk = arena_chunk_create(size);
+		chunk->next = next;
+		cur->next = chunk;
+		next = chunk;
+	}
+
+	next->base = cur->base + arena_chunk_capacity(cur);
+
+	ctx->cur = next;
+	ctx->used = 0;
+}
+
+
+// Public
+
+MTY_Arena *MTY_ArenaCreate(size_t chunkSize)
+{
+	MTY_Arena *ctx = MTY_Alloc(1, sizeof(MTY_Arena));
+
+	ctx->chunk_size = arena_round(chunkSize > 0 ? chunkSize : ARENA_CHUNK_SIZE);
+	ctx->first = ctx->cur = arena_chunk_create(ctx->chunk_size);
+
+	return ctx;
+}
+
+void *MTY_ArenaAllocAligned(MTY_Arena *ctx, size_t size, size_t align)
+{
+	if (align < ARENA_ALIGN)
+		align = ARENA_ALIGN;
+
+	if (align & (align - 1)) {
+		MTY_Log("Alignment %zu is not a power of 2", align);
+		return NULL;
+	}
+
+	uintptr_t mask = (uintptr_t) align - 1;
+
+	uintptr_t begin = (uintptr_t) arena_chunk_data(ctx->cur);
+	uintptr_t p = (begin + ctx->used + mask) & ~mask;
+
+	if (p + size > begin + arena_chunk_capacity(ctx->cur)) {
+		arena_advance(ctx, size + align);
+
+		begin = (uintptr_t) arena_chunk_data(ctx->cur);
+		p = (begin + mask) & ~mask;
+	}
+
+	ctx->used = p + size - begin;
+
+	return (void *) p;
+}
+
+void *MTY_ArenaAlloc(MTY_Arena *ctx, size_t size)
+{
+	return MTY_ArenaAllocAligned(ctx, size, ARENA_ALIGN);
+}
+
+size_t MTY_ArenaMark(MTY_Arena *ctx)
+{
+	return ctx->cur->base + ctx->used;
+}
+
+void MTY_ArenaRewind(MTY_Arena *ctx, size_t mark)
+{
+	// Only chunks up to the current one have valid base offsets
+	for (struct arena_chunk *chunk = ctx->first; chunk; chunk = chunk->next) {
+		if (mark >= chunk->base && mark <= chunk->base + arena_chunk_capacity(chunk)) {
+			ctx->cur = chunk;
+			ctx->used = mark - chunk->base;
+			break;
+		}
+
+		if (chunk == ctx->cur)
+			break;
+	}
+}
+
+void MTY_ArenaReset(MTY_Arena *ctx)
+{
+	ctx->cur = ctx->first;
+	ctx->used = 0;
+}
+
+void MTY_ArenaDestroy(MTY_Arena **arena)
+{
+	if (!arena || !*arena)
+		return;
+
+	MTY_Arena *ctx = *arena;
+
+	for (struct arena_chunk *chunk = ctx->first; chunk;) {
+		struct arena_chunk *next = chunk->next;
+		MTY_FreePages(chunk, chunk->size);
+		chunk = next;
+	}
+
+	MTY_Free(ctx);
+	*arena = NULL;
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "matoya.h"
+
+#include <string.h>
+
+struct MTY_Buffer {
+	MTY_Atomic32 refs;
+	uint8_t *data;
+	size_t size;
+
+	// Slices keep their root alive and never own data themselves
+	MTY_Buffer *root;
+
+	MTY_BufferRecycleFunc recycle;
+	void *opaque;
+};
+
+#define BUFFER_HEADER \
+	((sizeof(MTY_Buffer) + 15) & ~((size_t) 15))
+
+MTY_Buffer *MTY_BufferCreate(size_t size)
+{
+	// Header and data share one allocation, the data is not zeroed
+	MTY_Buffer *ctx = MTY_AllocUninit(BUFFER_HEADER + size, 1);
+	memset(ctx, 0, sizeof(MTY_Buffer));
+
+	ctx->data = (uint8_t *) ctx + BUFFER_HEADER;
+	ctx->size = size;
+
+	MTY_Atomic32Set(&ctx->refs, 1);
+
+	return ctx;
+}
+
+MTY_Buffer *MTY_BufferSlice(MTY_Buffer *ctx, size_t offset, size_t size)
+{
+	if (offset > ctx->size || size > ctx->size - offset) {
+		MTY_Log("Slice [%zu, %zu) is out of bounds for a buffer of size %zu", offset, offset + size, ctx->size);
+		return NULL;
+	}
+
+	MTY_Buffer *slice = MTY_Alloc(1, sizeof(MTY_Buffer));
+	slice->data = ctx->data + offset;
+	slice->size = size;
+	slice->root = MTY_BufferRef(ctx->root ? ctx->root : ctx);
+
+	MTY_Atomic32Set(&slice->refs, 1);
+
+	return slice;
+}
+
+MTY_Buffer *MTY_BufferRef(MTY_Buffer *ctx)
+{
+	MTY_Atomic32Add(&ctx->refs, 1);
+
+	return ctx;
+}
+
+void *MTY_BufferGetData(MTY_Buffer *ctx)
+{
+	return ctx->data;
+}
+
+size_t MTY_BufferGetSize(MTY_Buffer *ctx)
+{
+	return ctx->size;
+}
+
+void MTY_BufferSetRecycle(MTY_Buffer *ctx, MTY_BufferRecycleFunc func, void *opaque)
+{
+	ctx->recycle = func;
+	ctx->opaque = opaque;
+}
+
+void MTY_BufferRelease(MTY_Buffer **buffer)
+{
+	if (!buffer || !*buffer)
+		return;
+
+	MTY_Buffer *ctx = *buffer;
+	*buffer = NULL;
+
+	if (MTY_Atomic32Add(&ctx->refs, -1) > 0)
+		return;
+
+	// The recycle function takes ownership and may revive the buffer later
+	// with MTY_BufferRef, or free it with MTY_BufferDestroy
+	if (ctx->recycle) {
+		ctx->recycle(ctx, ctx->opaque);
+
+	} else {
+		MTY_BufferDestroy(&ctx);
+	}
+}
+
+void MTY_BufferDestroy(MTY_Buffer **buffer)
+{
+	if (!buffer || !*buffer)
+		return;
+
+	MTY_Buffer *ctx = *buffer;
+
+	MTY_BufferRelease(&ctx->root);
+
+	MTY_Free(ctx);
+	*buffer = NULL;
+}
@@ -22,12 +22,12 @@
 	#include <arm_neon.h>
 #endif
 
-#define STBI_MALLOC(size)        MTY_Alloc(size, 1)
+#define STBI_MALLOC(size)        MTY_AllocUninit(size, 1)
 #define STBI_REALLOC(ptr, size)  MTY_Realloc(ptr, size, 1)
 #define STBI_FREE(ptr)           MTY_Free(ptr)
 #define STBI_ASSERT(x)
 
-#define STBIW_MALLOC(size)       MTY_Alloc(size, 1)
+#define STBIW_MALLOC(size)       MTY_AllocUninit(size, 1)
 #define STBIW_REALLOC(ptr, size) MTY_Realloc(ptr, size, 1)
 #define STBIW_FREE(ptr)          MTY_Free(ptr)
 #define STBIW_ASSERT(x)
@@ -35,6 +35,8 @@
 #include "stb/stb_image.h"
 #include "stb/stb_image_write.h"
 
+#include "metrics.h"
+
 struct image_write {
 	void *output;
 	size_t size;
@@ -88,7 +90,7 @@ void *MTY_CropImage(const void *image, uint32_t cropWidth, uint32_t cropHeight,
 		uint32_t crop_w = *width - crop_width;
 		uint32_t crop_h = *height - crop_height;
 
-		uint8_t *cropped = MTY_Alloc(crop_w * crop_h, 4);
+		uint8_t *cropped = MTY_AllocUninit(crop_w * crop_h, 4);
 		for (uint32_t h = y; h < *height - y && h - y < crop_h; h++)
 			memcpy(cropped + ((h - y) * crop_w * 4), (uint8_t *) image + (h * *width * 4) + (x * 4), crop_w * 4);
 
@@ -106,7 +108,7 @@ static void image_compress_write_func(void *context, void *data, int size)
 	struct image_write *ctx = (struct image_write *) context;
 	ctx->size = size;
 
-	ctx->output = MTY_Alloc(ctx->size, 1);
+	ctx->output = MTY_AllocUninit(ctx->size, 1);
 	memcpy(ctx->output, data, ctx->size);
 }
 
@@ -144,12 +146,20 @@ void *MTY_Compress(const void *input, size_t inputSize, size_t *outputSize)
 {
 	int32_t out = 0;
 
+	MTY_ProfileBegin("MTY_Compress");
+
 	// Quality defaults to 5
 	void *output = stbi_zlib_compress((uint8_t *) input, (int32_t) inputSize, &out, 0);
 	*outputSize = out;
 
-	if (!output)
+	MTY_ProfileEnd();
+
+	if (output) {
+		metrics_compressed(inputSize, *outputSize);
+
+	} else {
 		MTY_Log("'stbi_zlib_compress' failed");
+	}
 
 	return output;
 }
@@ -149,11 +149,11 @@ bool MTY_CryptoHashFile(MTY_Algorithm algo, const char *path, const void *key, s
 	void *output, size_t outputSize)
 {
 	size_t size = 0;
-	void *input = MTY_ReadFile(path, &size);
+	void *input = MTY_MapFile(path, MTY_MAP_SEQUENTIAL, &size);
 
 	if (input) {
 		MTY_CryptoHash(algo, input, size, key, keySize, output, outputSize);
-		MTY_Free(input);
+		MTY_UnmapFile(input, size);
 
 		return true;
 	}
@@ -4,12 +4,28 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
+#define _DEFAULT_SOURCE // pread, pwrite (mty-fileio.h)
+#define _DARWIN_C_SOURCE // pread, pwrite (mty-fileio.h)
+#define _FILE_OFFSET_BITS 64 // 64-bit off_t on 32-bit targets (mty-fileio.h)
+
 #include "matoya.h"
 
 #include <string.h>
 #include <errno.h>
 
 #include "mty-file.h"
+#include "mty-fileio.h"
+
+#define FILE_BUF_SIZE (64 * 1024)
+
+struct MTY_File {
+	intptr_t f;
+	uint8_t *buf;
+	size_t size;
+	size_t pos;
+	size_t len;
+	bool dirty;
+};
 
 void *MTY_ReadFile(const char *path, size_t *size)
 {
@@ -97,6 +113,195 @@ bool MTY_AppendTextToFile(const char *path, const char *fmt, ...)
 	return r;
 }
 
+// Streaming, the buffer either holds pending writes in [0, pos) or read ahead data
+// in [pos, len), never both
+
+static bool file_flush(MTY_File *ctx)
+{
+	if (!ctx->dirty)
+		return true;
+
+	bool r = mty_fileio_write(ctx->f, ctx->buf, ctx->pos, -1);
+
+	ctx->pos = 0;
+	ctx->dirty = false;
+
+	return r;
+}
+
+static bool file_discard(MTY_File *ctx)
+{
+	if (ctx->dirty)
+		return true;
+
+	size_t ahead = ctx->len - ctx->pos;
+
+	ctx->pos = ctx->len = 0;
+
+	// The OS position is past the read ahead data, move it back to the logical position
+	if (ahead > 0)
+		return mty_fileio_seek(ctx->f, -(int64_t) ahead, MTY_SEEK_CUR) >= 0;
+
+	return true;
+}
+
+MTY_File *MTY_FileOpen(const char *path, MTY_FileMode mode, size_t bufSize)
+{
+	intptr_t f = mty_fileio_open(path, mode);
+	if (f == MTY_FILEIO_INVALID)
+		return NULL;
+
+	MTY_File *ctx = MTY_Alloc(1, sizeof(MTY_File));
+	ctx->f = f;
+	ctx->size = bufSize > 0 ? bufSize : FILE_BUF_SIZE;
+	ctx->buf = MTY_AllocUninit(ctx->size, 1);
+
+	return ctx;
+}
+
+size_t MTY_FileRead(MTY_File *ctx, void *data, size_t size)
+{
+	if (!file_flush(ctx))
+		return 0;
+
+	uint8_t *out = data;
+	size_t total = 0;
+
+	while (total < size) {
+		size_t avail = ctx->len - ctx->pos;
+
+		if (avail > 0) {
+			size_t n = size - total < avail ? size - total : avail;
+			memcpy(out + total, ctx->buf + ctx->pos, n);
+
+			ctx->pos += n;
+			total += n;
+			continue;
+		}
+
+		// Large reads go straight into the caller's memory
+		if (size - total >= ctx->size) {
+			int64_t n = mty_fileio_read(ctx->f, out + total, size - total, -1);
+
+			if (n > 0)
+				total += (size_t) n;
+
+			break;
+		}
+
+		int64_t n = mty_fileio_read(ctx->f, ctx->buf, ctx->size, -1);
+
+		if (n <= 0)
+			break;
+
+		ctx->pos = 0;
+		ctx->len = (size_t) n;
+	}
+
+	return total;
+}
+
+bool MTY_FileWrite(MTY_File *ctx, const void *data, size_t size)
+{
+	if (!file_discard(ctx))
+		return false;
+
+	if (ctx->pos + size > ctx->size && !file_flush(ctx))
+		return false;
+
+	if (size >= ctx->size)
+		return mty_fileio_write(ctx->f, data, size, -1);
+
+	memcpy(ctx->buf + ctx->pos, data, size);
+	ctx->pos += size;
+	ctx->dirty = true;
+
+	return true;
+}
+
+bool MTY_FileWriteText(MTY_File *ctx, const char *fmt, ...)
+{
+	char stack[512];
+	char *str = stack;
+
+	va_list args;
+	va_start(args, fmt);
+
+	va_list copy;
+	va_copy(copy, args);
+
+	int32_t len = vsnprintf(stack, sizeof(stack), fmt, args);
+
+	if (len >= (int32_t) sizeof(stack)) {
+		str = MTY_AllocUninit(len + 1, 1);
+		vsnprintf(str, len + 1, fmt, copy);
+	}
+
+	va_end(copy);
+	va_end(args);
+
+	bool r = len >= 0 && MTY_FileWrite(ctx, str, len);
+
+	if (str != stack)
+		MTY_Free(str);
+
+	return r;
+}
+
+int64_t MTY_FileSeek(MTY_File *ctx, int64_t offset, MTY_Seek whence)
+{
+	if (!file_flush(ctx))
+		return -1;
+
+	// Relative seeks are from the logical position, not the end of the read ahead
+	if (whence == MTY_SEEK_CUR)
+		offset -= (int64_t) (ctx->len - ctx->pos);
+
+	ctx->pos = ctx->len = 0;
+
+	return mty_fileio_seek(ctx->f, offset, whence);
+}
+
+size_t MTY_FileReadAt(MTY_File *ctx, void *data, size_t size, uint64_t offset)
+{
+	if (!file_flush(ctx))
+		return 0;
+
+	int64_t n = mty_fileio_read(ctx->f, data, size, (int64_t) offset);
+
+	return n > 0 ? (size_t) n : 0;
+}
+
+bool MTY_FileWriteAt(MTY_File *ctx, const void *data, size_t size, uint64_t offset)
+{
+	// Read ahead data may overlap the write and go stale
+	if (!file_flush(ctx) || !file_discard(ctx))
+		return false;
+
+	return mty_fileio_write(ctx->f, data, size, (int64_t) offset);
+}
+
+bool MTY_FileFlush(MTY_File *ctx)
+{
+	return file_flush(ctx);
+}
+
+void MTY_FileClose(MTY_File **file)
+{
+	if (!file || !*file)
+		return;
+
+	MTY_File *ctx = *file;
+
+	file_flush(ctx);
+	mty_fileio_close(ctx->f);
+
+	MTY_Free(ctx->buf);
+
+	MTY_Free(ctx);
+	*file = NULL;
+}
+
 void MTY_FreeFileList(MTY_FileList **fl)
 {
 	if (!fl || !*fl)
@@ -18,9 +18,11 @@ struct hash_node {
 	const void *val;
 };
 
+// Most buckets only ever hold one or two nodes, so the array starts at a single node
 struct hash_bucket {
-	uint32_t num_nodes;
 	struct hash_node *nodes;
+	uint32_t len;
+	uint32_t cap;
 };
 
 struct MTY_Hash {
@@ -28,6 +30,21 @@ struct MTY_Hash {
 	struct hash_bucket *buckets;
 };
 
+static struct hash_node *hash_bucket_push(struct hash_bucket *b)
+{
+	if (b->len == b->cap) {
+		uint32_t cap = b->cap > 0 ? b->cap * 2 : 1;
+
+		b->nodes = MTY_ReallocSized(b->nodes, b->cap * sizeof(struct hash_node), cap, sizeof(struct hash_node));
+		b->cap = cap;
+	}
+
+	struct hash_node *n = &b->nodes[b->len++];
+	memset(n, 0, sizeof(struct hash_node));
+
+	return n;
+}
+
 MTY_Hash *MTY_HashCreate(uint32_t numBuckets)
 {
 	MTY_Hash *ctx = MTY_Alloc(1, sizeof(MTY_Hash));
@@ -48,7 +65,7 @@ bool MTY_HashNextKey(MTY_Hash *ctx, uint64_t *iter, const char **key)
 	for (; *bucket < ctx->num_buckets; (*bucket)++) {
 		struct hash_bucket *b = &ctx->buckets[*bucket];
 
-		for (; *node < b->num_nodes; (*node)++) {
+		for (; *node < b->len; (*node)++) {
 			struct hash_node *n = &b->nodes[*node];
 
 			if (n->key) {
@@ -61,7 +78,7 @@ bool MTY_HashNextKey(MTY_Hash *ctx, uint64_t *iter, const char **key)
 		if (*key)
 			break;
 
-		if (*node == b->num_nodes)
+		if (*node == b->len)
 			*node = 0;
 	}
 
@@ -91,7 +108,7 @@ void MTY_HashDestroy(MTY_Hash **hash, void (*freeFunc)(void *value))
 	for (uint32_t x = 0; x < ctx->num_buckets; x++) {
 		struct hash_bucket *b = &ctx->buckets[x];
 
-		for (uint32_t y = 0; y < b->num_nodes; y++) {
+		for (uint32_t y = 0; y < b->len; y++) {
 			struct hash_node *n = &b->nodes[y];
 
 			MTY_Free(n->key);
@@ -113,7 +130,7 @@ static void *hash_get(MTY_Hash *ctx, const char *key, bool pop)
 {
 	struct hash_bucket *b = &ctx->buckets[MTY_DJB2(key) % ctx->num_buckets];
 
-	for (uint32_t x = 0; x < b->num_nodes; x++) {
+	for (uint32_t x = 0; x < b->len; x++) {
 		struct hash_node *n = &b->nodes[x];
 
 		if (n->key && !strcmp(key, n->key)) {
@@ -163,7 +180,7 @@ void *MTY_HashSet(MTY_Hash *ctx, const char *key, const void *value)
 	struct hash_bucket *b = &ctx->buckets[MTY_DJB2(key) % ctx->num_buckets];
 	struct hash_node *n = NULL;
 
-	for (uint32_t x = 0; x < b->num_nodes; x++) {
+	for (uint32_t x = 0; x < b->len; x++) {
 		struct hash_node *this_n = &b->nodes[x];
 
 		if (!this_n->key) {
@@ -177,10 +194,8 @@ void *MTY_HashSet(MTY_Hash *ctx, const char *key, const void *value)
 		}
 	}
 
-	if (!n) {
-		b->nodes = MTY_Realloc(b->nodes, ++b->num_nodes, sizeof(struct hash_node));
-		n = &b->nodes[b->num_nodes - 1];
-	}
+	if (!n)
+		n = hash_bucket_push(b);
 
 	n->key = MTY_Strdup(key);
 	n->val = value;
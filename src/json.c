@@ -29,7 +29,13 @@
 
 MTY_JSON *MTY_JSONParse(const char *input)
 {
-	return (MTY_JSON *) cJSON_Parse(input);
+	MTY_ProfileBegin("MTY_JSONParse");
+
+	MTY_JSON *j = (MTY_JSON *) cJSON_Parse(input);
+
+	MTY_ProfileEnd();
+
+	return j;
 }
 
 char *MTY_JSONStringify(const MTY_JSON *json)
@@ -45,12 +51,20 @@ char *MTY_JSONStringify(const MTY_JSON *json)
 MTY_JSON *MTY_JSONReadFile(const char *path)
 {
 	MTY_JSON *j = NULL;
-	void *jstr = MTY_ReadFile(path, NULL);
 
-	if (jstr)
-		j = MTY_JSONParse(jstr);
+	size_t size = 0;
+	void *jstr = MTY_MapFile(path, MTY_MAP_SEQUENTIAL, &size);
 
-	MTY_Free(jstr);
+	// Mapped files are not null terminated so the parse is bounded by the size
+	if (jstr) {
+		MTY_ProfileBegin("MTY_JSONReadFile");
+
+		j = (MTY_JSON *) cJSON_ParseWithLengthOpts(jstr, size, NULL, false);
+
+		MTY_ProfileEnd();
+	}
+
+	MTY_UnmapFile(jstr, size);
 
 	return j;
 }
@@ -0,0 +1,186 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "lock-prof.h"
+
+#include <stdio.h>
+#include <string.h>
+
+struct lock_prof {
+	char *name;
+	MTY_Atomic64 acquisitions;
+	MTY_Atomic64 contended;
+	MTY_Atomic64 wait;
+	MTY_Atomic64 hold;
+};
+
+struct lock_prof_row {
+	const char *name;
+	int64_t acquisitions;
+	int64_t contended;
+	int64_t wait;
+	int64_t hold;
+};
+
+static MTY_Atomic32 LOCK_PROF_ENABLED;
+static MTY_Atomic32 LOCK_PROF_LOCK;
+static MTY_Hash *LOCK_PROF;
+
+
+// Internal
+
+struct lock_prof *lock_prof_get(const char *name)
+{
+	if (!name)
+		return NULL;
+
+	MTY_GlobalLock(&LOCK_PROF_LOCK);
+
+	if (!LOCK_PROF)
+		LOCK_PROF = MTY_HashCreate(0);
+
+	// Locks sharing a name share statistics
+	struct lock_prof *ctx = MTY_HashGet(LOCK_PROF, name);
+
+	if (!ctx) {
+		ctx = MTY_Alloc(1, sizeof(struct lock_prof));
+		ctx->name = MTY_Strdup(name);
+		MTY_HashSet(LOCK_PROF, name, ctx);
+	}
+
+	MTY_GlobalUnlock(&LOCK_PROF_LOCK);
+
+	return ctx;
+}
+
+bool lock_prof_active(struct lock_prof *ctx)
+{
+	return ctx && MTY_Atomic32Get(&LOCK_PROF_ENABLED);
+}
+
+static int64_t lock_prof_ns(int64_t begin, int64_t end)
+{
+	return (int64_t) (MTY_TimeDiff(begin, end) * 1000.0f * 1000.0f);
+}
+
+int64_t lock_prof_acquired(struct lock_prof *ctx, bool contended, int64_t begin)
+{
+	int64_t now = MTY_Timestamp();
+
+	MTY_Atomic64Add(&ctx->acquisitions, 1);
+
+	if (contended) {
+		MTY_Atomic64Add(&ctx->contended, 1);
+		MTY_Atomic64Add(&ctx->wait, lock_prof_ns(begin, now));
+	}
+
+	return now;
+}
+
+void lock_prof_released(struct lock_prof *ctx, int64_t acquired)
+{
+	MTY_Atomic64Add(&ctx->hold, lock_prof_ns(acquired, MTY_Timestamp()));
+}
+
+void lock_prof_waited(struct lock_prof *ctx, bool timedout, int64_t begin)
+{
+	// For condition variables an acquisition is a wait and contention is a timeout
+	MTY_Atomic64Add(&ctx->acquisitions, 1);
+	MTY_Atomic64Add(&ctx->wait, lock_prof_ns(begin, MTY_Timestamp()));
+
+	if (timedout)
+		MTY_Atomic64Add(&ctx->contended, 1);
+}
+
+
+// Public
+
+void MTY_LockProfileEnable(bool enable)
+{
+	MTY_Atomic32Set(&LOCK_PROF_ENABLED, enable ? 1 : 0);
+}
+
+static int32_t lock_prof_compare(const void *a, const void *b)
+{
+	const struct lock_prof_row *row_a = a;
+	const struct lock_prof_row *row_b = b;
+
+	if (row_a->wait != row_b->wait)
+		return row_a->wait < row_b->wait ? 1 : -1;
+
+	return row_a->hold < row_b->hold ? 1 : row_a->hold > row_b->hold ? -1 : 0;
+}
+
+char *MTY_LockProfileReport(void)
+{
+	MTY_GlobalLock(&LOCK_PROF_LOCK);
+
+	uint32_t len = 0;
+	uint32_t cap = 0;
+	struct lock_prof_row *rows = NULL;
+
+	uint64_t iter = 0;
+	const char *key = NULL;
+
+	while (LOCK_PROF && MTY_HashNextKey(LOCK_PROF, &iter, &key)) {
+		struct lock_prof *ctx = MTY_HashGet(LOCK_PROF, key);
+
+		if (len == cap) {
+			cap = cap > 0 ? cap * 2 : 16;
+			rows = MTY_Realloc(rows, cap, sizeof(struct lock_prof_row));
+		}
+
+		rows[len].name = ctx->name;
+		rows[len].acquisitions = MTY_Atomic64Get(&ctx->acquisitions);
+		rows[len].contended = MTY_Atomic64Get(&ctx->contended);
+		rows[len].wait = MTY_Atomic64Get(&ctx->wait);
+		rows[len].hold = MTY_Atomic64Get(&ctx->hold);
+		len++;
+	}
+
+	MTY_GlobalUnlock(&LOCK_PROF_LOCK);
+
+	if (len > 0)
+		MTY_Sort(rows, len, sizeof(struct lock_prof_row), lock_prof_compare);
+
+	size_t size = 256 * (len + 1);
+	char *report = MTY_Alloc(size, 1);
+
+	size_t n = snprintf(report, size, "%-32s %12s %12s %8s %12s %12s\n",
+		"name", "acquired", "contended", "%", "wait ms", "hold ms");
+
+	for (uint32_t x = 0; x < len && n < size; x++) {
+		struct lock_prof_row *row = &rows[x];
+		float pct = row->acquisitions > 0 ? (float) row->contended / (float) row->acquisitions * 100.0f : 0.0f;
+
+		n += snprintf(report + n, size - n, "%-32.32s %12lld %12lld %8.2f %12.3f %12.3f\n",
+			row->name, (long long) row->acquisitions, (long long) row->contended, pct,
+			(double) row->wait / 1000000.0, (double) row->hold / 1000000.0);
+	}
+
+	MTY_Free(rows);
+
+	return report;
+}
+
+void MTY_LockProfileReset(void)
+{
+	MTY_GlobalLock(&LOCK_PROF_LOCK);
+
+	uint64_t iter = 0;
+	const char *key = NULL;
+
+	while (LOCK_PROF && MTY_HashNextKey(LOCK_PROF, &iter, &key)) {
+		struct lock_prof *ctx = MTY_HashGet(LOCK_PROF, key);
+
+		MTY_Atomic64Set(&ctx->acquisitions, 0);
+		MTY_Atomic64Set(&ctx->contended, 0);
+		MTY_Atomic64Set(&ctx->wait, 0);
+		MTY_Atomic64Set(&ctx->hold, 0);
+	}
+
+	MTY_GlobalUnlock(&LOCK_PROF_LOCK);
+}
@@ -0,0 +1,17 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "matoya.h"
+
+struct lock_prof;
+
+struct lock_prof *lock_prof_get(const char *name);
+bool lock_prof_active(struct lock_prof *ctx);
+int64_t lock_prof_acquired(struct lock_prof *ctx, bool contended, int64_t begin);
+void lock_prof_released(struct lock_prof *ctx, int64_t acquired);
+void lock_prof_waited(struct lock_prof *ctx, bool timedout, int64_t begin);
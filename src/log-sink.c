@@ -0,0 +1,361 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "log-sink.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mty-file.h"
+#include "mty-tls.h"
+
+#define SINK_BUFFER (64 * 1024)
+
+struct log_sink {
+	FILE *f;
+	char path[MTY_PATH_MAX];
+	MTY_LogFormat format;
+	size_t max_size;
+	uint32_t max_files;
+	size_t size;
+
+	MTY_StrBuf *buf;
+	double epoch;
+	int64_t base;
+	uint32_t errors;
+};
+
+static struct log_sink SINK;
+static MTY_Atomic32 SINK_ACTIVE;
+static MTY_Atomic32 SINK_LOCK;
+static MTY_Atomic32 SINK_EXIT;
+static MTY_TLS bool SINK_HELD;
+
+
+// Lock, tracked per thread so a fatal error raised while it is held can skip the flush
+
+static void sink_lock(void)
+{
+	MTY_GlobalLock(&SINK_LOCK);
+	SINK_HELD = true;
+}
+
+static void sink_unlock(void)
+{
+	SINK_HELD = false;
+	MTY_GlobalUnlock(&SINK_LOCK);
+}
+
+
+// Formatting
+
+static const char *sink_level(MTY_LogLevel level)
+{
+	switch (level) {
+		case MTY_LOG_TRACE: return "trace";
+		case MTY_LOG_DEBUG: return "debug";
+		case MTY_LOG_INFO:  return "info";
+		case MTY_LOG_WARN:  return "warn";
+		case MTY_LOG_ERROR: return "error";
+		default:
+			break;
+	}
+
+	return "none";
+}
+
+static void sink_json_string(MTY_StrBuf *sb, const char *str)
+{
+	MTY_StrBufAppendLen(sb, "\"", 1);
+
+	const char *run = str;
+
+	for (; *str; str++) {
+		unsigned char c = *str;
+
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		MTY_StrBufAppendLen(sb, run, str - run);
+		run = str + 1;
+
+		switch (c) {
+			case '"':  MTY_StrBufAppendLen(sb, "\\\"", 2); break;
+			case '\\': MTY_StrBufAppendLen(sb, "\\\\", 2); break;
+			case '\n': MTY_StrBufAppendLen(sb, "\\n", 2);  break;
+			case '\r': MTY_StrBufAppendLen(sb, "\\r", 2);  break;
+			case '\t': MTY_StrBufAppendLen(sb, "\\t", 2);  break;
+			default:
+				MTY_StrBufPrintf(sb, "\\u%04x", c);
+				break;
+		}
+	}
+
+	MTY_StrBufAppendLen(sb, run, str - run);
+	MTY_StrBufAppendLen(sb, "\"", 1);
+}
+
+static void sink_logfmt_string(MTY_StrBuf *sb, const char *str)
+{
+	bool quote = *str == '\0';
+
+	for (const char *s = str; *s && !quote; s++)
+		quote = *s <= ' ' || *s == '=' || *s == '"';
+
+	if (!quote) {
+		MTY_StrBufAppend(sb, str);
+		return;
+	}
+
+	// logfmt quoting follows the same escapes as JSON
+	sink_json_string(sb, str);
+}
+
+static void sink_value(MTY_StrBuf *sb, const MTY_LogField *field, bool json)
+{
+	switch (field->type) {
+		case MTY_LOG_FIELD_STR:
+			if (json) {
+				sink_json_string(sb, field->value.s ? field->value.s : "");
+			} else {
+				sink_logfmt_string(sb, field->value.s ? field->value.s : "");
+			}
+			break;
+		case MTY_LOG_FIELD_INT:
+			MTY_StrBufPrintf(sb, "%lld", (long long) field->value.i);
+			break;
+		case MTY_LOG_FIELD_UINT:
+			MTY_StrBufPrintf(sb, "%llu", (unsigned long long) field->value.u);
+			break;
+		case MTY_LOG_FIELD_FLOAT:
+			// JSON has no representation for NaN or infinity
+			if (json && field->value.f != field->value.f) {
+				MTY_StrBufAppend(sb, "null");
+			} else {
+				MTY_StrBufPrintf(sb, "%.17g", field->value.f);
+			}
+			break;
+		case MTY_LOG_FIELD_BOOL:
+			MTY_StrBufAppend(sb, field->value.b ? "true" : "false");
+			break;
+		default:
+			MTY_StrBufAppend(sb, json ? "null" : "\"\"");
+			break;
+	}
+}
+
+void log_sink_fields(MTY_StrBuf *sb, const MTY_LogField *fields, uint32_t n)
+{
+	for (uint32_t x = 0; x < n; x++) {
+		MTY_StrBufAppendLen(sb, " ", 1);
+		MTY_StrBufAppend(sb, fields[x].key);
+		MTY_StrBufAppendLen(sb, "=", 1);
+		sink_value(sb, &fields[x], false);
+	}
+}
+
+
+// File
+
+static void sink_rotate(struct log_sink *ctx)
+{
+	fclose(ctx->f);
+	ctx->f = NULL;
+
+	char src[MTY_PATH_MAX + 16];
+	char dst[MTY_PATH_MAX + 16];
+
+	if (ctx->max_files > 0) {
+		snprintf(dst, sizeof(dst), "%s.%u", ctx->path, ctx->max_files);
+
+		if (MTY_FileExists(dst))
+			MTY_DeleteFile(dst);
+
+		for (uint32_t x = ctx->max_files; x > 1; x--) {
+			snprintf(src, sizeof(src), "%s.%u", ctx->path, x - 1);
+			snprintf(dst, sizeof(dst), "%s.%u", ctx->path, x);
+
+			if (MTY_FileExists(src))
+				MTY_MoveFile(src, dst);
+		}
+
+		snprintf(dst, sizeof(dst), "%s.1", ctx->path);
+		MTY_MoveFile(ctx->path, dst);
+	}
+
+	ctx->f = mty_fopen(ctx->path, "wb");
+	ctx->size = 0;
+}
+
+static void sink_write(struct log_sink *ctx, const char *data, size_t len)
+{
+	if (len == 0)
+		return;
+
+	if (ctx->f) {
+		if (fwrite(data, 1, len, ctx->f) != len)
+			ctx->errors++;
+
+		ctx->size += len;
+
+	} else {
+		ctx->errors++;
+	}
+}
+
+static void sink_flush(struct log_sink *ctx)
+{
+	sink_write(ctx, MTY_StrBufGet(ctx->buf), MTY_StrBufLength(ctx->buf));
+	MTY_StrBufClear(ctx->buf);
+
+	if (ctx->f)
+		fflush(ctx->f);
+}
+
+static void sink_record(struct log_sink *ctx, int64_t timestamp, int64_t thread, MTY_LogLevel level,
+	const char *func, const char *msg, const MTY_LogField *fields, uint32_t n)
+{
+	MTY_StrBuf *sb = ctx->buf;
+	size_t start = MTY_StrBufLength(sb);
+	double ts = ctx->epoch + MTY_TimeDiff(ctx->base, timestamp) / 1000.0;
+
+	if (ctx->format == MTY_LOG_FORMAT_JSON) {
+		MTY_StrBufPrintf(sb, "{\"ts\":%.3f,\"level\":\"%s\",\"thread\":%lld,\"func\":",
+			ts, sink_level(level), (long long) thread);
+		sink_json_string(sb, func);
+		MTY_StrBufAppend(sb, ",\"msg\":");
+		sink_json_string(sb, msg);
+
+		for (uint32_t x = 0; x < n; x++) {
+			MTY_StrBufAppendLen(sb, ",", 1);
+			sink_json_string(sb, fields[x].key);
+			MTY_StrBufAppendLen(sb, ":", 1);
+			sink_value(sb, &fields[x], true);
+		}
+
+		MTY_StrBufAppend(sb, "}\n");
+
+	} else {
+		MTY_StrBufPrintf(sb, "ts=%.3f level=%s thread=%lld func=", ts, sink_level(level), (long long) thread);
+		sink_logfmt_string(sb, func);
+		MTY_StrBufAppend(sb, " msg=");
+		sink_logfmt_string(sb, msg);
+		log_sink_fields(sb, fields, n);
+		MTY_StrBufAppendLen(sb, "\n", 1);
+	}
+
+	size_t len = MTY_StrBufLength(sb);
+
+	// Rotation happens on a record boundary, earlier records finish the current file
+	if (ctx->max_size > 0 && ctx->size + len > ctx->max_size && ctx->size + start > 0) {
+		sink_write(ctx, MTY_StrBufGet(sb), start);
+		sink_rotate(ctx);
+		sink_write(ctx, MTY_StrBufGet(sb) + start, len - start);
+		MTY_StrBufClear(sb);
+
+	} else if (len >= SINK_BUFFER) {
+		sink_flush(ctx);
+	}
+}
+
+
+// Internal
+
+static void sink_register_exit(void *opaque)
+{
+	// Buffered records are written out even if the sink is never closed
+	atexit(log_sink_close);
+}
+
+bool log_sink_open(const char *path, MTY_LogFormat format, size_t maxSize, uint32_t maxFiles)
+{
+	// Opened before taking the lock, failures here are logged
+	FILE *f = mty_fopen(path, "ab");
+	if (!f)
+		return false;
+
+	MTY_Once(&SINK_EXIT, sink_register_exit, NULL);
+
+	// The previous sink is inactive before it flushes, so anything logged while rotating skips it
+	log_sink_close();
+
+	sink_lock();
+
+	struct log_sink *ctx = &SINK;
+	memset(ctx, 0, sizeof(struct log_sink));
+
+	snprintf(ctx->path, MTY_PATH_MAX, "%s", path);
+	ctx->f = f;
+	ctx->format = format;
+	ctx->max_size = maxSize;
+	ctx->max_files = maxFiles;
+	ctx->buf = MTY_StrBufCreate(SINK_BUFFER + 4096);
+
+	ctx->size = mty_file_size(path);
+
+	// Records carry wall clock seconds derived from the monotonic timestamp
+	ctx->epoch = (double) time(NULL);
+	ctx->base = MTY_Timestamp();
+
+	MTY_Atomic32Set(&SINK_ACTIVE, 1);
+
+	sink_unlock();
+
+	return true;
+}
+
+bool log_sink_active(void)
+{
+	return MTY_Atomic32Get(&SINK_ACTIVE) != 0;
+}
+
+void log_sink_write(int64_t timestamp, int64_t thread, MTY_LogLevel level, const char *func,
+	const char *msg, const MTY_LogField *fields, uint32_t n)
+{
+	if (!log_sink_active())
+		return;
+
+	sink_lock();
+
+	if (SINK.buf)
+		sink_record(&SINK, timestamp, thread, level, func, msg, fields, n);
+
+	sink_unlock();
+}
+
+void log_sink_flush(void)
+{
+	if (!log_sink_active() || SINK_HELD)
+		return;
+
+	sink_lock();
+
+	if (SINK.buf)
+		sink_flush(&SINK);
+
+	sink_unlock();
+}
+
+void log_sink_close(void)
+{
+	sink_lock();
+
+	MTY_Atomic32Set(&SINK_ACTIVE, 0);
+
+	if (SINK.buf) {
+		sink_flush(&SINK);
+		MTY_StrBufDestroy(&SINK.buf);
+	}
+
+	if (SINK.f) {
+		fclose(SINK.f);
+		SINK.f = NULL;
+	}
+
+	sink_unlock();
+}
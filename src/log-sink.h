@@ -0,0 +1,17 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "matoya.h"
+
+bool log_sink_open(const char *path, MTY_LogFormat format, size_t maxSize, uint32_t maxFiles);
+bool log_sink_active(void);
+void log_sink_write(int64_t timestamp, int64_t thread, MTY_LogLevel level, const char *func,
+	const char *msg, const MTY_LogField *fields, uint32_t n);
+void log_sink_flush(void);
+void log_sink_close(void);
+void log_sink_fields(MTY_StrBuf *sb, const MTY_LogField *fields, uint32_t n);
@@ -8,10 +8,70 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "mty-tls.h"
+#include "log-sink.h"
+#include "thread-exit.h"
 
-#define LOG_LEN 256
+#define LOG_LEN      256
+#define LOG_RING_LEN 128
+#define LOG_RINGS    8
+#define LOG_FLUSH_MS 10
+#define LOG_MODULES  32
+#define LOG_SITES    512
+#define LOG_PROBES   8
+#define LOG_REPEAT_MS 1000.0f
+
+struct log_kv {
+	const char *msg;
+	uint32_t n;
+	MTY_LogField fields[];
+};
+
+struct log_cell {
+	MTY_Atomic32 seq;
+	const char *func;
+	const char *fmt;
+	int64_t timestamp;
+	int64_t thread;
+	MTY_LogLevel level;
+	char *heap;
+	struct log_kv *kv;
+	size_t size;
+	uint8_t data[LOG_LEN];
+};
+
+struct log_module {
+	char name[32];
+	MTY_Atomic32 level;
+};
+
+struct log_site {
+	MTY_Atomic64 key;
+	MTY_Atomic32 lock;
+	int64_t last;
+	float tokens;
+	uint32_t suppressed;
+};
+
+struct log_repeat {
+	struct log_repeat *next;
+	MTY_Atomic32 lock;
+	char msg[LOG_LEN];
+	const char *func;
+	MTY_LogLevel level;
+	int64_t ts;
+	uint32_t count;
+};
+
+struct log_ring {
+	MTY_Atomic32 write;
+	MTY_Atomic32 read;
+	MTY_Atomic64 dropped;
+	int64_t reported;
+	struct log_cell cells[LOG_RING_LEN];
+};
 
 static void log_none(const char *msg, void *opaque)
 {
@@ -22,37 +82,1101 @@ static void *LOG_OPAQUE;
 
 static MTY_TLS char LOG_MSG[LOG_LEN];
 static MTY_TLS char LOG_FMT[LOG_LEN];
+static MTY_TLS const char *LOG_BIN_FUNC;
+static MTY_TLS const char *LOG_BIN_FMT;
+static MTY_TLS uint8_t LOG_BIN[LOG_LEN];
+static MTY_TLS size_t LOG_BIN_SIZE;
 static MTY_TLS bool LOG_PREVENT_RECURSIVE;
+static MTY_TLS int64_t LOG_ORIGIN_TIMESTAMP;
+static MTY_TLS int64_t LOG_ORIGIN_THREAD;
+static MTY_TLS struct log_repeat *LOG_PREV;
 static MTY_Atomic32 LOG_DISABLED;
 
-static void log_internal(const char *func, const char *msg, va_list args)
+static struct log_module LOG_MODULE[LOG_MODULES];
+static MTY_Atomic32 LOG_MODULE_LOCK;
+static MTY_Atomic32 LOG_NUM_MODULES;
+static MTY_Atomic32 LOG_LEVEL = {MTY_LOG_INFO};
+static MTY_Atomic32 LOG_FLOOR = {MTY_LOG_INFO};
+
+static struct log_site LOG_SITE[LOG_SITES];
+static MTY_Atomic32 LOG_RATE;
+static MTY_Atomic32 LOG_BURST = {100};
+
+static struct log_repeat *LOG_REPEATS;
+static MTY_Atomic32 LOG_REPEAT_LOCK;
+static MTY_Atomic64 LOG_REPEAT_SCAN;
+
+static struct log_ring LOG_RING[LOG_RINGS];
+static MTY_TLS uint32_t LOG_RING_INDEX;
+static MTY_Atomic32 LOG_RING_NEXT;
+static MTY_Atomic32 LOG_ASYNC;
+static MTY_Atomic32 LOG_PRODUCERS;
+static MTY_Atomic32 LOG_ASYNC_INIT;
+static MTY_Atomic32 LOG_DRAIN_LOCK;
+static MTY_Atomic32 LOG_RUNNING;
+static MTY_Thread *LOG_THREAD;
+static MTY_Sync *LOG_SYNC;
+
+
+// Rate limiting, a token bucket per call site keyed by the function and format pointers
+
+static bool log_site_take(struct log_site *site, int32_t rate, int32_t burst, uint32_t *suppressed)
+{
+	int64_t now = MTY_Timestamp();
+
+	MTY_GlobalLock(&site->lock);
+
+	if (site->last == 0) {
+		site->tokens = (float) burst;
+
+	} else {
+		site->tokens += MTY_TimeDiff(site->last, now) * (float) rate / 1000.0f;
+
+		if (site->tokens > (float) burst)
+			site->tokens = (float) burst;
+	}
+
+	site->last = now;
+
+	bool allow = site->tokens >= 1.0f;
+
+	if (allow) {
+		site->tokens -= 1.0f;
+		*suppressed = site->suppressed;
+		site->suppressed = 0;
+
+	} else {
+		site->suppressed++;
+	}
+
+	MTY_GlobalUnlock(&site->lock);
+
+	return allow;
+}
+
+static bool log_limit(const char *func, const char *fmt, uint32_t *suppressed)
+{
+	*suppressed = 0;
+
+	int32_t rate = MTY_Atomic32Get(&LOG_RATE);
+	if (rate <= 0)
+		return true;
+
+	int64_t key = (int64_t) ((uintptr_t) fmt ^ ((uintptr_t) func << 7));
+	if (key == 0)
+		key = 1;
+
+	uint32_t h = (uint32_t) (((uint64_t) key * 0x9E3779B97F4A7C15ull) >> 32);
+
+	for (uint32_t x = 0; x < LOG_PROBES; x++) {
+		struct log_site *site = &LOG_SITE[(h + x) % LOG_SITES];
+		int64_t cur = MTY_Atomic64Get(&site->key);
+
+		if (cur == 0) {
+			MTY_Atomic64CAS(&site->key, 0, key);
+			cur = MTY_Atomic64Get(&site->key);
+		}
+
+		if (cur == key)
+			return log_site_take(site, rate, MTY_Atomic32Get(&LOG_BURST), suppressed);
+	}
+
+	// The table is crowded around this site, let it through unlimited
+	return true;
+}
+
+
+// Binary records, arguments are packed by type at the call site and formatted on the drain thread
+
+enum log_arg {
+	LOG_ARG_NONE,
+	LOG_ARG_INT,
+	LOG_ARG_UINT,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_STR,
+	LOG_ARG_PTR,
+	LOG_ARG_COUNT,
+	LOG_ARG_INVALID,
+};
+
+enum log_length {
+	LOG_LENGTH_NONE,
+	LOG_LENGTH_HH,
+	LOG_LENGTH_H,
+	LOG_LENGTH_L,
+	LOG_LENGTH_LL,
+	LOG_LENGTH_J,
+	LOG_LENGTH_Z,
+	LOG_LENGTH_T,
+	LOG_LENGTH_LD,
+};
+
+struct log_spec {
+	enum log_arg type;
+	enum log_length length;
+	char conv;
+	size_t flags;
+	size_t width;
+	size_t width_len;
+	size_t prec;
+	size_t prec_len;
+	bool width_star;
+	bool prec_star;
+	bool has_prec;
+	size_t len;
+};
+
+static void log_spec_parse(const char *s, struct log_spec *spec)
+{
+	memset(spec, 0, sizeof(struct log_spec));
+
+	size_t n = 1;
+
+	while (s[n] && strchr("-+ #0", s[n]))
+		n++;
+
+	spec->flags = n;
+	spec->width = n;
+
+	if (s[n] == '*') {
+		spec->width_star = true;
+		n++;
+
+	} else {
+		while (s[n] >= '0' && s[n] <= '9')
+			n++;
+	}
+
+	spec->width_len = n - spec->width;
+
+	if (s[n] == '.') {
+		spec->has_prec = true;
+		spec->prec = ++n;
+
+		if (s[n] == '*') {
+			spec->prec_star = true;
+			n++;
+
+		} else {
+			while (s[n] >= '0' && s[n] <= '9')
+				n++;
+		}
+
+		spec->prec_len = n - spec->prec;
+	}
+
+	switch (s[n]) {
+		case 'h': spec->length = s[n + 1] == 'h' ? LOG_LENGTH_HH : LOG_LENGTH_H; break;
+		case 'l': spec->length = s[n + 1] == 'l' ? LOG_LENGTH_LL : LOG_LENGTH_L; break;
+		case 'j': spec->length = LOG_LENGTH_J;  break;
+		case 'z': spec->length = LOG_LENGTH_Z;  break;
+		case 't': spec->length = LOG_LENGTH_T;  break;
+		case 'L': spec->length = LOG_LENGTH_LD; break;
+	}
+
+	if (spec->length == LOG_LENGTH_HH || spec->length == LOG_LENGTH_LL) {
+		n += 2;
+
+	} else if (spec->length != LOG_LENGTH_NONE) {
+		n++;
+	}
+
+	spec->conv = s[n];
+	spec->len = s[n] ? n + 1 : n;
+
+	switch (spec->conv) {
+		case 'd': case 'i': case 'c':
+			spec->type = LOG_ARG_INT;
+			break;
+		case 'u': case 'o': case 'x': case 'X':
+			spec->type = LOG_ARG_UINT;
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			spec->type = LOG_ARG_DOUBLE;
+			break;
+		case 's':
+			spec->type = LOG_ARG_STR;
+			break;
+		case 'p':
+			spec->type = LOG_ARG_PTR;
+			break;
+		case 'n':
+			spec->type = LOG_ARG_COUNT;
+			break;
+		case '%':
+			spec->type = LOG_ARG_NONE;
+			break;
+		default:
+			spec->type = LOG_ARG_INVALID;
+			break;
+	}
+}
+
+static bool log_pack(uint8_t *data, size_t *offset, const void *value, size_t size)
+{
+	if (*offset + size > LOG_LEN)
+		return false;
+
+	memcpy(data + *offset, value, size);
+	*offset += size;
+
+	return true;
+}
+
+static bool log_unpack(const uint8_t *data, size_t *offset, size_t end, void *value, size_t size)
+{
+	if (*offset + size > end)
+		return false;
+
+	memcpy(value, data + *offset, size);
+	*offset += size;
+
+	return true;
+}
+
+static size_t log_pack_args(const char *fmt, va_list args, uint8_t *data)
+{
+	size_t o = 0;
+
+	for (const char *s = fmt; *s; s++) {
+		if (*s != '%')
+			continue;
+
+		struct log_spec spec;
+		log_spec_parse(s, &spec);
+		s += spec.len - 1;
+
+		// Anything after an unknown conversion can't be read from the va_list safely
+		if (spec.type == LOG_ARG_INVALID)
+			break;
+
+		if (spec.width_star) {
+			int64_t v = va_arg(args, int);
+			log_pack(data, &o, &v, sizeof(int64_t));
+		}
+
+		if (spec.prec_star) {
+			int64_t v = va_arg(args, int);
+			log_pack(data, &o, &v, sizeof(int64_t));
+		}
+
+		switch (spec.type) {
+			case LOG_ARG_INT: {
+				int64_t v = 0;
+
+				switch (spec.length) {
+					case LOG_LENGTH_L:  v = va_arg(args, long);      break;
+					case LOG_LENGTH_LL: v = va_arg(args, long long); break;
+					case LOG_LENGTH_J:  v = va_arg(args, intmax_t);  break;
+					case LOG_LENGTH_Z:  v = va_arg(args, size_t);    break;
+					case LOG_LENGTH_T:  v = va_arg(args, ptrdiff_t); break;
+					default:            v = va_arg(args, int);       break;
+				}
+
+				log_pack(data, &o, &v, sizeof(int64_t));
+				break;
+			}
+			case LOG_ARG_UINT: {
+				uint64_t v = 0;
+
+				switch (spec.length) {
+					case LOG_LENGTH_L:  v = va_arg(args, unsigned long);      break;
+					case LOG_LENGTH_LL: v = va_arg(args, unsigned long long); break;
+					case LOG_LENGTH_J:  v = va_arg(args, uintmax_t);          break;
+					case LOG_LENGTH_Z:  v = va_arg(args, size_t);             break;
+					case LOG_LENGTH_T:  v = va_arg(args, ptrdiff_t);          break;
+					default:            v = va_arg(args, unsigned);           break;
+				}
+
+				log_pack(data, &o, &v, sizeof(uint64_t));
+				break;
+			}
+			case LOG_ARG_DOUBLE: {
+				double v = spec.length == LOG_LENGTH_LD ? (double) va_arg(args, long double) :
+					va_arg(args, double);
+
+				log_pack(data, &o, &v, sizeof(double));
+				break;
+			}
+			case LOG_ARG_STR: {
+				// Strings are the one argument that must be copied, the pointer may not outlive the call
+				const char *v = va_arg(args, const char *);
+				if (!v)
+					v = "(null)";
+
+				size_t avail = o + sizeof(uint16_t) < LOG_LEN ? LOG_LEN - o - sizeof(uint16_t) : 0;
+				size_t len = strlen(v);
+
+				if (avail == 0)
+					return LOG_LEN;
+
+				if (len >= avail)
+					len = avail - 1;
+
+				uint16_t len16 = (uint16_t) len;
+				log_pack(data, &o, &len16, sizeof(uint16_t));
+				memcpy(data + o, v, len);
+				data[o + len] = '\0';
+				o += len + 1;
+				break;
+			}
+			case LOG_ARG_PTR: {
+				uint64_t v = (uintptr_t) va_arg(args, void *);
+				log_pack(data, &o, &v, sizeof(uint64_t));
+				break;
+			}
+			case LOG_ARG_COUNT:
+				va_arg(args, int *);
+				break;
+			default:
+				break;
+		}
+	}
+
+	return o;
+}
+
+static void log_format_binary(const char *func, const char *fmt, const uint8_t *data, size_t size,
+	char *msg, size_t len)
+{
+	int32_t r = snprintf(msg, len, "%s: ", func);
+	size_t n = r > 0 ? r : 0;
+	size_t o = 0;
+
+	for (const char *s = fmt; *s && n + 1 < len; s++) {
+		if (*s != '%') {
+			msg[n++] = *s;
+			continue;
+		}
+
+		struct log_spec spec;
+		log_spec_parse(s, &spec);
+
+		if (spec.type == LOG_ARG_INVALID)
+			break;
+
+		if (spec.type == LOG_ARG_NONE) {
+			msg[n++] = '%';
+			s += spec.len - 1;
+			continue;
+		}
+
+		// Rebuild the specifier with star values substituted and a canonical length
+		char tmp[64] = "%";
+		size_t t = 1;
+		int64_t width = 0;
+		int64_t prec = 0;
+
+		if (spec.width_star && !log_unpack(data, &o, size, &width, sizeof(int64_t)))
+			break;
+
+		if (spec.prec_star && !log_unpack(data, &o, size, &prec, sizeof(int64_t)))
+			break;
+
+		if (spec.width + spec.width_len + spec.prec_len + 32 > sizeof(tmp))
+			break;
+
+		memcpy(tmp + t, s + 1, spec.flags - 1);
+		t += spec.flags - 1;
+
+		if (spec.width_star) {
+			t += snprintf(tmp + t, sizeof(tmp) - t, "%d", (int) width);
+
+		} else {
+			memcpy(tmp + t, s + spec.width, spec.width_len);
+			t += spec.width_len;
+		}
+
+		if (spec.has_prec) {
+			if (spec.prec_star) {
+				if (prec >= 0)
+					t += snprintf(tmp + t, sizeof(tmp) - t, ".%d", (int) prec);
+
+			} else {
+				tmp[t++] = '.';
+				memcpy(tmp + t, s + spec.prec, spec.prec_len);
+				t += spec.prec_len;
+			}
+		}
+
+		s += spec.len - 1;
+
+		char *out = msg + n;
+		size_t avail = len - n;
+		r = 0;
+
+		switch (spec.type) {
+			case LOG_ARG_INT: {
+				int64_t v = 0;
+				if (!log_unpack(data, &o, size, &v, sizeof(int64_t)))
+					goto except;
+
+				if (spec.length == LOG_LENGTH_HH) v = (signed char) v;
+				if (spec.length == LOG_LENGTH_H) v = (short) v;
+
+				if (spec.conv == 'c') {
+					snprintf(tmp + t, sizeof(tmp) - t, "c");
+					r = snprintf(out, avail, tmp, (int) v);
+
+				} else {
+					snprintf(tmp + t, sizeof(tmp) - t, "ll%c", spec.conv);
+					r = snprintf(out, avail, tmp, (long long) v);
+				}
+				break;
+			}
+			case LOG_ARG_UINT: {
+				uint64_t v = 0;
+				if (!log_unpack(data, &o, size, &v, sizeof(uint64_t)))
+					goto except;
+
+				if (spec.length == LOG_LENGTH_HH) v = (unsigned char) v;
+				if (spec.length == LOG_LENGTH_H) v = (unsigned short) v;
+				if (spec.length == LOG_LENGTH_NONE) v = (unsigned) v;
+
+				snprintf(tmp + t, sizeof(tmp) - t, "ll%c", spec.conv);
+				r = snprintf(out, avail, tmp, (unsigned long long) v);
+				break;
+			}
+			case LOG_ARG_DOUBLE: {
+				double v = 0;
+				if (!log_unpack(data, &o, size, &v, sizeof(double)))
+					goto except;
+
+				snprintf(tmp + t, sizeof(tmp) - t, "%c", spec.conv);
+				r = snprintf(out, avail, tmp, v);
+				break;
+			}
+			case LOG_ARG_STR: {
+				uint16_t slen = 0;
+				if (!log_unpack(data, &o, size, &slen, sizeof(uint16_t)) || o + slen + 1 > size)
+					goto except;
+
+				snprintf(tmp + t, sizeof(tmp) - t, "s");
+				r = snprintf(out, avail, tmp, (const char *) data + o);
+				o += slen + 1;
+				break;
+			}
+			case LOG_ARG_PTR: {
+				uint64_t v = 0;
+				if (!log_unpack(data, &o, size, &v, sizeof(uint64_t)))
+					goto except;
+
+				snprintf(tmp + t, sizeof(tmp) - t, "p");
+				r = snprintf(out, avail, tmp, (void *) (uintptr_t) v);
+				break;
+			}
+			default:
+				break;
+		}
+
+		if (r > 0)
+			n += (size_t) r < avail ? (size_t) r : avail - 1;
+	}
+
+	except:
+
+	msg[n < len ? n : len - 1] = '\0';
+}
+
+
+// Rings, bounded multi-producer queues with a single consumer holding LOG_DRAIN_LOCK
+
+static struct log_cell *log_ring_claim(struct log_ring *ring, uint32_t *pos)
+{
+	while (true) {
+		*pos = MTY_Atomic32Get(&ring->write);
+		struct log_cell *cell = &ring->cells[*pos % LOG_RING_LEN];
+		int32_t diff = (int32_t) ((uint32_t) MTY_Atomic32Get(&cell->seq) - *pos);
+
+		if (diff < 0)
+			return NULL;
+
+		if (diff == 0 && MTY_Atomic32CAS(&ring->write, *pos, *pos + 1))
+			return cell;
+	}
+}
+
+static bool log_ring_pop(struct log_ring *ring)
+{
+	uint32_t pos = MTY_Atomic32Get(&ring->read);
+	struct log_cell *cell = &ring->cells[pos % LOG_RING_LEN];
+
+	if ((uint32_t) MTY_Atomic32Get(&cell->seq) != pos + 1)
+		return false;
+
+	LOG_ORIGIN_TIMESTAMP = cell->timestamp;
+	LOG_ORIGIN_THREAD = cell->thread;
+
+	if (cell->fmt) {
+		char msg[LOG_LEN];
+		log_format_binary(cell->func, cell->fmt, cell->data, cell->size, msg, LOG_LEN);
+
+		// Binary records reach the sink here since they were never formatted on the producer
+		size_t prefix = strlen(cell->func) + 2;
+		log_sink_write(cell->timestamp, cell->thread, cell->level, cell->func,
+			strlen(msg) >= prefix ? msg + prefix : "", NULL, 0);
+
+		LOG_CALLBACK(msg, LOG_OPAQUE);
+
+	} else {
+		const char *text = cell->heap ? cell->heap : (const char *) cell->data;
+
+		// Records reach the sink here so producers never wait on its lock or the file
+		if (cell->kv) {
+			log_sink_write(cell->timestamp, cell->thread, cell->level, cell->func, cell->kv->msg,
+				cell->kv->fields, cell->kv->n);
+
+		} else if (log_sink_active()) {
+			size_t prefix = strlen(cell->func) + 2;
+			log_sink_write(cell->timestamp, cell->thread, cell->level, cell->func,
+				strlen(text) >= prefix ? text + prefix : "", NULL, 0);
+		}
+
+		LOG_CALLBACK(text, LOG_OPAQUE);
+
+		MTY_Free(cell->heap);
+		cell->heap = NULL;
+
+		MTY_Free(cell->kv);
+		cell->kv = NULL;
+	}
+
+	LOG_ORIGIN_TIMESTAMP = 0;
+
+	MTY_Atomic32Set(&cell->seq, pos + LOG_RING_LEN);
+	MTY_Atomic32Set(&ring->read, pos + 1);
+
+	return true;
+}
+
+static void log_drain(void)
+{
+	MTY_GlobalLock(&LOG_DRAIN_LOCK);
+	LOG_PREVENT_RECURSIVE = true;
+
+	for (uint32_t x = 0; x < LOG_RINGS; x++) {
+		struct log_ring *ring = &LOG_RING[x];
+
+		while (log_ring_pop(ring));
+
+		int64_t dropped = MTY_Atomic64Get(&ring->dropped);
+
+		if (dropped > ring->reported) {
+			char msg[LOG_LEN];
+			snprintf(msg, LOG_LEN, "%s: %lld log messages were dropped", __FUNCTION__,
+				(long long) (dropped - ring->reported));
+
+			LOG_CALLBACK(msg, LOG_OPAQUE);
+			ring->reported = dropped;
+		}
+	}
+
+	log_sink_flush();
+
+	LOG_PREVENT_RECURSIVE = false;
+	MTY_GlobalUnlock(&LOG_DRAIN_LOCK);
+}
+
+static struct log_cell *log_claim(MTY_LogAsyncPolicy policy, struct log_ring **ring, uint32_t *pos)
+{
+	// Threads are spread across the rings round-robin on their first message
+	if (LOG_RING_INDEX == 0)
+		LOG_RING_INDEX = (uint32_t) MTY_Atomic32Add(&LOG_RING_NEXT, 1) % LOG_RINGS + 1;
+
+	*ring = &LOG_RING[LOG_RING_INDEX - 1];
+
+	while (true) {
+		struct log_cell *cell = log_ring_claim(*ring, pos);
+
+		if (cell) {
+			cell->timestamp = MTY_Timestamp();
+			cell->thread = MTY_ThreadGetID(NULL);
+
+			return cell;
+		}
+
+		if (policy == MTY_LOG_ASYNC_DROP || MTY_Atomic32Get(&LOG_ASYNC) == 0) {
+			MTY_Atomic64Add(&(*ring)->dropped, 1);
+			return NULL;
+		}
+
+		MTY_SyncWake(LOG_SYNC);
+		MTY_Sleep(1);
+	}
+}
+
+static void log_commit(struct log_ring *ring, struct log_cell *cell, uint32_t pos)
+{
+	MTY_Atomic32Set(&cell->seq, pos + 1);
+
+	// Wake the flusher early rather than waiting out the interval once the ring is half full
+	uint32_t pending = (uint32_t) MTY_Atomic32Get(&ring->write) - (uint32_t) MTY_Atomic32Get(&ring->read);
+
+	if (pending == LOG_RING_LEN / 2)
+		MTY_SyncWake(LOG_SYNC);
+}
+
+static struct log_kv *log_kv_copy(const char *msg, const MTY_LogField *fields, uint32_t n)
+{
+	// Fields are copied into a single block since their strings may not outlive the call
+	size_t size = sizeof(struct log_kv) + n * sizeof(MTY_LogField) + strlen(msg) + 1;
+
+	for (uint32_t x = 0; x < n; x++) {
+		size += strlen(fields[x].key) + 1;
+
+		if (fields[x].type == MTY_LOG_FIELD_STR && fields[x].value.s)
+			size += strlen(fields[x].value.s) + 1;
+	}
+
+	struct log_kv *kv = MTY_Alloc(size, 1);
+	char *str = (char *) &kv->fields[n];
+
+	kv->n = n;
+	kv->msg = str;
+	str += sprintf(str, "%s", msg) + 1;
+
+	for (uint32_t x = 0; x < n; x++) {
+		kv->fields[x] = fields[x];
+		kv->fields[x].key = str;
+		str += sprintf(str, "%s", fields[x].key) + 1;
+
+		if (fields[x].type == MTY_LOG_FIELD_STR && fields[x].value.s) {
+			kv->fields[x].value.s = str;
+			str += sprintf(str, "%s", fields[x].value.s) + 1;
+		}
+	}
+
+	return kv;
+}
+
+static void log_async(MTY_LogLevel level, const char *func, const char *text, const char *msg,
+	const MTY_LogField *fields, uint32_t n, MTY_LogAsyncPolicy policy)
+{
+	struct log_ring *ring = NULL;
+	uint32_t pos = 0;
+
+	struct log_cell *cell = log_claim(policy, &ring, &pos);
+	if (!cell)
+		return;
+
+	size_t len = strlen(text) + 1;
+
+	// Only structured records can exceed a cell, those keep their full length
+	if (len > LOG_LEN) {
+		cell->heap = MTY_Dup(text, len);
+
+	} else {
+		memcpy(cell->data, text, len);
+	}
+
+	if (fields && log_sink_active())
+		cell->kv = log_kv_copy(msg, fields, n);
+
+	cell->level = level;
+	cell->func = func;
+	cell->fmt = NULL;
+	cell->size = len;
+
+	log_commit(ring, cell, pos);
+}
+
+static void log_async_binary(MTY_LogLevel level, const char *func, const char *fmt, const uint8_t *data,
+	size_t size, MTY_LogAsyncPolicy policy)
+{
+	struct log_ring *ring = NULL;
+	uint32_t pos = 0;
+
+	struct log_cell *cell = log_claim(policy, &ring, &pos);
+	if (!cell)
+		return;
+
+	cell->level = level;
+	cell->func = func;
+	cell->fmt = fmt;
+	cell->size = size;
+	memcpy(cell->data, data, size);
+
+	log_commit(ring, cell, pos);
+}
+
+static bool log_async_enter(int32_t *async)
+{
+	// Producers are counted so MTY_LogAsyncStop can wait out any that saw async mode
+	// before it was turned off
+	MTY_Atomic32Add(&LOG_PRODUCERS, 1);
+	*async = MTY_Atomic32Get(&LOG_ASYNC);
+
+	if (*async == 0) {
+		MTY_Atomic32Add(&LOG_PRODUCERS, -1);
+		return false;
+	}
+
+	return true;
+}
+
+static void log_async_leave(void)
+{
+	MTY_Atomic32Add(&LOG_PRODUCERS, -1);
+}
+
+static void log_repeat_poll(int64_t now);
+
+static void *log_thread(void *opaque)
+{
+	while (MTY_Atomic32Get(&LOG_RUNNING)) {
+		MTY_SyncWait(LOG_SYNC, LOG_FLUSH_MS);
+		log_repeat_poll(MTY_Timestamp());
+		log_drain();
+	}
+
+	return NULL;
+}
+
+static void log_async_init(void *opaque)
+{
+	for (uint32_t x = 0; x < LOG_RINGS; x++)
+		for (uint32_t y = 0; y < LOG_RING_LEN; y++)
+			MTY_Atomic32Set(&LOG_RING[x].cells[y].seq, y);
+
+	// Kept for the life of the process, a blocked producer may still be waking it after stop
+	LOG_SYNC = MTY_SyncCreate();
+}
+
+
+// Levels
+
+static bool log_filter(MTY_LogLevel level, const char *module)
+{
+	// The floor is the lowest level any filter lets through, so most rejections stop here
+	if ((int32_t) level < MTY_Atomic32Get(&LOG_FLOOR))
+		return false;
+
+	if (module) {
+		uint32_t num = MTY_Atomic32Get(&LOG_NUM_MODULES);
+
+		for (uint32_t x = 0; x < num; x++)
+			if (!strcmp(LOG_MODULE[x].name, module))
+				return (int32_t) level >= MTY_Atomic32Get(&LOG_MODULE[x].level);
+	}
+
+	return (int32_t) level >= MTY_Atomic32Get(&LOG_LEVEL);
+}
+
+static void log_set_floor(void)
+{
+	int32_t floor = MTY_Atomic32Get(&LOG_LEVEL);
+	uint32_t num = MTY_Atomic32Get(&LOG_NUM_MODULES);
+
+	for (uint32_t x = 0; x < num; x++) {
+		int32_t level = MTY_Atomic32Get(&LOG_MODULE[x].level);
+
+		if (level < floor)
+			floor = level;
+	}
+
+	MTY_Atomic32Set(&LOG_FLOOR, floor);
+}
+
+
+// Public
+
+static void log_deliver(MTY_LogLevel level, int64_t timestamp, const char *func, const char *text,
+	const char *msg, const MTY_LogField *fields, uint32_t n, bool fatal)
+{
+	int32_t async = 0;
+
+	if (!fatal && log_async_enter(&async)) {
+		log_async(level, func, text, msg, fields, n, async - 1);
+		log_async_leave();
+		return;
+	}
+
+	// Queued messages are delivered ahead of the fatal one
+	if (fatal && MTY_Atomic32Get(&LOG_ASYNC) > 0)
+		log_drain();
+
+	LOG_PREVENT_RECURSIVE = true;
+
+	if (log_sink_active())
+		log_sink_write(timestamp, MTY_ThreadGetID(NULL), level, func, msg, fields, n);
+
+	LOG_CALLBACK(text, LOG_OPAQUE);
+
+	LOG_PREVENT_RECURSIVE = false;
+}
+
+static void log_emit(MTY_LogLevel level, int64_t timestamp, const char *func, const char *msg, bool fatal)
+{
+	size_t prefix = strlen(func) + 2;
+
+	log_deliver(level, timestamp, func, msg, strlen(msg) >= prefix ? msg + prefix : "", NULL, 0, fatal);
+}
+
+static void log_suppressed(const char *func, uint32_t suppressed)
+{
+	char note[LOG_LEN];
+	snprintf(note, LOG_LEN, "%s: %u messages were suppressed by the rate limit", func, suppressed);
+
+	log_emit(MTY_LOG_WARN, MTY_Timestamp(), func, note, false);
+}
+
+
+// Repeats, identical messages from a thread collapse into a count. The count is
+// flushed by the thread's next different message, by a periodic scan once the
+// window since the first occurrence has passed, or when the thread exits
+
+static bool log_repeat_take(struct log_repeat *rec, char *note, MTY_LogLevel *level, const char **func)
+{
+	if (rec->count == 0)
+		return false;
+
+	snprintf(note, LOG_LEN, "%s: Previous message repeated %u times", rec->func, rec->count);
+	*level = rec->level;
+	*func = rec->func;
+	rec->count = 0;
+
+	return true;
+}
+
+static void log_repeat_flush(struct log_repeat *rec, int64_t now, bool force)
+{
+	char note[LOG_LEN];
+	MTY_LogLevel level = MTY_LOG_INFO;
+	const char *func = NULL;
+
+	MTY_GlobalLock(&rec->lock);
+
+	bool due = force || MTY_TimeDiff(rec->ts, now) >= LOG_REPEAT_MS;
+	bool flush = due && log_repeat_take(rec, note, &level, &func);
+
+	MTY_GlobalUnlock(&rec->lock);
+
+	if (flush && !MTY_Atomic32Get(&LOG_DISABLED))
+		log_emit(level, now, func, note, false);
+}
+
+static void log_repeat_scan(int64_t now, bool force)
+{
+	MTY_GlobalLock(&LOG_REPEAT_LOCK);
+
+	for (struct log_repeat *rec = LOG_REPEATS; rec; rec = rec->next)
+		log_repeat_flush(rec, now, force);
+
+	MTY_GlobalUnlock(&LOG_REPEAT_LOCK);
+}
+
+static void log_repeat_poll(int64_t now)
+{
+	// At most one scan per window across all threads
+	int64_t last = MTY_Atomic64Get(&LOG_REPEAT_SCAN);
+
+	if (MTY_TimeDiff(last, now) >= LOG_REPEAT_MS && MTY_Atomic64CAS(&LOG_REPEAT_SCAN, last, now))
+		log_repeat_scan(now, false);
+}
+
+static void log_repeat_exit(void *opaque)
+{
+	struct log_repeat *rec = opaque;
+
+	log_repeat_flush(rec, MTY_Timestamp(), true);
+
+	MTY_GlobalLock(&LOG_REPEAT_LOCK);
+
+	for (struct log_repeat **cur = &LOG_REPEATS; *cur; cur = &(*cur)->next) {
+		if (*cur == rec) {
+			*cur = rec->next;
+			break;
+		}
+	}
+
+	MTY_GlobalUnlock(&LOG_REPEAT_LOCK);
+
+	LOG_PREV = NULL;
+	MTY_Free(rec);
+}
+
+static struct log_repeat *log_repeat_get(void)
+{
+	if (!LOG_PREV) {
+		LOG_PREVENT_RECURSIVE = true;
+
+		struct log_repeat *rec = MTY_Alloc(1, sizeof(struct log_repeat));
+		thread_exit_hook(log_repeat_exit, rec);
+
+		MTY_GlobalLock(&LOG_REPEAT_LOCK);
+		rec->next = LOG_REPEATS;
+		LOG_REPEATS = rec;
+		MTY_GlobalUnlock(&LOG_REPEAT_LOCK);
+
+		LOG_PREV = rec;
+		LOG_PREVENT_RECURSIVE = false;
+	}
+
+	return LOG_PREV;
+}
+
+static bool log_repeat(MTY_LogLevel level, const char *func, bool fatal, int64_t now)
+{
+	struct log_repeat *rec = log_repeat_get();
+
+	char note[LOG_LEN];
+	MTY_LogLevel note_level = MTY_LOG_INFO;
+	const char *note_func = NULL;
+
+	MTY_GlobalLock(&rec->lock);
+
+	if (!fatal && rec->func && MTY_TimeDiff(rec->ts, now) < LOG_REPEAT_MS && !strcmp(LOG_MSG, rec->msg)) {
+		rec->count++;
+		MTY_GlobalUnlock(&rec->lock);
+
+		return true;
+	}
+
+	// The note carries the level of the message that repeated
+	bool flush = log_repeat_take(rec, note, &note_level, &note_func);
+
+	snprintf(rec->msg, LOG_LEN, "%s", LOG_MSG);
+	rec->func = func;
+	rec->level = level;
+	rec->ts = now;
+
+	MTY_GlobalUnlock(&rec->lock);
+
+	if (flush)
+		log_emit(note_level, now, note_func, note, false);
+
+	return false;
+}
+
+static void log_internal(MTY_LogLevel level, const char *func, const char *msg, va_list args, bool fatal)
 {
 	if (MTY_Atomic32Get(&LOG_DISABLED) || LOG_PREVENT_RECURSIVE)
 		return;
 
+	// MTY_GetLog reflects every message that passed the level filter, even when the
+	// rate limit keeps it from being delivered. Suppressed messages are only packed,
+	// MTY_GetLog formats them on demand
+	uint32_t suppressed = 0;
+
+	if (!fatal && !log_limit(func, msg, &suppressed)) {
+		LOG_BIN_SIZE = log_pack_args(msg, args, LOG_BIN);
+		LOG_BIN_FUNC = func;
+		LOG_BIN_FMT = msg;
+		return;
+	}
+
 	snprintf(LOG_FMT, LOG_LEN, "%s: %s", func, msg);
 	vsnprintf(LOG_MSG, LOG_LEN, LOG_FMT, args);
+	LOG_BIN_FMT = NULL;
 
-	LOG_PREVENT_RECURSIVE = true;
-	LOG_CALLBACK(LOG_MSG, LOG_OPAQUE);
-	LOG_PREVENT_RECURSIVE = false;
+	if (suppressed > 0)
+		log_suppressed(func, suppressed);
+
+	int64_t now = MTY_Timestamp();
+	log_repeat_poll(now);
+
+	if (log_repeat(level, func, fatal, now))
+		return;
+
+	log_emit(level, now, func, LOG_MSG, fatal);
 }
 
 void MTY_LogParams(const char *func, const char *msg, ...)
 {
+	if (!log_filter(MTY_LOG_INFO, NULL))
+		return;
+
 	va_list args;
 	va_start(args, msg);
-	log_internal(func, msg, args);
+	log_internal(MTY_LOG_INFO, func, msg, args, false);
 	va_end(args);
 }
 
+void MTY_LogLevelParams(MTY_LogLevel level, const char *module, const char *func, const char *msg, ...)
+{
+	if (!log_filter(level, module))
+		return;
+
+	va_list args;
+	va_start(args, msg);
+	log_internal(level, func, msg, args, false);
+	va_end(args);
+}
+
+void MTY_LogBinaryParams(MTY_LogLevel level, const char *module, const char *func, const char *fmt, ...)
+{
+	if (!log_filter(level, module))
+		return;
+
+	va_list args;
+	va_start(args, fmt);
+
+	int32_t async = 0;
+
+	// Without a drain thread there is nowhere to defer formatting to
+	if (!MTY_Atomic32Get(&LOG_DISABLED) && !LOG_PREVENT_RECURSIVE && log_async_enter(&async)) {
+		// The packed arguments are kept so MTY_GetLog can format them on demand
+		LOG_BIN_SIZE = log_pack_args(fmt, args, LOG_BIN);
+		LOG_BIN_FUNC = func;
+		LOG_BIN_FMT = fmt;
+
+		uint32_t suppressed = 0;
+
+		if (log_limit(func, fmt, &suppressed)) {
+			if (suppressed > 0)
+				log_suppressed(func, suppressed);
+
+			log_async_binary(level, func, fmt, LOG_BIN, LOG_BIN_SIZE, async - 1);
+		}
+
+		log_async_leave();
+
+	} else {
+		log_internal(level, func, fmt, args, false);
+	}
+
+	va_end(args);
+}
+
+void MTY_LogKVParams(MTY_LogLevel level, const char *module, const char *func, const char *msg,
+	const MTY_LogField *fields, uint32_t n)
+{
+	uint32_t suppressed = 0;
+
+	if (!log_filter(level, module) || !log_limit(func, msg, &suppressed))
+		return;
+
+	if (MTY_Atomic32Get(&LOG_DISABLED) || LOG_PREVENT_RECURSIVE)
+		return;
+
+	if (suppressed > 0)
+		log_suppressed(func, suppressed);
+
+	// Structured records are built on the heap and are never truncated
+	LOG_PREVENT_RECURSIVE = true;
+
+	MTY_StrBuf *sb = MTY_StrBufCreate(LOG_LEN);
+	MTY_StrBufPrintf(sb, "%s: %s", func, msg);
+	log_sink_fields(sb, fields, n);
+
+	LOG_PREVENT_RECURSIVE = false;
+
+	log_deliver(level, MTY_Timestamp(), func, MTY_StrBufGet(sb), msg, fields, n, false);
+
+	LOG_PREVENT_RECURSIVE = true;
+	MTY_StrBufDestroy(&sb);
+	LOG_PREVENT_RECURSIVE = false;
+}
+
 void MTY_FatalParams(const char *func, const char *msg, ...)
 {
 	va_list args;
 	va_start(args, msg);
-	log_internal(func, msg, args);
+	log_internal(MTY_LOG_ERROR, func, msg, args, true);
 	va_end(args);
 
+	MTY_LogSinkFlush();
+
 	_Exit(EXIT_FAILURE);
 }
 
@@ -67,7 +1191,144 @@ void MTY_DisableLog(bool disabled)
 	MTY_Atomic32Set(&LOG_DISABLED, disabled ? 1 : 0);
 }
 
+bool MTY_LogSinkOpen(const char *path, MTY_LogFormat format, size_t maxSize, uint32_t maxFiles)
+{
+	return log_sink_open(path, format, maxSize, maxFiles);
+}
+
+void MTY_LogSinkFlush(void)
+{
+	// Rotation may log from under the sink lock
+	LOG_PREVENT_RECURSIVE = true;
+	log_sink_flush();
+	LOG_PREVENT_RECURSIVE = false;
+}
+
+void MTY_LogSinkClose(void)
+{
+	LOG_PREVENT_RECURSIVE = true;
+	log_sink_close();
+	LOG_PREVENT_RECURSIVE = false;
+}
+
+void MTY_LogSetRateLimit(uint32_t rate, uint32_t burst)
+{
+	MTY_Atomic32Set(&LOG_BURST, burst > 0 ? burst : 1);
+	MTY_Atomic32Set(&LOG_RATE, rate);
+}
+
+void MTY_LogSetLevel(const char *module, MTY_LogLevel level)
+{
+	MTY_GlobalLock(&LOG_MODULE_LOCK);
+
+	if (module) {
+		uint32_t num = MTY_Atomic32Get(&LOG_NUM_MODULES);
+		uint32_t x = 0;
+
+		for (; x < num; x++)
+			if (!strcmp(LOG_MODULE[x].name, module))
+				break;
+
+		if (x == LOG_MODULES) {
+			MTY_Log("Could not add log module '%s', maximum is %u", module, LOG_MODULES);
+
+		} else {
+			MTY_Atomic32Set(&LOG_MODULE[x].level, level);
+
+			// Readers only see the entry once the count covers it
+			if (x == num) {
+				snprintf(LOG_MODULE[x].name, sizeof(LOG_MODULE[x].name), "%s", module);
+				MTY_Atomic32Set(&LOG_NUM_MODULES, num + 1);
+			}
+		}
+
+	} else {
+		MTY_Atomic32Set(&LOG_LEVEL, level);
+	}
+
+	log_set_floor();
+
+	MTY_GlobalUnlock(&LOG_MODULE_LOCK);
+}
+
+MTY_LogLevel MTY_LogGetLevel(const char *module)
+{
+	if (module) {
+		uint32_t num = MTY_Atomic32Get(&LOG_NUM_MODULES);
+
+		for (uint32_t x = 0; x < num; x++)
+			if (!strcmp(LOG_MODULE[x].name, module))
+				return MTY_Atomic32Get(&LOG_MODULE[x].level);
+	}
+
+	return MTY_Atomic32Get(&LOG_LEVEL);
+}
+
+void MTY_LogGetOrigin(int64_t *timestamp, int64_t *threadID)
+{
+	// Outside of the drain thread the message is being delivered where it was logged
+	bool queued = LOG_ORIGIN_TIMESTAMP != 0;
+
+	if (timestamp)
+		*timestamp = queued ? LOG_ORIGIN_TIMESTAMP : MTY_Timestamp();
+
+	if (threadID)
+		*threadID = queued ? LOG_ORIGIN_THREAD : MTY_ThreadGetID(NULL);
+}
+
 const char *MTY_GetLog(void)
 {
+	if (LOG_BIN_FMT) {
+		log_format_binary(LOG_BIN_FUNC, LOG_BIN_FMT, LOG_BIN, LOG_BIN_SIZE, LOG_MSG, LOG_LEN);
+		LOG_BIN_FMT = NULL;
+	}
+
 	return LOG_MSG;
 }
+
+void MTY_LogAsyncStart(MTY_LogAsyncPolicy policy)
+{
+	MTY_Once(&LOG_ASYNC_INIT, log_async_init, NULL);
+
+	if (LOG_THREAD) {
+		MTY_Atomic32Set(&LOG_ASYNC, policy + 1);
+		return;
+	}
+
+	MTY_Atomic32Set(&LOG_RUNNING, 1);
+	LOG_THREAD = MTY_ThreadCreate(log_thread, NULL);
+
+	MTY_Atomic32Set(&LOG_ASYNC, policy + 1);
+}
+
+void MTY_LogAsyncStop(void)
+{
+	if (!LOG_THREAD)
+		return;
+
+	// Pending repeat counts are queued behind the messages they follow
+	log_repeat_scan(MTY_Timestamp(), true);
+
+	MTY_Atomic32Set(&LOG_ASYNC, 0);
+
+	// Records from producers already past the check still reach the final drain
+	while (MTY_Atomic32Get(&LOG_PRODUCERS) > 0)
+		MTY_Sleep(0);
+
+	MTY_Atomic32Set(&LOG_RUNNING, 0);
+
+	MTY_SyncWake(LOG_SYNC);
+	MTY_ThreadDestroy(&LOG_THREAD);
+
+	log_drain();
+}
+
+uint64_t MTY_LogAsyncDropped(void)
+{
+	uint64_t dropped = 0;
+
+	for (uint32_t x = 0; x < LOG_RINGS; x++)
+		dropped += MTY_Atomic64Get(&LOG_RING[x].dropped);
+
+	return dropped;
+}
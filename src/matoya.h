@@ -158,11 +158,20 @@ typedef enum {
 } MTY_Dir;
 
 typedef enum {
-	MTY_FILE_MODE_WRITE   = 1,
-	MTY_FILE_MODE_READ    = 2,
-	MTY_FILE_MODE_MAKE_32 = 0x7FFFFFFF,
+	MTY_FILE_MODE_WRITE      = 1,
+	MTY_FILE_MODE_READ       = 2,
+	MTY_FILE_MODE_APPEND     = 3,
+	MTY_FILE_MODE_READ_WRITE = 4,
+	MTY_FILE_MODE_MAKE_32    = 0x7FFFFFFF,
 } MTY_FileMode;
 
+typedef enum {
+	MTY_SEEK_SET     = 0,
+	MTY_SEEK_CUR     = 1,
+	MTY_SEEK_END     = 2,
+	MTY_SEEK_MAKE_32 = 0x7FFFFFFF,
+} MTY_Seek;
+
 typedef struct {
 	char *path;
 	char *name;
@@ -174,7 +183,15 @@ typedef struct {
 	uint32_t len;
 } MTY_FileList;
 
+typedef enum {
+	MTY_MAP_READ_WRITE = 0x1,
+	MTY_MAP_SEQUENTIAL = 0x2,
+	MTY_MAP_RANDOM     = 0x4,
+	MTY_MAP_MAKE_32    = 0x7FFFFFFF,
+} MTY_MapFlag;
+
 typedef struct MTY_LockFile MTY_LockFile;
+typedef struct MTY_File MTY_File;
 
 MTY_EXPORT void *
 MTY_ReadFile(const char *path, size_t *size);
@@ -215,6 +232,46 @@ MTY_LockFileCreate(const char *path, MTY_FileMode mode);
 MTY_EXPORT void
 MTY_LockFileDestroy(MTY_LockFile **lock);
 
+// Maps an existing file in place without copying, writes through a MTY_MAP_READ_WRITE
+// mapping land in the file. Empty files can not be mapped and return NULL
+
+MTY_EXPORT void *
+MTY_MapFile(const char *path, MTY_MapFlag flags, size_t *size);
+
+MTY_EXPORT void
+MTY_UnmapFile(void *mem, size_t size);
+
+// A `bufSize` of 0 uses the default of 64 KB, reads and writes at least as large as the
+// buffer bypass it. `ReadAt` and `WriteAt` leave the position alone. Handles are not
+// safe to share between threads
+
+MTY_EXPORT MTY_File *
+MTY_FileOpen(const char *path, MTY_FileMode mode, size_t bufSize);
+
+MTY_EXPORT size_t
+MTY_FileRead(MTY_File *ctx, void *data, size_t size);
+
+MTY_EXPORT bool
+MTY_FileWrite(MTY_File *ctx, const void *data, size_t size);
+
+MTY_EXPORT bool
+MTY_FileWriteText(MTY_File *ctx, const char *fmt, ...);
+
+MTY_EXPORT int64_t
+MTY_FileSeek(MTY_File *ctx, int64_t offset, MTY_Seek whence);
+
+MTY_EXPORT size_t
+MTY_FileReadAt(MTY_File *ctx, void *data, size_t size, uint64_t offset);
+
+MTY_EXPORT bool
+MTY_FileWriteAt(MTY_File *ctx, const void *data, size_t size, uint64_t offset);
+
+MTY_EXPORT bool
+MTY_FileFlush(MTY_File *ctx);
+
+MTY_EXPORT void
+MTY_FileClose(MTY_File **file);
+
 MTY_EXPORT const char *
 MTY_GetFileName(const char *path, bool extension);
 
@@ -393,6 +450,49 @@ MTY_JSONArrayAppend(MTY_JSON *json, const MTY_JSON *value);
 
 /// @module log
 
+typedef enum {
+	MTY_LOG_ASYNC_DROP    = 0,
+	MTY_LOG_ASYNC_BLOCK   = 1,
+	MTY_LOG_ASYNC_MAKE_32 = 0x7FFFFFFF,
+} MTY_LogAsyncPolicy;
+
+typedef enum {
+	MTY_LOG_TRACE   = 0,
+	MTY_LOG_DEBUG   = 1,
+	MTY_LOG_INFO    = 2,
+	MTY_LOG_WARN    = 3,
+	MTY_LOG_ERROR   = 4,
+	MTY_LOG_NONE    = 5,
+	MTY_LOG_MAKE_32 = 0x7FFFFFFF,
+} MTY_LogLevel;
+
+typedef enum {
+	MTY_LOG_FORMAT_JSON    = 0,
+	MTY_LOG_FORMAT_LOGFMT  = 1,
+	MTY_LOG_FORMAT_MAKE_32 = 0x7FFFFFFF,
+} MTY_LogFormat;
+
+typedef enum {
+	MTY_LOG_FIELD_STR     = 0,
+	MTY_LOG_FIELD_INT     = 1,
+	MTY_LOG_FIELD_UINT    = 2,
+	MTY_LOG_FIELD_FLOAT   = 3,
+	MTY_LOG_FIELD_BOOL    = 4,
+	MTY_LOG_FIELD_MAKE_32 = 0x7FFFFFFF,
+} MTY_LogFieldType;
+
+typedef struct {
+	const char *key;
+	MTY_LogFieldType type;
+	union {
+		const char *s;
+		int64_t i;
+		uint64_t u;
+		double f;
+		bool b;
+	} value;
+} MTY_LogField;
+
 MTY_EXPORT void
 MTY_SetLogCallback(void (*callback)(const char *msg, void *opaque), const void *opaque);
 
@@ -402,14 +502,137 @@ MTY_DisableLog(bool disabled);
 MTY_EXPORT void
 MTY_LogParams(const char *func, const char *msg, ...);
 
+MTY_EXPORT void
+MTY_LogLevelParams(MTY_LogLevel level, const char *module, const char *func, const char *msg, ...);
+
+MTY_EXPORT void
+MTY_LogBinaryParams(MTY_LogLevel level, const char *module, const char *func, const char *fmt, ...);
+
+MTY_EXPORT void
+MTY_LogKVParams(MTY_LogLevel level, const char *module, const char *func, const char *msg,
+	const MTY_LogField *fields, uint32_t n);
+
 MTY_EXPORT void
 MTY_FatalParams(const char *func, const char *msg, ...);
 
 MTY_EXPORT const char *
 MTY_GetLog(void);
 
-#define MTY_Log(msg, ...) \
-	MTY_LogParams(__FUNCTION__, msg, ##__VA_ARGS__)
+MTY_EXPORT void
+MTY_LogAsyncStart(MTY_LogAsyncPolicy policy);
+
+MTY_EXPORT void
+MTY_LogAsyncStop(void);
+
+MTY_EXPORT uint64_t
+MTY_LogAsyncDropped(void);
+
+MTY_EXPORT bool
+MTY_LogSinkOpen(const char *path, MTY_LogFormat format, size_t maxSize, uint32_t maxFiles);
+
+MTY_EXPORT void
+MTY_LogSinkFlush(void);
+
+MTY_EXPORT void
+MTY_LogSinkClose(void);
+
+// Limits each call site to `rate` messages per second with bursts of up to `burst`,
+// a `rate` of 0 disables the limit and is the default
+MTY_EXPORT void
+MTY_LogSetRateLimit(uint32_t rate, uint32_t burst);
+
+MTY_EXPORT void
+MTY_LogSetLevel(const char *module, MTY_LogLevel level);
+
+MTY_EXPORT MTY_LogLevel
+MTY_LogGetLevel(const char *module);
+
+MTY_EXPORT void
+MTY_LogGetOrigin(int64_t *timestamp, int64_t *threadID);
+
+// Define MTY_LOG_MIN_LEVEL to a MTY_LogLevel value before including this header
+// to compile out every lower level call, MTY_Log is MTY_LOG_INFO
+
+#if !defined(MTY_LOG_MIN_LEVEL)
+	#define MTY_LOG_MIN_LEVEL 0
+#endif
+
+#if !defined(MTY_LOG_MODULE)
+	#define MTY_LOG_MODULE NULL
+#endif
+
+#if MTY_LOG_MIN_LEVEL <= 0
+	#define MTY_LogTrace(msg, ...) \
+		MTY_LogLevelParams(MTY_LOG_TRACE, MTY_LOG_MODULE, __FUNCTION__, msg, ##__VA_ARGS__)
+#else
+	#define MTY_LogTrace(msg, ...) ((void) 0)
+#endif
+
+#if MTY_LOG_MIN_LEVEL <= 1
+	#define MTY_LogDebug(msg, ...) \
+		MTY_LogLevelParams(MTY_LOG_DEBUG, MTY_LOG_MODULE, __FUNCTION__, msg, ##__VA_ARGS__)
+#else
+	#define MTY_LogDebug(msg, ...) ((void) 0)
+#endif
+
+#if MTY_LOG_MIN_LEVEL <= 2
+	#define MTY_LogInfo(msg, ...) \
+		MTY_LogLevelParams(MTY_LOG_INFO, MTY_LOG_MODULE, __FUNCTION__, msg, ##__VA_ARGS__)
+
+	#define MTY_Log(msg, ...) \
+		MTY_LogParams(__FUNCTION__, msg, ##__VA_ARGS__)
+#else
+	#define MTY_LogInfo(msg, ...) ((void) 0)
+	#define MTY_Log(msg, ...) ((void) 0)
+#endif
+
+#if MTY_LOG_MIN_LEVEL <= 3
+	#define MTY_LogWarn(msg, ...) \
+		MTY_LogLevelParams(MTY_LOG_WARN, MTY_LOG_MODULE, __FUNCTION__, msg, ##__VA_ARGS__)
+#else
+	#define MTY_LogWarn(msg, ...) ((void) 0)
+#endif
+
+#if MTY_LOG_MIN_LEVEL <= 4
+	#define MTY_LogError(msg, ...) \
+		MTY_LogLevelParams(MTY_LOG_ERROR, MTY_LOG_MODULE, __FUNCTION__, msg, ##__VA_ARGS__)
+#else
+	#define MTY_LogError(msg, ...) ((void) 0)
+#endif
+
+// Only the format pointer is recorded, so fmt must be a string literal or otherwise
+// outlive the async flusher
+
+#define MTY_LogBinary(level, fmt, ...) do { \
+	if ((int32_t) (level) >= MTY_LOG_MIN_LEVEL) \
+		MTY_LogBinaryParams(level, MTY_LOG_MODULE, __FUNCTION__, fmt, ##__VA_ARGS__); \
+} while (0)
+
+#define MTY_KVStr(k, v) \
+	((MTY_LogField) {(k), MTY_LOG_FIELD_STR, {.s = (v)}})
+
+#define MTY_KVInt(k, v) \
+	((MTY_LogField) {(k), MTY_LOG_FIELD_INT, {.i = (v)}})
+
+#define MTY_KVUInt(k, v) \
+	((MTY_LogField) {(k), MTY_LOG_FIELD_UINT, {.u = (v)}})
+
+#define MTY_KVFloat(k, v) \
+	((MTY_LogField) {(k), MTY_LOG_FIELD_FLOAT, {.f = (v)}})
+
+#define MTY_KVBool(k, v) \
+	((MTY_LogField) {(k), MTY_LOG_FIELD_BOOL, {.b = (v)}})
+
+// Fields are built with the MTY_KV* macros, e.g.
+// MTY_LogKV(MTY_LOG_INFO, "Frame sent", MTY_KVUInt("size", size), MTY_KVFloat("ms", ms))
+
+#define MTY_LogKV(level, msg, ...) do { \
+	if ((int32_t) (level) >= MTY_LOG_MIN_LEVEL) { \
+		const MTY_LogField _mty_kv[] = {{NULL}, ##__VA_ARGS__}; \
+		MTY_LogKVParams(level, MTY_LOG_MODULE, __FUNCTION__, msg, _mty_kv + 1, \
+			sizeof(_mty_kv) / sizeof(MTY_LogField) - 1); \
+	} \
+} while (0)
 
 #define MTY_Fatal(msg, ...) \
 	MTY_FatalParams(__FUNCTION__, msg, ##__VA_ARGS__)
@@ -417,15 +640,53 @@ MTY_GetLog(void);
 
 /// @module mem
 
+#define MTY_ALLOC_HISTOGRAM 16
+
+typedef enum {
+	MTY_PAGE_HUGE   = 0x1,
+	MTY_PAGE_LOCKED = 0x2,
+	MTY_PAGE_MAKE_32 = 0x7FFFFFFF,
+} MTY_PageFlag;
+
+// The old size passed to 'realloc' and the size passed to 'free' may be 0 when unknown,
+// MTY_ReallocSized and MTY_FreeSized always supply them
+
+typedef struct {
+	void *(*alloc)(size_t size, size_t align, void *opaque);
+	void *(*realloc)(void *mem, size_t oldSize, size_t size, void *opaque);
+	void (*free)(void *mem, size_t size, void *opaque);
+	void *opaque;
+} MTY_Allocator;
+
+typedef struct {
+	int64_t live;
+	int64_t peak;
+	int64_t allocs;
+	int64_t frees;
+	int64_t histogram[MTY_ALLOC_HISTOGRAM];
+} MTY_AllocStats;
+
+MTY_EXPORT void
+MTY_SetAllocator(const MTY_Allocator *allocator);
+
 MTY_EXPORT void *
 MTY_Alloc(size_t nelem, size_t elsize);
 
+MTY_EXPORT void *
+MTY_AllocUninit(size_t nelem, size_t elsize);
+
 MTY_EXPORT void *
 MTY_AllocAligned(size_t size, size_t align);
 
+MTY_EXPORT void *
+MTY_AllocAlignedUninit(size_t size, size_t align);
+
 MTY_EXPORT void *
 MTY_Realloc(void *mem, size_t nelem, size_t elsize);
 
+MTY_EXPORT void *
+MTY_ReallocSized(void *mem, size_t oldSize, size_t nelem, size_t elsize);
+
 MTY_EXPORT void *
 MTY_Dup(const void *mem, size_t size);
 
@@ -435,9 +696,39 @@ MTY_Strdup(const void *str);
 MTY_EXPORT void
 MTY_Free(void *mem);
 
+MTY_EXPORT void
+MTY_FreeSized(void *mem, size_t size);
+
 MTY_EXPORT void
 MTY_FreeAligned(void *mem);
 
+MTY_EXPORT void *
+MTY_AllocPages(size_t size, MTY_PageFlag flags);
+
+MTY_EXPORT void
+MTY_FreePages(void *mem, size_t size);
+
+MTY_EXPORT void
+MTY_AllocProfileEnable(bool enable);
+
+MTY_EXPORT const char *
+MTY_AllocProfileTag(const char *tag);
+
+MTY_EXPORT bool
+MTY_AllocProfileGetStats(const char *tag, MTY_AllocStats *stats);
+
+MTY_EXPORT char *
+MTY_AllocProfileReport(void);
+
+MTY_EXPORT void
+MTY_AllocDebugEnable(bool enable);
+
+MTY_EXPORT uint32_t
+MTY_AllocDebugCheck(void);
+
+MTY_EXPORT char *
+MTY_AllocDebugReport(void);
+
 MTY_EXPORT uint16_t
 MTY_Swap16(uint16_t value);
 
@@ -465,6 +756,35 @@ MTY_SwapFromBE32(uint32_t value);
 MTY_EXPORT uint64_t
 MTY_SwapFromBE64(uint64_t value);
 
+MTY_EXPORT void
+MTY_Swap16Array(const void *src, void *dst, size_t len);
+
+MTY_EXPORT void
+MTY_Swap32Array(const void *src, void *dst, size_t len);
+
+MTY_EXPORT void
+MTY_Swap64Array(const void *src, void *dst, size_t len);
+
+MTY_EXPORT void
+MTY_SwapToBE16Array(const void *src, void *dst, size_t len);
+
+MTY_EXPORT void
+MTY_SwapToBE32Array(const void *src, void *dst, size_t len);
+
+MTY_EXPORT void
+MTY_SwapToBE64Array(const void *src, void *dst, size_t len);
+
+MTY_EXPORT void
+MTY_SwapFromBE16Array(const void *src, void *dst, size_t len);
+
+MTY_EXPORT void
+MTY_SwapFromBE32Array(const void *src, void *dst, size_t len);
+
+MTY_EXPORT void
+MTY_SwapFromBE64Array(const void *src, void *dst, size_t len);
+
+// Invalid sequences, such as the unpaired surrogates Windows allows in names, are
+// replaced with U+FFFD. The MTY_UTF* converters below reject them instead
 MTY_EXPORT bool
 MTY_WideToMulti(const wchar_t *src, char *dst, size_t len);
 
@@ -477,6 +797,55 @@ MTY_MultiToWide(const char *src, wchar_t *dst, uint32_t len);
 MTY_EXPORT wchar_t *
 MTY_MultiToWideD(const char *src);
 
+MTY_EXPORT size_t
+MTY_UTF8ToUTF16(const char *src, uint16_t *dst, size_t len);
+
+MTY_EXPORT size_t
+MTY_UTF16ToUTF8(const uint16_t *src, char *dst, size_t len);
+
+MTY_EXPORT size_t
+MTY_UTF8ToUTF32(const char *src, uint32_t *dst, size_t len);
+
+MTY_EXPORT size_t
+MTY_UTF32ToUTF8(const uint32_t *src, char *dst, size_t len);
+
+typedef struct MTY_Arena MTY_Arena;
+
+MTY_EXPORT MTY_Arena *
+MTY_ArenaCreate(size_t chunkSize);
+
+MTY_EXPORT void *
+MTY_ArenaAlloc(MTY_Arena *ctx, size_t size);
+
+MTY_EXPORT void *
+MTY_ArenaAllocAligned(MTY_Arena *ctx, size_t size, size_t align);
+
+MTY_EXPORT size_t
+MTY_ArenaMark(MTY_Arena *ctx);
+
+MTY_EXPORT void
+MTY_ArenaRewind(MTY_Arena *ctx, size_t mark);
+
+MTY_EXPORT void
+MTY_ArenaReset(MTY_Arena *ctx);
+
+MTY_EXPORT void
+MTY_ArenaDestroy(MTY_Arena **arena);
+
+typedef struct MTY_Pool MTY_Pool;
+
+MTY_EXPORT MTY_Pool *
+MTY_PoolCreate(size_t size);
+
+MTY_EXPORT void *
+MTY_PoolAlloc(MTY_Pool *ctx);
+
+MTY_EXPORT void
+MTY_PoolFree(MTY_Pool *ctx, void *mem);
+
+MTY_EXPORT void
+MTY_PoolDestroy(MTY_Pool **pool);
+
 #define MTY_Align16(v) \
 	((v) + 0xF & ~((uintptr_t) 0xF))
 
@@ -593,6 +962,11 @@ typedef struct MTY_ListNode {
 typedef struct MTY_Hash MTY_Hash;
 typedef struct MTY_Queue MTY_Queue;
 typedef struct MTY_List MTY_List;
+typedef struct MTY_Buffer MTY_Buffer;
+typedef struct MTY_Vec MTY_Vec;
+typedef struct MTY_StrBuf MTY_StrBuf;
+
+typedef void (*MTY_BufferRecycleFunc)(MTY_Buffer *buffer, void *opaque);
 
 MTY_EXPORT MTY_Hash *
 MTY_HashCreate(uint32_t numBuckets);
@@ -651,12 +1025,102 @@ MTY_QueuePushPtr(MTY_Queue *ctx, const void *opaque, size_t size);
 MTY_EXPORT bool
 MTY_QueuePopPtr(MTY_Queue *ctx, int32_t timeout, void **opaque, size_t *size);
 
+MTY_EXPORT bool
+MTY_QueuePushBuffer(MTY_Queue *ctx, MTY_Buffer *buffer);
+
+MTY_EXPORT bool
+MTY_QueuePopBuffer(MTY_Queue *ctx, int32_t timeout, MTY_Buffer **buffer);
+
 MTY_EXPORT void
 MTY_QueueFlush(MTY_Queue *ctx, void (*freeFunc)(void *value));
 
 MTY_EXPORT void
 MTY_QueueDestroy(MTY_Queue **queue);
 
+MTY_EXPORT MTY_Buffer *
+MTY_BufferCreate(size_t size);
+
+MTY_EXPORT MTY_Buffer *
+MTY_BufferSlice(MTY_Buffer *ctx, size_t offset, size_t size);
+
+MTY_EXPORT MTY_Buffer *
+MTY_BufferRef(MTY_Buffer *ctx);
+
+MTY_EXPORT void *
+MTY_BufferGetData(MTY_Buffer *ctx);
+
+MTY_EXPORT size_t
+MTY_BufferGetSize(MTY_Buffer *ctx);
+
+MTY_EXPORT void
+MTY_BufferSetRecycle(MTY_Buffer *ctx, MTY_BufferRecycleFunc func, void *opaque);
+
+MTY_EXPORT void
+MTY_BufferRelease(MTY_Buffer **buffer);
+
+MTY_EXPORT void
+MTY_BufferDestroy(MTY_Buffer **buffer);
+
+MTY_EXPORT MTY_Vec *
+MTY_VecCreate(size_t elsize, size_t reserve);
+
+MTY_EXPORT void
+MTY_VecReserve(MTY_Vec *ctx, size_t len);
+
+MTY_EXPORT void *
+MTY_VecPush(MTY_Vec *ctx);
+
+MTY_EXPORT void
+MTY_VecAppend(MTY_Vec *ctx, const void *elements, size_t len);
+
+MTY_EXPORT void *
+MTY_VecGet(MTY_Vec *ctx, size_t index);
+
+MTY_EXPORT void *
+MTY_VecGetData(MTY_Vec *ctx);
+
+MTY_EXPORT size_t
+MTY_VecLength(MTY_Vec *ctx);
+
+MTY_EXPORT void
+MTY_VecClear(MTY_Vec *ctx);
+
+MTY_EXPORT void *
+MTY_VecDetach(MTY_Vec **vec, size_t *len);
+
+MTY_EXPORT void
+MTY_VecDestroy(MTY_Vec **vec);
+
+MTY_EXPORT MTY_StrBuf *
+MTY_StrBufCreate(size_t reserve);
+
+MTY_EXPORT void
+MTY_StrBufReserve(MTY_StrBuf *ctx, size_t len);
+
+MTY_EXPORT void
+MTY_StrBufAppend(MTY_StrBuf *ctx, const char *str);
+
+MTY_EXPORT void
+MTY_StrBufAppendLen(MTY_StrBuf *ctx, const char *str, size_t len);
+
+MTY_EXPORT void
+MTY_StrBufPrintf(MTY_StrBuf *ctx, const char *fmt, ...);
+
+MTY_EXPORT const char *
+MTY_StrBufGet(MTY_StrBuf *ctx);
+
+MTY_EXPORT size_t
+MTY_StrBufLength(MTY_StrBuf *ctx);
+
+MTY_EXPORT void
+MTY_StrBufClear(MTY_StrBuf *ctx);
+
+MTY_EXPORT char *
+MTY_StrBufDetach(MTY_StrBuf **sb);
+
+MTY_EXPORT void
+MTY_StrBufDestroy(MTY_StrBuf **sb);
+
 MTY_EXPORT MTY_List *
 MTY_ListCreate(void);
 
@@ -683,6 +1147,32 @@ typedef enum {
 	MTY_THREAD_STATE_MAKE_32  = 0x7FFFFFFF,
 } MTY_ThreadState;
 
+typedef enum {
+	MTY_THREAD_PRIORITY_NORMAL   = 0,
+	MTY_THREAD_PRIORITY_LOW      = 1,
+	MTY_THREAD_PRIORITY_HIGH     = 2,
+	MTY_THREAD_PRIORITY_REALTIME = 3,
+	MTY_THREAD_PRIORITY_MAKE_32  = 0x7FFFFFFF,
+} MTY_ThreadPriority;
+
+typedef struct {
+	const char *name;
+	uint64_t affinity;
+	size_t stackSize;
+	MTY_ThreadPriority priority;
+} MTY_ThreadDesc;
+
+typedef struct {
+	uint32_t packages;
+	uint32_t cores;
+	uint32_t threads;
+	uint32_t cacheLine;
+	uint32_t cacheL1;
+	uint32_t cacheL2;
+	uint32_t cacheL3;
+	uint64_t coreMask;
+} MTY_CPUTopology;
+
 typedef struct {
 	volatile int32_t value;
 } MTY_Atomic32;
@@ -697,10 +1187,14 @@ typedef struct MTY_Cond MTY_Cond;
 typedef struct MTY_RWLock MTY_RWLock;
 typedef struct MTY_Sync MTY_Sync;
 typedef struct MTY_ThreadPool MTY_ThreadPool;
+typedef struct MTY_TimerWheel MTY_TimerWheel;
 
 MTY_EXPORT MTY_Thread *
 MTY_ThreadCreate(void *(*func)(void *opaque), const void *opaque);
 
+MTY_EXPORT MTY_Thread *
+MTY_ThreadCreateEx(void *(*func)(void *opaque), const void *opaque, const MTY_ThreadDesc *desc);
+
 MTY_EXPORT void
 MTY_ThreadDetach(void *(*func)(void *opaque), const void *opaque);
 
@@ -713,6 +1207,9 @@ MTY_ThreadDestroy(MTY_Thread **thread);
 MTY_EXPORT MTY_Mutex *
 MTY_MutexCreate(void);
 
+MTY_EXPORT MTY_Mutex *
+MTY_MutexCreateNamed(const char *name);
+
 MTY_EXPORT void
 MTY_MutexLock(MTY_Mutex *ctx);
 
@@ -728,6 +1225,9 @@ MTY_MutexDestroy(MTY_Mutex **mutex);
 MTY_EXPORT MTY_Cond *
 MTY_CondCreate(void);
 
+MTY_EXPORT MTY_Cond *
+MTY_CondCreateNamed(const char *name);
+
 MTY_EXPORT bool
 MTY_CondWait(MTY_Cond *ctx, MTY_Mutex *mutex, int32_t timeout);
 
@@ -740,6 +1240,9 @@ MTY_CondWakeAll(MTY_Cond *ctx);
 MTY_EXPORT MTY_RWLock *
 MTY_RWLockCreate(void);
 
+MTY_EXPORT MTY_RWLock *
+MTY_RWLockCreateNamed(const char *name);
+
 MTY_EXPORT void
 MTY_RWLockReader(MTY_RWLock *ctx);
 
@@ -782,6 +1285,25 @@ MTY_ThreadPoolState(MTY_ThreadPool *ctx, uint32_t index, void **opaque);
 MTY_EXPORT void
 MTY_ThreadPoolDestroy(MTY_ThreadPool **pool, void (*detach)(void *opaque));
 
+MTY_EXPORT void
+MTY_GetCPUTopology(MTY_CPUTopology *topology);
+
+// Callbacks run on `workers` dedicated threads, or on the timer thread if it is 0. A
+// callback that was already handed to a worker can still run after it is cancelled
+
+MTY_EXPORT MTY_TimerWheel *
+MTY_TimerWheelCreate(uint32_t resolution, uint32_t workers);
+
+MTY_EXPORT uint32_t
+MTY_TimerWheelAdd(MTY_TimerWheel *ctx, uint32_t timeout, uint32_t interval,
+	void (*func)(void *opaque), const void *opaque);
+
+MTY_EXPORT bool
+MTY_TimerWheelCancel(MTY_TimerWheel *ctx, uint32_t id);
+
+MTY_EXPORT void
+MTY_TimerWheelDestroy(MTY_TimerWheel **wheel);
+
 MTY_EXPORT void
 MTY_Atomic32Set(MTY_Atomic32 *atomic, int32_t value);
 
@@ -806,6 +1328,18 @@ MTY_Atomic32CAS(MTY_Atomic32 *atomic, int32_t oldValue, int32_t newValue);
 MTY_EXPORT bool
 MTY_Atomic64CAS(MTY_Atomic64 *atomic, int64_t oldValue, int64_t newValue);
 
+MTY_EXPORT void
+MTY_LockProfileEnable(bool enable);
+
+MTY_EXPORT char *
+MTY_LockProfileReport(void);
+
+MTY_EXPORT void
+MTY_LockProfileReset(void);
+
+MTY_EXPORT void
+MTY_Once(MTY_Atomic32 *once, void (*func)(void *opaque), const void *opaque);
+
 MTY_EXPORT void
 MTY_GlobalLock(MTY_Atomic32 *lock);
 
@@ -815,21 +1349,160 @@ MTY_GlobalUnlock(MTY_Atomic32 *lock);
 
 /// @module time
 
+typedef struct MTY_FramePacer MTY_FramePacer;
+
+typedef struct {
+	uint64_t frames;
+	uint64_t missed;
+	float interval;
+	float jitter;
+	float maxJitter;
+} MTY_FramePacerStats;
+
 MTY_EXPORT int64_t
 MTY_Timestamp(void);
 
+// Same units as MTY_Timestamp, read from the CPU cycle counter where it runs at a
+// constant rate. The counter's rate is measured once, so it drifts from MTY_Timestamp
+// by up to tens of milliseconds per hour, only compare values from the same function.
+// The first call may block for about 20 ms while the counter is calibrated, call it
+// once during startup to keep that off a hot path
+MTY_EXPORT int64_t
+MTY_TimestampFast(void);
+
 MTY_EXPORT float
 MTY_TimeDiff(int64_t begin, int64_t end);
 
 MTY_EXPORT void
 MTY_Sleep(uint32_t timeout);
 
+MTY_EXPORT void
+MTY_SleepPrecise(uint32_t us);
+
 MTY_EXPORT void
 MTY_SetTimerResolution(uint32_t res);
 
 MTY_EXPORT void
 MTY_RevertTimerResolution(uint32_t res);
 
+MTY_EXPORT MTY_FramePacer *
+MTY_FramePacerCreate(float interval);
+
+MTY_EXPORT void
+MTY_FramePacerWait(MTY_FramePacer *ctx);
+
+MTY_EXPORT void
+MTY_FramePacerGetStats(MTY_FramePacer *ctx, MTY_FramePacerStats *stats);
+
+MTY_EXPORT void
+MTY_FramePacerReset(MTY_FramePacer *ctx);
+
+MTY_EXPORT void
+MTY_FramePacerDestroy(MTY_FramePacer **pacer);
+
+
+/// @module profile
+
+// Zone names are stored by pointer and must outlive the export, string literals are ideal
+
+MTY_EXPORT void
+MTY_ProfileEnable(bool enable);
+
+MTY_EXPORT void
+MTY_ProfileBegin(const char *name);
+
+MTY_EXPORT void
+MTY_ProfileEnd(void);
+
+MTY_EXPORT char *
+MTY_ProfileExport(void);
+
+MTY_EXPORT void
+MTY_ProfileReset(void);
+
+
+/// @module metrics
+
+// Histogram buckets are log-linear with a relative error under 1%, recording is lock free
+
+typedef struct MTY_Histogram MTY_Histogram;
+typedef struct MTY_Metric MTY_Metric;
+
+typedef enum {
+	MTY_METRIC_COUNTER   = 0,
+	MTY_METRIC_GAUGE     = 1,
+	MTY_METRIC_HISTOGRAM = 2,
+	MTY_METRIC_MAKE_32   = 0x7FFFFFFF,
+} MTY_MetricType;
+
+typedef struct {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	double mean;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t p999;
+} MTY_HistogramStats;
+
+typedef struct {
+	const char *name;
+	MTY_MetricType type;
+	int64_t value;
+	MTY_HistogramStats stats;
+} MTY_MetricValue;
+
+MTY_EXPORT MTY_Histogram *
+MTY_HistogramCreate(void);
+
+MTY_EXPORT void
+MTY_HistogramRecord(MTY_Histogram *ctx, uint64_t value);
+
+MTY_EXPORT uint64_t
+MTY_HistogramPercentile(MTY_Histogram *ctx, double percentile);
+
+MTY_EXPORT void
+MTY_HistogramGetStats(MTY_Histogram *ctx, MTY_HistogramStats *stats);
+
+MTY_EXPORT void
+MTY_HistogramReset(MTY_Histogram *ctx);
+
+MTY_EXPORT void
+MTY_HistogramDestroy(MTY_Histogram **histogram);
+
+// Named metrics are created on first use and live until the process exits, keep the
+// returned handles rather than looking them up on hot paths
+
+MTY_EXPORT MTY_Metric *
+MTY_MetricCounter(const char *name);
+
+MTY_EXPORT MTY_Metric *
+MTY_MetricGauge(const char *name);
+
+MTY_EXPORT MTY_Histogram *
+MTY_MetricHistogram(const char *name);
+
+MTY_EXPORT void
+MTY_MetricAdd(MTY_Metric *metric, int64_t value);
+
+MTY_EXPORT void
+MTY_MetricSet(MTY_Metric *metric, int64_t value);
+
+MTY_EXPORT int64_t
+MTY_MetricGet(MTY_Metric *metric);
+
+// Built in "mty." metrics for queues, pools, encryption, and compression, pools and
+// queues are only measured if created while enabled
+
+MTY_EXPORT void
+MTY_MetricsEnable(bool enable);
+
+// Returned array must be freed with MTY_Free, names are valid for the life of the process
+
+MTY_EXPORT MTY_MetricValue *
+MTY_MetricsSnapshot(uint32_t *count);
+
 
 // @module window
 
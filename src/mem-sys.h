@@ -0,0 +1,12 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "matoya.h"
+
+void *mem_sys_aligned_alloc(size_t size, size_t align);
+void mem_sys_aligned_free(void *mem);
@@ -4,75 +4,346 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
+#define _DEFAULT_SOURCE // MAP_ANON, MAP_HUGETLB, MADV_HUGEPAGE (mty-mmap.h)
+#define _DARWIN_C_SOURCE // MAP_ANON (mty-mmap.h)
+
 #include "matoya.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
-#include <wchar.h>
 
-void *MTY_Alloc(size_t nelem, size_t elsize)
+#include "mty-mmap.h"
+#include "mem-sys.h"
+#include "alloc-prof.h"
+#include "alloc-debug.h"
+
+#define PAGE_SIZE_SMALL (4 * 1024)
+#define PAGE_SIZE_HUGE  (2 * 1024 * 1024)
+
+static MTY_Allocator ALLOC;
+static bool ALLOC_CUSTOM;
+static bool ALLOC_PROFILE;
+static bool ALLOC_DEBUG;
+static MTY_Atomic32 ALLOC_LOCKED;
+
+
+// Backend
+
+static void *alloc_backend(size_t size, size_t align, bool zero)
 {
-	void *mem = calloc(nelem, elsize);
+	void *mem = NULL;
+
+	if (ALLOC_CUSTOM) {
+		mem = ALLOC.alloc(size, align, ALLOC.opaque);
+
+		if (mem && zero)
+			memset(mem, 0, size);
+
+	} else if (align > 0) {
+		mem = mem_sys_aligned_alloc(size, align);
+
+		if (mem && zero)
+			memset(mem, 0, size);
+
+	} else {
+		mem = zero ? calloc(1, size) : malloc(size);
+	}
 
 	if (!mem)
-		MTY_Fatal("'calloc' failed with errno %d", errno);
+		MTY_Fatal("Allocation of %zu bytes failed with errno %d", size, errno);
 
 	return mem;
 }
 
-void *MTY_Realloc(void *mem, size_t nelem, size_t elsize)
+static void *alloc_backend_realloc(void *mem, size_t old_size, size_t size)
 {
-	size_t size = elsize * nelem;
-
-	void *new_mem = realloc(mem, size);
+	void *new_mem = ALLOC_CUSTOM ? ALLOC.realloc(mem, old_size, size, ALLOC.opaque) : realloc(mem, size);
 
-	if (!new_mem && size > 0)
-		MTY_Fatal("'realloc' failed with errno %d", errno);
+	if (!new_mem)
+		MTY_Fatal("Reallocation to %zu bytes failed with errno %d", size, errno);
 
 	return new_mem;
 }
 
-void *MTY_Dup(const void *mem, size_t size)
+static void alloc_backend_free(void *mem, size_t size, bool aligned)
+{
+	if (ALLOC_CUSTOM) {
+		ALLOC.free(mem, size, ALLOC.opaque);
+
+	} else if (aligned) {
+		mem_sys_aligned_free(mem);
+
+	} else {
+		free(mem);
+	}
+}
+
+
+// Tracking wrappers
+
+static void alloc_lock(void)
+{
+	// The allocator and header layout are fixed once the first block is handed out
+	if (!MTY_Atomic32Get(&ALLOC_LOCKED))
+		MTY_Atomic32Set(&ALLOC_LOCKED, 1);
+}
+
+static struct alloc_header *alloc_header(void *mem)
+{
+	return (struct alloc_header *) ((uint8_t *) mem - ALLOC_HEADER);
+}
+
+static void *alloc_block(size_t size, size_t align, bool zero, const void *site)
+{
+	alloc_lock();
+
+	if (size == 0)
+		size = 1;
+
+	if (!ALLOC_PROFILE && !ALLOC_DEBUG)
+		return alloc_backend(size, align, zero);
+
+	// The header must end on a boundary that keeps the block aligned
+	size_t boundary = align > 16 ? align : 16;
+	size_t offset = (ALLOC_HEADER + boundary - 1) & ~(boundary - 1);
+	size_t guard = ALLOC_DEBUG ? ALLOC_GUARD : 0;
+
+	uint8_t *mem = (uint8_t *) alloc_backend(offset + size + guard, align, zero) + offset;
+
+	struct alloc_header *hdr = alloc_header(mem);
+	hdr->size = size;
+	hdr->offset = (uint32_t) offset;
+	hdr->tag = alloc_prof_tag();
+	hdr->aligned = align > 0;
+	hdr->site = site;
+
+	if (ALLOC_PROFILE)
+		alloc_prof_add(hdr->tag, size);
+
+	if (ALLOC_DEBUG) {
+		if (!zero)
+			memset(mem, 0xCD, size);
+
+		alloc_debug_track(hdr);
+	}
+
+	return mem;
+}
+
+static void free_block(void *mem, size_t size, bool aligned, const void *site)
+{
+	if (!mem)
+		return;
+
+	if (!ALLOC_PROFILE && !ALLOC_DEBUG) {
+		alloc_backend_free(mem, size, aligned);
+		return;
+	}
+
+	struct alloc_header *hdr = alloc_header(mem);
+
+	if (ALLOC_DEBUG && !alloc_debug_check(hdr, aligned, site))
+		return;
+
+	if (ALLOC_PROFILE)
+		alloc_prof_remove(hdr->tag, hdr->size);
+
+	if (ALLOC_DEBUG) {
+		hdr = alloc_debug_quarantine(hdr);
+
+		if (!hdr)
+			return;
+	}
+
+	size_t guard = ALLOC_DEBUG ? ALLOC_GUARD : 0;
+	alloc_backend_free((uint8_t *) hdr + ALLOC_HEADER - hdr->offset, hdr->offset + hdr->size + guard, hdr->aligned);
+}
+
+static void *realloc_block(void *mem, size_t old_size, size_t size, const void *site)
 {
-	void *dup = MTY_Alloc(size, 1);
+	if (!mem)
+		return alloc_block(size, 0, false, site);
+
+	if (size == 0) {
+		free_block(mem, old_size, false, site);
+		return NULL;
+	}
+
+	if (!ALLOC_PROFILE && !ALLOC_DEBUG)
+		return alloc_backend_realloc(mem, old_size, size);
+
+	struct alloc_header *hdr = alloc_header(mem);
+	size_t guard = ALLOC_DEBUG ? ALLOC_GUARD : 0;
+
+	if (ALLOC_DEBUG) {
+		if (!alloc_debug_check(hdr, false, site))
+			MTY_Fatal("Reallocation of %p which is not a live allocation", mem);
+
+		alloc_debug_untrack(hdr);
+	}
+
+	uint16_t tag = hdr->tag;
+
+	if (ALLOC_PROFILE)
+		alloc_prof_remove(tag, hdr->size);
+
+	hdr = alloc_backend_realloc(hdr, ALLOC_HEADER + hdr->size + guard, ALLOC_HEADER + size + guard);
+	hdr->size = size;
+
+	if (ALLOC_PROFILE)
+		alloc_prof_add(tag, size);
+
+	if (ALLOC_DEBUG)
+		alloc_debug_track(hdr);
+
+	return (uint8_t *) hdr + ALLOC_HEADER;
+}
+
+static size_t alloc_size(size_t nelem, size_t elsize)
+{
+	if (elsize > 0 && nelem > SIZE_MAX / elsize)
+		MTY_Fatal("Allocation of %zu elements of size %zu overflows", nelem, elsize);
+
+	return nelem * elsize;
+}
+
+
+// Public
+
+void MTY_SetAllocator(const MTY_Allocator *allocator)
+{
+	if (MTY_Atomic32Get(&ALLOC_LOCKED)) {
+		MTY_Log("The allocator must be set before any allocation is made");
+		return;
+	}
+
+	if (allocator && (!allocator->alloc || !allocator->realloc || !allocator->free)) {
+		MTY_Log("The allocator must provide 'alloc', 'realloc', and 'free'");
+		return;
+	}
+
+	ALLOC_CUSTOM = allocator != NULL;
+	memset(&ALLOC, 0, sizeof(MTY_Allocator));
+
+	if (allocator)
+		ALLOC = *allocator;
+}
+
+void MTY_AllocProfileEnable(bool enable)
+{
+	if (MTY_Atomic32Get(&ALLOC_LOCKED)) {
+		MTY_Log("Allocation profiling must be enabled before any allocation is made");
+		return;
+	}
+
+	ALLOC_PROFILE = enable;
+}
+
+void MTY_AllocDebugEnable(bool enable)
+{
+	if (MTY_Atomic32Get(&ALLOC_LOCKED)) {
+		MTY_Log("Allocation debugging must be enabled before any allocation is made");
+		return;
+	}
+
+	if (enable && !ALLOC_DEBUG)
+		alloc_debug_init();
+
+	ALLOC_DEBUG = enable;
+}
+
+void *MTY_Alloc(size_t nelem, size_t elsize)
+{
+	return alloc_block(alloc_size(nelem, elsize), 0, true, ALLOC_SITE());
+}
+
+void *MTY_AllocUninit(size_t nelem, size_t elsize)
+{
+	return alloc_block(alloc_size(nelem, elsize), 0, false, ALLOC_SITE());
+}
+
+void *MTY_AllocAligned(size_t size, size_t align)
+{
+	return alloc_block(size, align, true, ALLOC_SITE());
+}
+
+void *MTY_AllocAlignedUninit(size_t size, size_t align)
+{
+	return alloc_block(size, align, false, ALLOC_SITE());
+}
+
+void *MTY_Realloc(void *mem, size_t nelem, size_t elsize)
+{
+	return realloc_block(mem, 0, alloc_size(nelem, elsize), ALLOC_SITE());
+}
+
+void *MTY_ReallocSized(void *mem, size_t oldSize, size_t nelem, size_t elsize)
+{
+	return realloc_block(mem, oldSize, alloc_size(nelem, elsize), ALLOC_SITE());
+}
+
+static void *alloc_dup(const void *mem, size_t size, const void *site)
+{
+	void *dup = alloc_block(size, 0, false, site);
 	memcpy(dup, mem, size);
 
 	return dup;
 }
 
+void *MTY_Dup(const void *mem, size_t size)
+{
+	return alloc_dup(mem, size, ALLOC_SITE());
+}
+
 void *MTY_Strdup(const void *str)
 {
-	return MTY_Dup(str, strlen(str) + 1);
+	return alloc_dup(str, strlen(str) + 1, ALLOC_SITE());
 }
 
 void MTY_Free(void *mem)
 {
-	free(mem);
+	free_block(mem, 0, false, ALLOC_SITE());
 }
 
-char *MTY_WideToMultiD(const wchar_t *src)
+void MTY_FreeSized(void *mem, size_t size)
 {
-	if (!src)
-		return NULL;
+	free_block(mem, size, false, ALLOC_SITE());
+}
+
+void MTY_FreeAligned(void *mem)
+{
+	free_block(mem, 0, true, ALLOC_SITE());
+}
 
-	size_t len = wcslen(src) + 1;
-	char *dst = MTY_Alloc(len, sizeof(wchar_t));
 
-	MTY_WideToMulti(src, dst, len);
+// Pages
+
+static size_t page_size(size_t size)
+{
+	// Rounding depends only on the size so MTY_FreePages can recompute it
+	size_t align = size >= PAGE_SIZE_HUGE ? PAGE_SIZE_HUGE : PAGE_SIZE_SMALL;
 
-	return dst;
+	return (size + align - 1) & ~(align - 1);
 }
 
-wchar_t *MTY_MultiToWideD(const char *src)
+void *MTY_AllocPages(size_t size, MTY_PageFlag flags)
 {
-	if (!src)
-		return NULL;
+	size = page_size(size);
+
+	void *mem = (flags & MTY_PAGE_HUGE) && size >= PAGE_SIZE_HUGE ?
+		mty_mmap_huge(size) : mty_mmap(size);
 
-	uint32_t len = (uint32_t) strlen(src) + 1;
-	wchar_t *dst = MTY_Alloc(len, sizeof(wchar_t));
+	if (flags & MTY_PAGE_LOCKED)
+		mty_mlock(mem, size);
 
-	MTY_MultiToWide(src, dst, len);
+	return mem;
+}
+
+void MTY_FreePages(void *mem, size_t size)
+{
+	if (!mem)
+		return;
 
-	return dst;
+	mty_munmap(mem, page_size(size));
 }
@@ -0,0 +1,405 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "metrics.h"
+
+#include <string.h>
+
+#define HISTOGRAM_BITS    7
+#define HISTOGRAM_SUB     (1 << HISTOGRAM_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_BITS + 1) * HISTOGRAM_SUB)
+
+#define METRICS_MAX 256
+
+struct MTY_Histogram {
+	MTY_Atomic64 count;
+	MTY_Atomic64 sum;
+	MTY_Atomic64 min;
+	MTY_Atomic64 max;
+	MTY_Atomic64 buckets[HISTOGRAM_BUCKETS];
+};
+
+struct MTY_Metric {
+	char *name;
+	MTY_MetricType type;
+	MTY_Atomic64 value;
+	MTY_Histogram *histogram;
+};
+
+struct metrics_sampler {
+	MTY_Metric *metric;
+	int64_t (*sample)(const void *opaque);
+	const void *opaque;
+};
+
+static MTY_Metric *METRICS[METRICS_MAX];
+static uint32_t METRICS_NUM;
+static struct metrics_sampler *METRICS_SAMPLERS;
+static uint32_t METRICS_NUM_SAMPLERS;
+static uint32_t METRICS_SAMPLERS_CAP;
+static MTY_Atomic32 METRICS_LOCK;
+static MTY_Atomic32 METRICS_ENABLED;
+
+static MTY_Atomic32 METRICS_BUILTIN_ONCE;
+static struct metrics_builtin {
+	MTY_Metric *encrypted;
+	MTY_Metric *compress_input;
+	MTY_Metric *compress_output;
+	MTY_Histogram *compress_ratio;
+} METRICS_BUILTIN;
+
+
+// Histogram, values below 2 * HISTOGRAM_SUB get exact buckets, above that each power
+// of two is split into HISTOGRAM_SUB linear buckets
+
+static uint32_t histogram_msb(uint64_t value)
+{
+	uint32_t r = 0;
+
+	for (uint32_t shift = 32; shift > 0; shift >>= 1) {
+		if (value >> shift) {
+			value >>= shift;
+			r += shift;
+		}
+	}
+
+	return r;
+}
+
+static uint32_t histogram_index(uint64_t value)
+{
+	if (value < HISTOGRAM_SUB * 2)
+		return (uint32_t) value;
+
+	uint32_t shift = histogram_msb(value) - HISTOGRAM_BITS;
+
+	return shift * HISTOGRAM_SUB + (uint32_t) (value >> shift);
+}
+
+static uint64_t histogram_upper(uint32_t index)
+{
+	if (index < HISTOGRAM_SUB * 2)
+		return index;
+
+	uint32_t shift = index / HISTOGRAM_SUB - 1;
+	uint64_t sub = index - shift * HISTOGRAM_SUB;
+
+	return (sub << shift) + (((uint64_t) 1 << shift) - 1);
+}
+
+static void histogram_percentiles(MTY_Histogram *ctx, const double *percentiles, uint64_t *values, uint32_t n)
+{
+	uint64_t total = 0;
+
+	for (uint32_t x = 0; x < HISTOGRAM_BUCKETS; x++)
+		total += (uint64_t) MTY_Atomic64Get(&ctx->buckets[x]);
+
+	memset(values, 0, n * sizeof(uint64_t));
+
+	if (total == 0)
+		return;
+
+	uint64_t min = (uint64_t) MTY_Atomic64Get(&ctx->min);
+	uint64_t max = (uint64_t) MTY_Atomic64Get(&ctx->max);
+
+	uint64_t cum = 0;
+	uint32_t y = 0;
+
+	for (uint32_t x = 0; x < HISTOGRAM_BUCKETS && y < n; x++) {
+		cum += (uint64_t) MTY_Atomic64Get(&ctx->buckets[x]);
+
+		for (; y < n; y++) {
+			double rank = percentiles[y] / 100.0 * (double) total;
+
+			if ((double) cum < rank || cum == 0)
+				break;
+
+			uint64_t upper = histogram_upper(x);
+			values[y] = upper > max ? max : upper < min ? min : upper;
+		}
+	}
+
+	// Concurrent records can leave the second pass short of the first
+	for (; y < n; y++)
+		values[y] = max;
+}
+
+static void histogram_min(MTY_Histogram *ctx, uint64_t value)
+{
+	for (int64_t cur = MTY_Atomic64Get(&ctx->min); value < (uint64_t) cur; cur = MTY_Atomic64Get(&ctx->min))
+		if (MTY_Atomic64CAS(&ctx->min, cur, (int64_t) value))
+			break;
+}
+
+static void histogram_max(MTY_Histogram *ctx, uint64_t value)
+{
+	for (int64_t cur = MTY_Atomic64Get(&ctx->max); value > (uint64_t) cur; cur = MTY_Atomic64Get(&ctx->max))
+		if (MTY_Atomic64CAS(&ctx->max, cur, (int64_t) value))
+			break;
+}
+
+MTY_Histogram *MTY_HistogramCreate(void)
+{
+	MTY_Histogram *ctx = MTY_Alloc(1, sizeof(MTY_Histogram));
+
+	MTY_Atomic64Set(&ctx->min, -1);
+
+	return ctx;
+}
+
+void MTY_HistogramRecord(MTY_Histogram *ctx, uint64_t value)
+{
+	MTY_Atomic64Add(&ctx->buckets[histogram_index(value)], 1);
+	MTY_Atomic64Add(&ctx->sum, (int64_t) value);
+	MTY_Atomic64Add(&ctx->count, 1);
+
+	histogram_min(ctx, value);
+	histogram_max(ctx, value);
+}
+
+uint64_t MTY_HistogramPercentile(MTY_Histogram *ctx, double percentile)
+{
+	uint64_t value = 0;
+	histogram_percentiles(ctx, &percentile, &value, 1);
+
+	return value;
+}
+
+void MTY_HistogramGetStats(MTY_Histogram *ctx, MTY_HistogramStats *stats)
+{
+	memset(stats, 0, sizeof(MTY_HistogramStats));
+
+	stats->count = (uint64_t) MTY_Atomic64Get(&ctx->count);
+
+	if (stats->count == 0)
+		return;
+
+	stats->min = (uint64_t) MTY_Atomic64Get(&ctx->min);
+	stats->max = (uint64_t) MTY_Atomic64Get(&ctx->max);
+	stats->mean = (double) (uint64_t) MTY_Atomic64Get(&ctx->sum) / (double) stats->count;
+
+	double percentiles[4] = {50.0, 90.0, 99.0, 99.9};
+	uint64_t values[4] = {0};
+	histogram_percentiles(ctx, percentiles, values, 4);
+
+	stats->p50 = values[0];
+	stats->p90 = values[1];
+	stats->p99 = values[2];
+	stats->p999 = values[3];
+}
+
+void MTY_HistogramReset(MTY_Histogram *ctx)
+{
+	// Records racing with a reset may land on either side of it
+	for (uint32_t x = 0; x < HISTOGRAM_BUCKETS; x++)
+		MTY_Atomic64Set(&ctx->buckets[x], 0);
+
+	MTY_Atomic64Set(&ctx->count, 0);
+	MTY_Atomic64Set(&ctx->sum, 0);
+	MTY_Atomic64Set(&ctx->min, -1);
+	MTY_Atomic64Set(&ctx->max, 0);
+}
+
+void MTY_HistogramDestroy(MTY_Histogram **histogram)
+{
+	if (!histogram || !*histogram)
+		return;
+
+	MTY_Histogram *ctx = *histogram;
+
+	MTY_Free(ctx);
+	*histogram = NULL;
+}
+
+
+// Registry, lookups are locked but metric handles are never freed so updates are not
+
+static MTY_Metric *metrics_get(const char *name, MTY_MetricType type)
+{
+	for (uint32_t x = 0; x < METRICS_NUM; x++) {
+		MTY_Metric *metric = METRICS[x];
+
+		if (!strcmp(metric->name, name)) {
+			if (metric->type != type)
+				MTY_Fatal("Metric '%s' already exists with a different type", name);
+
+			return metric;
+		}
+	}
+
+	if (METRICS_NUM == METRICS_MAX)
+		MTY_Fatal("Could not register metric '%s', maximum is %u", name, METRICS_MAX);
+
+	MTY_Metric *metric = MTY_Alloc(1, sizeof(MTY_Metric));
+	metric->name = MTY_Strdup(name);
+	metric->type = type;
+
+	if (type == MTY_METRIC_HISTOGRAM)
+		metric->histogram = MTY_HistogramCreate();
+
+	METRICS[METRICS_NUM++] = metric;
+
+	return metric;
+}
+
+static MTY_Metric *metrics_lookup(const char *name, MTY_MetricType type)
+{
+	MTY_GlobalLock(&METRICS_LOCK);
+
+	MTY_Metric *metric = metrics_get(name, type);
+
+	MTY_GlobalUnlock(&METRICS_LOCK);
+
+	return metric;
+}
+
+MTY_Metric *MTY_MetricCounter(const char *name)
+{
+	return metrics_lookup(name, MTY_METRIC_COUNTER);
+}
+
+MTY_Metric *MTY_MetricGauge(const char *name)
+{
+	return metrics_lookup(name, MTY_METRIC_GAUGE);
+}
+
+MTY_Histogram *MTY_MetricHistogram(const char *name)
+{
+	return metrics_lookup(name, MTY_METRIC_HISTOGRAM)->histogram;
+}
+
+void MTY_MetricAdd(MTY_Metric *metric, int64_t value)
+{
+	MTY_Atomic64Add(&metric->value, value);
+}
+
+void MTY_MetricSet(MTY_Metric *metric, int64_t value)
+{
+	MTY_Atomic64Set(&metric->value, value);
+}
+
+int64_t MTY_MetricGet(MTY_Metric *metric)
+{
+	return MTY_Atomic64Get(&metric->value);
+}
+
+MTY_MetricValue *MTY_MetricsSnapshot(uint32_t *count)
+{
+	MTY_GlobalLock(&METRICS_LOCK);
+
+	MTY_MetricValue *values = MTY_Alloc(METRICS_NUM > 0 ? METRICS_NUM : 1, sizeof(MTY_MetricValue));
+
+	for (uint32_t x = 0; x < METRICS_NUM; x++) {
+		MTY_Metric *metric = METRICS[x];
+		MTY_MetricValue *v = &values[x];
+
+		v->name = metric->name;
+		v->type = metric->type;
+		v->value = MTY_Atomic64Get(&metric->value);
+
+		if (metric->histogram)
+			MTY_HistogramGetStats(metric->histogram, &v->stats);
+
+		// Sampled gauges are summed across every live object feeding them
+		for (uint32_t y = 0; y < METRICS_NUM_SAMPLERS; y++)
+			if (METRICS_SAMPLERS[y].metric == metric)
+				v->value += METRICS_SAMPLERS[y].sample(METRICS_SAMPLERS[y].opaque);
+	}
+
+	*count = METRICS_NUM;
+
+	MTY_GlobalUnlock(&METRICS_LOCK);
+
+	return values;
+}
+
+
+// Built in
+
+static void metrics_builtin_init(void *opaque)
+{
+	METRICS_BUILTIN.encrypted = MTY_MetricCounter("mty.aesgcm.encrypted");
+	METRICS_BUILTIN.compress_input = MTY_MetricCounter("mty.compress.input");
+	METRICS_BUILTIN.compress_output = MTY_MetricCounter("mty.compress.output");
+
+	// Input size over output size in hundredths
+	METRICS_BUILTIN.compress_ratio = MTY_MetricHistogram("mty.compress.ratio");
+}
+
+static struct metrics_builtin *metrics_builtin(void)
+{
+	MTY_Once(&METRICS_BUILTIN_ONCE, metrics_builtin_init, NULL);
+
+	return &METRICS_BUILTIN;
+}
+
+void MTY_MetricsEnable(bool enable)
+{
+	if (enable)
+		metrics_builtin();
+
+	MTY_Atomic32Set(&METRICS_ENABLED, enable ? 1 : 0);
+}
+
+bool metrics_enabled(void)
+{
+	return MTY_Atomic32Get(&METRICS_ENABLED) != 0;
+}
+
+void metrics_track(const char *name, int64_t (*sample)(const void *opaque), const void *opaque)
+{
+	MTY_GlobalLock(&METRICS_LOCK);
+
+	if (METRICS_NUM_SAMPLERS == METRICS_SAMPLERS_CAP) {
+		METRICS_SAMPLERS_CAP = METRICS_SAMPLERS_CAP > 0 ? METRICS_SAMPLERS_CAP * 2 : 16;
+		METRICS_SAMPLERS = MTY_Realloc(METRICS_SAMPLERS, METRICS_SAMPLERS_CAP, sizeof(struct metrics_sampler));
+	}
+
+	struct metrics_sampler *s = &METRICS_SAMPLERS[METRICS_NUM_SAMPLERS++];
+	s->metric = metrics_get(name, MTY_METRIC_GAUGE);
+	s->sample = sample;
+	s->opaque = opaque;
+
+	MTY_GlobalUnlock(&METRICS_LOCK);
+}
+
+void metrics_untrack(const void *opaque)
+{
+	MTY_GlobalLock(&METRICS_LOCK);
+
+	for (uint32_t x = 0; x < METRICS_NUM_SAMPLERS;) {
+		if (METRICS_SAMPLERS[x].opaque == opaque) {
+			METRICS_SAMPLERS[x] = METRICS_SAMPLERS[--METRICS_NUM_SAMPLERS];
+
+		} else {
+			x++;
+		}
+	}
+
+	MTY_GlobalUnlock(&METRICS_LOCK);
+}
+
+void metrics_encrypted(size_t size)
+{
+	if (!metrics_enabled())
+		return;
+
+	MTY_MetricAdd(metrics_builtin()->encrypted, (int64_t) size);
+}
+
+void metrics_compressed(size_t input, size_t output)
+{
+	if (!metrics_enabled())
+		return;
+
+	struct metrics_builtin *b = metrics_builtin();
+
+	MTY_MetricAdd(b->compress_input, (int64_t) input);
+	MTY_MetricAdd(b->compress_output, (int64_t) output);
+
+	if (output > 0)
+		MTY_HistogramRecord(b->compress_ratio, (uint64_t) input * 100 / output);
+}
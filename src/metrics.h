@@ -0,0 +1,15 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "matoya.h"
+
+bool metrics_enabled(void);
+void metrics_track(const char *name, int64_t (*sample)(const void *opaque), const void *opaque);
+void metrics_untrack(const void *opaque);
+void metrics_encrypted(size_t size);
+void metrics_compressed(size_t input, size_t output);
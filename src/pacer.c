@@ -0,0 +1,153 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "matoya.h"
+
+#include <string.h>
+#include <math.h>
+
+#include "mty-tls.h"
+#include "time-sleep.h"
+
+#define TIME_SLACK_MARGIN 0.05f
+#define TIME_SLACK_MAX    2.0f
+
+struct MTY_FramePacer {
+	float interval;
+	double ticks;
+	int64_t start;
+	int64_t last;
+	double offset;
+
+	uint64_t frames;
+	uint64_t missed;
+	double sum;
+	double sum_sq;
+	float max_jitter;
+};
+
+static MTY_TLS float TIME_SLACK = 0.5f;
+
+
+// Precise sleep
+
+void MTY_SleepPrecise(uint32_t us)
+{
+	int64_t start = MTY_Timestamp();
+	float target = us / 1000.0f;
+
+	// The scheduler overshoots by a fairly stable amount per thread, so sleep short
+	// of the target by that much and spin the remainder
+	float coarse = target - TIME_SLACK;
+
+	if (coarse > 0.0f) {
+		time_sleep_us((uint64_t) (coarse * 1000.0f));
+
+		float over = MTY_TimeDiff(start, MTY_Timestamp()) - coarse;
+		TIME_SLACK += (over + TIME_SLACK_MARGIN - TIME_SLACK) / 8.0f;
+
+		if (TIME_SLACK < TIME_SLACK_MARGIN)
+			TIME_SLACK = TIME_SLACK_MARGIN;
+
+		if (TIME_SLACK > TIME_SLACK_MAX)
+			TIME_SLACK = TIME_SLACK_MAX;
+	}
+
+	while (MTY_TimeDiff(start, MTY_Timestamp()) < target);
+}
+
+
+// Frame pacer
+
+static void pacer_reset(MTY_FramePacer *ctx)
+{
+	ctx->start = MTY_Timestamp();
+	ctx->last = ctx->start;
+	ctx->offset = ctx->ticks;
+
+	ctx->frames = 0;
+	ctx->missed = 0;
+	ctx->sum = 0;
+	ctx->sum_sq = 0;
+	ctx->max_jitter = 0;
+}
+
+MTY_FramePacer *MTY_FramePacerCreate(float interval)
+{
+	MTY_FramePacer *ctx = MTY_Alloc(1, sizeof(MTY_FramePacer));
+
+	// Deadlines are kept as a double offset in timestamp ticks from a fixed start, so
+	// sleep error never accumulates and there is no float precision loss over long runs
+	ctx->interval = interval;
+	ctx->ticks = interval * (1000.0 / MTY_TimeDiff(0, 1000));
+
+	pacer_reset(ctx);
+
+	return ctx;
+}
+
+void MTY_FramePacerWait(MTY_FramePacer *ctx)
+{
+	int64_t deadline = ctx->start + (int64_t) ctx->offset;
+	float remaining = MTY_TimeDiff(MTY_Timestamp(), deadline);
+
+	if (remaining > 0.0f) {
+		MTY_SleepPrecise((uint32_t) (remaining * 1000.0f));
+
+	} else {
+		ctx->missed++;
+
+		// Once more than a whole interval behind, skip the lost deadlines rather than
+		// running a burst of frames back to back to catch up
+		if (-remaining >= ctx->interval)
+			ctx->offset += floor(-remaining / ctx->interval) * ctx->ticks;
+	}
+
+	ctx->offset += ctx->ticks;
+
+	int64_t now = MTY_Timestamp();
+	float elapsed = MTY_TimeDiff(ctx->last, now);
+	float jitter = fabsf(elapsed - ctx->interval);
+	ctx->last = now;
+
+	ctx->frames++;
+	ctx->sum += elapsed;
+	ctx->sum_sq += (double) elapsed * elapsed;
+
+	if (jitter > ctx->max_jitter)
+		ctx->max_jitter = jitter;
+}
+
+void MTY_FramePacerGetStats(MTY_FramePacer *ctx, MTY_FramePacerStats *stats)
+{
+	memset(stats, 0, sizeof(MTY_FramePacerStats));
+
+	stats->frames = ctx->frames;
+	stats->missed = ctx->missed;
+	stats->maxJitter = ctx->max_jitter;
+
+	if (ctx->frames > 0) {
+		double mean = ctx->sum / ctx->frames;
+		double var = ctx->sum_sq / ctx->frames - mean * mean;
+
+		stats->interval = (float) mean;
+		stats->jitter = var > 0.0 ? (float) sqrt(var) : 0.0f;
+	}
+}
+
+void MTY_FramePacerReset(MTY_FramePacer *ctx)
+{
+	pacer_reset(ctx);
+}
+
+void MTY_FramePacerDestroy(MTY_FramePacer **pacer)
+{
+	if (!pacer || !*pacer)
+		return;
+
+	MTY_Free(*pacer);
+	*pacer = NULL;
+}
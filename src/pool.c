@@ -0,0 +1,340 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "matoya.h"
+
+#include <string.h>
+
+#include "mty-tls.h"
+#include "metrics.h"
+#include "thread-exit.h"
+
+#define POOL_SLAB_SIZE  (64 * 1024)
+#define POOL_SLAB_MIN   16
+#define POOL_BATCH      32
+#define POOL_MAGAZINE   64
+
+struct pool_obj {
+	struct pool_obj *next;
+};
+
+struct pool_slab {
+	struct pool_slab *next;
+	size_t size;
+};
+
+struct MTY_Pool {
+	size_t size;
+	size_t slab_size;
+	uint32_t index;
+	int32_t gen;
+
+	MTY_Mutex *mutex;
+	struct pool_slab *slabs;
+	uint8_t *cursor;
+	uint8_t *end;
+
+	MTY_Atomic64 remote;
+
+	bool metrics;
+	MTY_Atomic64 used;
+	MTY_Atomic64 reserved;
+};
+
+struct pool_cache {
+	int32_t gen;
+	uint32_t count;
+	struct pool_obj *freed;
+	struct pool_obj *tail;
+	struct pool_obj *avail;
+};
+
+static MTY_TLS struct pool_cache *POOL_CACHE;
+static MTY_TLS uint32_t POOL_CACHE_LEN;
+
+static MTY_Pool **POOLS;
+static uint32_t POOLS_LEN;
+static MTY_Atomic32 POOLS_LOCK;
+static MTY_Atomic32 POOL_GEN;
+
+#define POOL_HEADER \
+	((sizeof(struct pool_slab) + 15) & ~((size_t) 15))
+
+
+// Shared free list, pushed from any thread and only ever drained whole
+
+static void pool_remote_push(MTY_Pool *ctx, struct pool_obj *head, struct pool_obj *tail)
+{
+	while (true) {
+		int64_t old = MTY_Atomic64Get(&ctx->remote);
+		tail->next = (struct pool_obj *) (uintptr_t) old;
+
+		if (MTY_Atomic64CAS(&ctx->remote, old, (int64_t) (uintptr_t) head))
+			break;
+	}
+}
+
+static struct pool_obj *pool_remote_take(MTY_Pool *ctx)
+{
+	while (true) {
+		int64_t old = MTY_Atomic64Get(&ctx->remote);
+
+		if (old == 0 || MTY_Atomic64CAS(&ctx->remote, old, 0))
+			return (struct pool_obj *) (uintptr_t) old;
+	}
+}
+
+
+// Slabs
+
+static struct pool_obj *pool_carve(MTY_Pool *ctx)
+{
+	struct pool_obj *head = NULL;
+
+	MTY_MutexLock(ctx->mutex);
+
+	for (uint32_t x = 0; x < POOL_BATCH; x++) {
+		if (ctx->cursor + ctx->size > ctx->end) {
+			if (head)
+				break;
+
+			struct pool_slab *slab = MTY_AllocPages(ctx->slab_size, 0);
+			slab->size = ctx->slab_size;
+			MTY_Atomic64Add(&ctx->reserved, (int64_t) slab->size);
+			slab->next = ctx->slabs;
+			ctx->slabs = slab;
+
+			ctx->cursor = (uint8_t *) slab + POOL_HEADER;
+			ctx->end = (uint8_t *) slab + slab->size;
+		}
+
+		struct pool_obj *obj = (struct pool_obj *) ctx->cursor;
+		obj->next = head;
+		head = obj;
+
+		ctx->cursor += ctx->size;
+	}
+
+	MTY_MutexUnlock(ctx->mutex);
+
+	return head;
+}
+
+
+// Thread caches, a table per thread indexed by pool that grows as pools are created
+
+static void pool_cache_return(MTY_Pool *ctx, struct pool_cache *cache)
+{
+	if (cache->freed)
+		pool_remote_push(ctx, cache->freed, cache->tail);
+
+	if (cache->avail) {
+		struct pool_obj *tail = cache->avail;
+
+		while (tail->next)
+			tail = tail->next;
+
+		pool_remote_push(ctx, cache->avail, tail);
+	}
+}
+
+static void pool_cache_exit(void *opaque)
+{
+	// Cached objects go back to pools that are still alive so they aren't stranded
+	MTY_GlobalLock(&POOLS_LOCK);
+
+	for (uint32_t x = 0; x < POOL_CACHE_LEN && x < POOLS_LEN; x++) {
+		MTY_Pool *ctx = POOLS[x];
+
+		if (ctx && ctx->gen == POOL_CACHE[x].gen)
+			pool_cache_return(ctx, &POOL_CACHE[x]);
+	}
+
+	MTY_GlobalUnlock(&POOLS_LOCK);
+
+	MTY_Free(POOL_CACHE);
+	POOL_CACHE = NULL;
+	POOL_CACHE_LEN = 0;
+}
+
+static struct pool_cache *pool_cache(MTY_Pool *ctx)
+{
+	if (ctx->index >= POOL_CACHE_LEN) {
+		if (!POOL_CACHE)
+			thread_exit_hook(pool_cache_exit, NULL);
+
+		uint32_t len = POOL_CACHE_LEN > 0 ? POOL_CACHE_LEN : 8;
+
+		while (len <= ctx->index)
+			len *= 2;
+
+		POOL_CACHE = MTY_Realloc(POOL_CACHE, len, sizeof(struct pool_cache));
+		memset(POOL_CACHE + POOL_CACHE_LEN, 0, (len - POOL_CACHE_LEN) * sizeof(struct pool_cache));
+		POOL_CACHE_LEN = len;
+	}
+
+	struct pool_cache *cache = &POOL_CACHE[ctx->index];
+
+	// A different generation means this slot belonged to a destroyed pool
+	if (cache->gen != ctx->gen) {
+		memset(cache, 0, sizeof(struct pool_cache));
+		cache->gen = ctx->gen;
+	}
+
+	return cache;
+}
+
+static void pool_register(MTY_Pool *ctx)
+{
+	MTY_GlobalLock(&POOLS_LOCK);
+
+	uint32_t x = 0;
+
+	while (x < POOLS_LEN && POOLS[x])
+		x++;
+
+	if (x == POOLS_LEN) {
+		uint32_t len = POOLS_LEN > 0 ? POOLS_LEN * 2 : 8;
+
+		POOLS = MTY_Realloc(POOLS, len, sizeof(MTY_Pool *));
+		memset(POOLS + POOLS_LEN, 0, (len - POOLS_LEN) * sizeof(MTY_Pool *));
+		POOLS_LEN = len;
+	}
+
+	POOLS[x] = ctx;
+	ctx->index = x;
+
+	MTY_GlobalUnlock(&POOLS_LOCK);
+}
+
+static void pool_unregister(MTY_Pool *ctx)
+{
+	MTY_GlobalLock(&POOLS_LOCK);
+	POOLS[ctx->index] = NULL;
+	MTY_GlobalUnlock(&POOLS_LOCK);
+}
+
+
+// Metrics, usage is only counted on pools created while metrics were enabled
+
+static int64_t pool_used(const void *opaque)
+{
+	return MTY_Atomic64Get(&((MTY_Pool *) opaque)->used);
+}
+
+static int64_t pool_reserved(const void *opaque)
+{
+	return MTY_Atomic64Get(&((MTY_Pool *) opaque)->reserved);
+}
+
+
+// Public
+
+MTY_Pool *MTY_PoolCreate(size_t size)
+{
+	MTY_Pool *ctx = MTY_Alloc(1, sizeof(MTY_Pool));
+
+	// Objects are 16 byte aligned like other allocations
+	size = size < sizeof(struct pool_obj) ? sizeof(struct pool_obj) : size;
+	ctx->size = (size + 15) & ~((size_t) 15);
+
+	ctx->slab_size = POOL_SLAB_SIZE;
+	size_t min = POOL_HEADER + ctx->size * POOL_SLAB_MIN;
+
+	if (min > ctx->slab_size)
+		ctx->slab_size = (min + POOL_SLAB_SIZE - 1) & ~((size_t) POOL_SLAB_SIZE - 1);
+
+	ctx->gen = MTY_Atomic32Add(&POOL_GEN, 1);
+	pool_register(ctx);
+	ctx->mutex = MTY_MutexCreateNamed("MTY_Pool");
+
+	ctx->metrics = metrics_enabled();
+
+	if (ctx->metrics) {
+		metrics_track("mty.pool.used", pool_used, ctx);
+		metrics_track("mty.pool.reserved", pool_reserved, ctx);
+	}
+
+	return ctx;
+}
+
+void *MTY_PoolAlloc(MTY_Pool *ctx)
+{
+	struct pool_cache *cache = pool_cache(ctx);
+	struct pool_obj *obj = cache->freed;
+
+	if (obj) {
+		cache->freed = obj->next;
+		cache->count--;
+
+	} else {
+		if (!cache->avail)
+			cache->avail = pool_remote_take(ctx);
+
+		if (!cache->avail)
+			cache->avail = pool_carve(ctx);
+
+		obj = cache->avail;
+		cache->avail = obj->next;
+	}
+
+	memset(obj, 0, ctx->size);
+
+	if (ctx->metrics)
+		MTY_Atomic64Add(&ctx->used, (int64_t) ctx->size);
+
+	return obj;
+}
+
+void MTY_PoolFree(MTY_Pool *ctx, void *mem)
+{
+	if (!mem)
+		return;
+
+	struct pool_cache *cache = pool_cache(ctx);
+	struct pool_obj *obj = mem;
+
+	if (ctx->metrics)
+		MTY_Atomic64Add(&ctx->used, -(int64_t) ctx->size);
+
+	obj->next = cache->freed;
+	cache->freed = obj;
+
+	if (cache->count++ == 0)
+		cache->tail = obj;
+
+	// Hand a full magazine back so threads that mostly allocate can pick it up
+	if (cache->count >= POOL_MAGAZINE) {
+		pool_remote_push(ctx, cache->freed, cache->tail);
+
+		cache->freed = cache->tail = NULL;
+		cache->count = 0;
+	}
+}
+
+void MTY_PoolDestroy(MTY_Pool **pool)
+{
+	if (!pool || !*pool)
+		return;
+
+	MTY_Pool *ctx = *pool;
+
+	pool_unregister(ctx);
+
+	if (ctx->metrics)
+		metrics_untrack(ctx);
+
+	for (struct pool_slab *slab = ctx->slabs; slab;) {
+		struct pool_slab *next = slab->next;
+		MTY_FreePages(slab, slab->size);
+		slab = next;
+	}
+
+	MTY_MutexDestroy(&ctx->mutex);
+
+	MTY_Free(ctx);
+	*pool = NULL;
+}
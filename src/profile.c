@@ -0,0 +1,229 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "matoya.h"
+
+#include <string.h>
+
+#include "mty-tls.h"
+#include "thread-exit.h"
+
+#define PROFILE_EVENTS 8192
+#define PROFILE_DEPTH  64
+
+struct profile_event {
+	const char *name;
+	int64_t begin;
+	int64_t end;
+};
+
+struct profile_thread {
+	struct profile_thread *next;
+	uint32_t index;
+	int64_t id;
+	uint32_t depth;
+	bool exited;
+	MTY_Atomic64 cleared;
+	MTY_Atomic64 count;
+	struct profile_event open[PROFILE_DEPTH];
+	struct profile_event events[PROFILE_EVENTS];
+};
+
+static MTY_TLS struct profile_thread *PROFILE_THREAD;
+static struct profile_thread *PROFILE_THREADS;
+static uint32_t PROFILE_NUM_THREADS;
+static MTY_Atomic32 PROFILE_LOCK;
+static MTY_Atomic32 PROFILE_ENABLED;
+static MTY_Atomic64 PROFILE_BASE;
+
+
+// Thread buffers, each thread only ever writes its own and publishes with the count
+
+static void profile_thread_exit(void *opaque)
+{
+	struct profile_thread *pt = opaque;
+
+	MTY_GlobalLock(&PROFILE_LOCK);
+	pt->exited = true;
+	MTY_GlobalUnlock(&PROFILE_LOCK);
+
+	PROFILE_THREAD = NULL;
+}
+
+static struct profile_thread *profile_thread(void)
+{
+	if (!PROFILE_THREAD) {
+		// Buffers outlive their threads so zones from finished threads can still be
+		// exported, until a new thread takes the buffer over
+		MTY_GlobalLock(&PROFILE_LOCK);
+
+		struct profile_thread *pt = PROFILE_THREADS;
+
+		while (pt && !pt->exited)
+			pt = pt->next;
+
+		if (pt) {
+			MTY_Atomic64Set(&pt->cleared, MTY_Atomic64Get(&pt->count));
+			pt->exited = false;
+			pt->depth = 0;
+
+		} else {
+			pt = MTY_Alloc(1, sizeof(struct profile_thread));
+			pt->next = PROFILE_THREADS;
+			PROFILE_THREADS = pt;
+		}
+
+		pt->index = ++PROFILE_NUM_THREADS;
+		pt->id = MTY_ThreadGetID(NULL);
+
+		MTY_GlobalUnlock(&PROFILE_LOCK);
+
+		thread_exit_hook(profile_thread_exit, pt);
+		PROFILE_THREAD = pt;
+	}
+
+	return PROFILE_THREAD;
+}
+
+
+// Export
+
+static void profile_name(MTY_StrBuf *sb, const char *name)
+{
+	MTY_StrBufAppendLen(sb, "\"", 1);
+
+	for (const char *c = name; *c; c++) {
+		if (*c == '"' || *c == '\\') {
+			MTY_StrBufAppendLen(sb, "\\", 1);
+			MTY_StrBufAppendLen(sb, c, 1);
+
+		} else if ((unsigned char) *c >= 0x20) {
+			MTY_StrBufAppendLen(sb, c, 1);
+		}
+	}
+
+	MTY_StrBufAppendLen(sb, "\"", 1);
+}
+
+static void profile_export_thread(MTY_StrBuf *sb, struct profile_thread *pt, int64_t base, double scale,
+	bool *first)
+{
+	uint64_t end = MTY_Atomic64Get(&pt->count);
+	uint64_t begin = end > PROFILE_EVENTS ? end - PROFILE_EVENTS : 0;
+	uint64_t cleared = MTY_Atomic64Get(&pt->cleared);
+
+	if (begin < cleared)
+		begin = cleared;
+
+	if (begin >= end)
+		return;
+
+	struct profile_event *events = MTY_AllocUninit(end - begin, sizeof(struct profile_event));
+
+	for (uint64_t x = begin; x < end; x++)
+		events[x - begin] = pt->events[x % PROFILE_EVENTS];
+
+	// The owning thread may have lapped the oldest copies while they were read, and may
+	// be writing the slot of the oldest one still in the ring
+	uint64_t now = MTY_Atomic64Get(&pt->count);
+	uint64_t valid = now >= PROFILE_EVENTS ? now - PROFILE_EVENTS + 1 : 0;
+
+	MTY_StrBufPrintf(sb, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+		"\"args\":{\"name\":\"Thread %lld\"}}", *first ? "" : ",", pt->index, (long long) pt->id);
+	*first = false;
+
+	for (uint64_t x = begin > valid ? begin : valid; x < end; x++) {
+		struct profile_event *ev = &events[x - begin];
+
+		MTY_StrBufAppend(sb, ",{\"name\":");
+		profile_name(sb, ev->name);
+		MTY_StrBufPrintf(sb, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", pt->index,
+			(double) (ev->begin - base) * scale, (double) (ev->end - ev->begin) * scale);
+	}
+
+	MTY_Free(events);
+}
+
+
+// Public
+
+void MTY_ProfileEnable(bool enable)
+{
+	if (enable)
+		MTY_Atomic64CAS(&PROFILE_BASE, 0, MTY_TimestampFast());
+
+	MTY_Atomic32Set(&PROFILE_ENABLED, enable ? 1 : 0);
+}
+
+void MTY_ProfileBegin(const char *name)
+{
+	if (!MTY_Atomic32Get(&PROFILE_ENABLED))
+		return;
+
+	struct profile_thread *pt = profile_thread();
+
+	// Zones nested past the stack are not recorded but still balance with their end
+	if (pt->depth < PROFILE_DEPTH) {
+		pt->open[pt->depth].name = name;
+		pt->open[pt->depth].begin = MTY_TimestampFast();
+	}
+
+	pt->depth++;
+}
+
+void MTY_ProfileEnd(void)
+{
+	struct profile_thread *pt = PROFILE_THREAD;
+
+	if (!pt || pt->depth == 0)
+		return;
+
+	pt->depth--;
+
+	if (pt->depth >= PROFILE_DEPTH)
+		return;
+
+	int64_t end = MTY_TimestampFast();
+	uint64_t n = MTY_Atomic64Get(&pt->count);
+
+	struct profile_event *ev = &pt->events[n % PROFILE_EVENTS];
+	*ev = pt->open[pt->depth];
+	ev->end = end;
+
+	MTY_Atomic64Set(&pt->count, n + 1);
+}
+
+char *MTY_ProfileExport(void)
+{
+	MTY_StrBuf *sb = MTY_StrBufCreate(64 * 1024);
+	MTY_StrBufAppend(sb, "{\"traceEvents\":[");
+
+	// Trace event timestamps are microseconds
+	double scale = MTY_TimeDiff(0, 1000000) / 1000.0;
+	int64_t base = MTY_Atomic64Get(&PROFILE_BASE);
+	bool first = true;
+
+	MTY_GlobalLock(&PROFILE_LOCK);
+
+	for (struct profile_thread *pt = PROFILE_THREADS; pt; pt = pt->next)
+		profile_export_thread(sb, pt, base, scale, &first);
+
+	MTY_GlobalUnlock(&PROFILE_LOCK);
+
+	MTY_StrBufAppend(sb, "],\"displayTimeUnit\":\"ms\"}");
+
+	return MTY_StrBufDetach(&sb);
+}
+
+void MTY_ProfileReset(void)
+{
+	MTY_GlobalLock(&PROFILE_LOCK);
+
+	for (struct profile_thread *pt = PROFILE_THREADS; pt; pt = pt->next)
+		MTY_Atomic64Set(&pt->cleared, MTY_Atomic64Get(&pt->count));
+
+	MTY_GlobalUnlock(&PROFILE_LOCK);
+}
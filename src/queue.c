@@ -8,6 +8,11 @@
 
 #include <string.h>
 
+#include "metrics.h"
+
+// Slot buffers this large come straight from the OS on huge pages
+#define QUEUE_LARGE (2 * 1024 * 1024)
+
 enum {
 	QUEUE_EMPTY = 0,
 	QUEUE_FULL  = 1,
@@ -17,6 +22,7 @@ struct queue_slot {
 	void *data;
 	size_t size;
 	bool ptr;
+	bool buf;
 	MTY_Atomic32 state;
 };
 
@@ -30,8 +36,15 @@ struct MTY_Queue {
 	struct queue_slot *slots;
 	uint32_t push_pos;
 	uint32_t pop_pos;
+
+	bool metrics;
 };
 
+static int64_t queue_depth(const void *opaque)
+{
+	return MTY_QueueLength((MTY_Queue *) opaque);
+}
+
 MTY_Queue *MTY_QueueCreate(uint32_t len, size_t bufSize)
 {
 	MTY_Queue *ctx = MTY_Alloc(1, sizeof(MTY_Queue));
@@ -42,12 +55,18 @@ MTY_Queue *MTY_QueueCreate(uint32_t len, size_t bufSize)
 		ctx->buf_size = sizeof(void *);
 
 	ctx->pop_sync = MTY_SyncCreate();
-	ctx->push_mutex = MTY_MutexCreate();
+	ctx->push_mutex = MTY_MutexCreateNamed("MTY_Queue");
 
 	ctx->slots = MTY_Alloc(ctx->len, sizeof(struct queue_slot));
 
 	for (uint32_t x = 0; x < ctx->len; x++)
-		ctx->slots[x].data = MTY_Alloc(ctx->buf_size, 1);
+		ctx->slots[x].data = ctx->buf_size >= QUEUE_LARGE ?
+			MTY_AllocPages(ctx->buf_size, MTY_PAGE_HUGE) : MTY_Alloc(ctx->buf_size, 1);
+
+	ctx->metrics = metrics_enabled();
+
+	if (ctx->metrics)
+		metrics_track("mty.queue.depth", queue_depth, ctx);
 
 	return ctx;
 }
@@ -86,7 +105,7 @@ static uint32_t queue_next_pos(MTY_Queue *ctx, uint32_t pos)
 	return pos;
 }
 
-static void queue_push(MTY_Queue *ctx, size_t size, bool ptr)
+static void queue_push(MTY_Queue *ctx, size_t size, bool ptr, bool buf)
 {
 	if (size > 0) {
 		uint32_t lock_pos = ctx->push_pos;
@@ -95,6 +114,7 @@ static void queue_push(MTY_Queue *ctx, size_t size, bool ptr)
 		ctx->push_pos = queue_next_pos(ctx, ctx->push_pos);
 
 		ctx->slots[lock_pos].ptr = ptr;
+		ctx->slots[lock_pos].buf = buf;
 		MTY_Atomic32Set(&ctx->slots[lock_pos].state, QUEUE_FULL);
 
 		MTY_SyncWake(ctx->pop_sync);
@@ -105,7 +125,7 @@ static void queue_push(MTY_Queue *ctx, size_t size, bool ptr)
 
 void MTY_QueuePush(MTY_Queue *ctx, size_t size)
 {
-	queue_push(ctx, size, false);
+	queue_push(ctx, size, false, false);
 }
 
 static bool queue_pop(MTY_Queue *ctx, int32_t timeout, bool last, void **buffer, size_t *size)
@@ -141,7 +161,13 @@ static bool queue_pop(MTY_Queue *ctx, int32_t timeout, bool last, void **buffer,
 
 bool MTY_QueuePop(MTY_Queue *ctx, int32_t timeout, void **buffer, size_t *size)
 {
-	return queue_pop(ctx, timeout, false, buffer, size);
+	MTY_ProfileBegin("MTY_QueuePop");
+
+	bool r = queue_pop(ctx, timeout, false, buffer, size);
+
+	MTY_ProfileEnd();
+
+	return r;
 }
 
 bool MTY_QueuePopLast(MTY_Queue *ctx, int32_t timeout, void **buffer, size_t *size)
@@ -164,7 +190,7 @@ bool MTY_QueuePushPtr(MTY_Queue *ctx, const void *opaque, size_t size)
 
 	if (buffer) {
 		memcpy(buffer, &opaque, sizeof(void *));
-		queue_push(ctx, size, true);
+		queue_push(ctx, size, true, false);
 
 		return true;
 	}
@@ -186,12 +212,38 @@ bool MTY_QueuePopPtr(MTY_Queue *ctx, int32_t timeout, void **opaque, size_t *siz
 	return false;
 }
 
+bool MTY_QueuePushBuffer(MTY_Queue *ctx, MTY_Buffer *buffer)
+{
+	uint8_t *data = MTY_QueueAcquireBuffer(ctx);
+
+	if (data) {
+		// The queue holds its own reference until the buffer is popped
+		MTY_Buffer *ref = MTY_BufferRef(buffer);
+		memcpy(data, &ref, sizeof(MTY_Buffer *));
+		queue_push(ctx, sizeof(MTY_Buffer *), true, true);
+
+		return true;
+	}
+
+	return false;
+}
+
+bool MTY_QueuePopBuffer(MTY_Queue *ctx, int32_t timeout, MTY_Buffer **buffer)
+{
+	return MTY_QueuePopPtr(ctx, timeout, (void **) buffer, NULL);
+}
+
 void MTY_QueueFlush(MTY_Queue *ctx, void (*freeFunc)(void *value))
 {
 	for (void *data = NULL; queue_pop(ctx, 0, false, (void **) &data, NULL);) {
 		struct queue_slot *slot = &ctx->slots[ctx->pop_pos];
 
-		if (freeFunc && slot->ptr) {
+		if (slot->buf) {
+			MTY_Buffer *buf = NULL;
+			memcpy(&buf, slot->data, sizeof(MTY_Buffer *));
+			MTY_BufferRelease(&buf);
+
+		} else if (freeFunc && slot->ptr) {
 			void *ptr = NULL;
 			memcpy(&ptr, slot->data, sizeof(void *));
 			freeFunc(ptr);
@@ -208,8 +260,26 @@ void MTY_QueueDestroy(MTY_Queue **queue)
 
 	MTY_Queue *ctx = *queue;
 
-	for (uint32_t x = 0; x < ctx->len; x++)
-		MTY_Free(ctx->slots[x].data);
+	if (ctx->metrics)
+		metrics_untrack(ctx);
+
+	for (uint32_t x = 0; x < ctx->len; x++) {
+		struct queue_slot *slot = &ctx->slots[x];
+
+		// Buffers still in the queue hold a reference
+		if (slot->buf && MTY_Atomic32Get(&slot->state) == QUEUE_FULL) {
+			MTY_Buffer *buf = NULL;
+			memcpy(&buf, slot->data, sizeof(MTY_Buffer *));
+			MTY_BufferRelease(&buf);
+		}
+
+		if (ctx->buf_size >= QUEUE_LARGE) {
+			MTY_FreePages(ctx->slots[x].data, ctx->buf_size);
+
+		} else {
+			MTY_Free(ctx->slots[x].data);
+		}
+	}
 
 	MTY_Free(ctx->slots);
 
@@ -71,7 +71,7 @@ static bool render_create_api(MTY_Renderer *ctx, MTY_GFX api, MTY_Device *device
 	return false;
 }
 
-bool MTY_RendererDrawQuad(MTY_Renderer *ctx, MTY_GFX api, MTY_Device *device, MTY_Context *context,
+static bool render_draw_quad(MTY_Renderer *ctx, MTY_GFX api, MTY_Device *device, MTY_Context *context,
 	const void *image, const MTY_RenderDesc *desc, MTY_Texture *dest)
 {
 	// Metal only requires the context passed as an id<MTLCommandQueue>, device will be NULL
@@ -104,6 +104,18 @@ bool MTY_RendererDrawQuad(MTY_Renderer *ctx, MTY_GFX api, MTY_Device *device, MT
 	return false;
 }
 
+bool MTY_RendererDrawQuad(MTY_Renderer *ctx, MTY_GFX api, MTY_Device *device, MTY_Context *context,
+	const void *image, const MTY_RenderDesc *desc, MTY_Texture *dest)
+{
+	MTY_ProfileBegin("MTY_RendererDrawQuad");
+
+	bool r = render_draw_quad(ctx, api, device, context, image, desc, dest);
+
+	MTY_ProfileEnd();
+
+	return r;
+}
+
 void MTY_RendererDestroy(MTY_Renderer **renderer)
 {
 	if (!renderer || !*renderer)
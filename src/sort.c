@@ -28,7 +28,7 @@ static int sort_compare(const void *a, const void *b)
 void MTY_Sort(void *base, size_t nElements, size_t size, int32_t (*compare)(const void *a, const void *b))
 {
 	// Temporary copy of the base array for wrapping
-	uint8_t *tmp = MTY_Alloc(nElements, size);
+	uint8_t *tmp = MTY_AllocUninit(nElements, size);
 	memcpy(tmp, base, nElements * size);
 
 	// Wrap the base array elements in a struct now with 'orig' memory addresses in ascending order
@@ -0,0 +1,307 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "matoya.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386) || defined(_M_IX86)
+	#define SWAP_X86
+	#include <immintrin.h>
+
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define SWAP_TARGET(t)
+	#else
+		#include <cpuid.h>
+		#define SWAP_TARGET(t) __attribute__((target(t)))
+	#endif
+
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+	#define SWAP_NEON
+	#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+	#define SWAP16(v) _byteswap_ushort(v)
+	#define SWAP32(v) _byteswap_ulong(v)
+	#define SWAP64(v) _byteswap_uint64(v)
+#else
+	#define SWAP16(v) __builtin_bswap16(v)
+	#define SWAP32(v) __builtin_bswap32(v)
+	#define SWAP64(v) __builtin_bswap64(v)
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	#define SWAP_BIG_ENDIAN
+#endif
+
+
+// x86
+
+#if defined(SWAP_X86)
+
+enum swap_simd {
+	SWAP_SCALAR = 0,
+	SWAP_SSSE3  = 1,
+	SWAP_AVX2   = 2,
+};
+
+static MTY_Atomic32 SWAP_ONCE;
+static enum swap_simd SWAP_SIMD;
+
+static const uint8_t SWAP_MASK[3][16] = {
+	{1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14},
+	{3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12},
+	{7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8},
+};
+
+SWAP_TARGET("ssse3")
+static size_t swap_ssse3(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *mask)
+{
+	__m128i m = _mm_loadu_si128((const __m128i *) mask);
+	size_t x = 0;
+
+	for (; x + 16 <= size; x += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (src + x));
+		_mm_storeu_si128((__m128i *) (dst + x), _mm_shuffle_epi8(v, m));
+	}
+
+	return x;
+}
+
+SWAP_TARGET("avx2")
+static size_t swap_avx2(const uint8_t *src, uint8_t *dst, size_t size, const uint8_t *mask)
+{
+	// pshufb works within 128-bit lanes, so the same mask is used for both
+	__m256i m = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) mask));
+	size_t x = 0;
+
+	for (; x + 64 <= size; x += 64) {
+		__m256i v0 = _mm256_loadu_si256((const __m256i *) (src + x));
+		__m256i v1 = _mm256_loadu_si256((const __m256i *) (src + x + 32));
+		_mm256_storeu_si256((__m256i *) (dst + x), _mm256_shuffle_epi8(v0, m));
+		_mm256_storeu_si256((__m256i *) (dst + x + 32), _mm256_shuffle_epi8(v1, m));
+	}
+
+	for (; x + 32 <= size; x += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) (src + x));
+		_mm256_storeu_si256((__m256i *) (dst + x), _mm256_shuffle_epi8(v, m));
+	}
+
+	return x;
+}
+
+static void swap_cpuid(uint32_t leaf, uint32_t *regs)
+{
+	#if defined(_MSC_VER)
+		__cpuidex((int32_t *) regs, leaf, 0);
+	#else
+		__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+	#endif
+}
+
+static uint64_t swap_xgetbv(void)
+{
+	#if defined(_MSC_VER)
+		return _xgetbv(0);
+	#else
+		uint32_t lo = 0, hi = 0;
+		__asm__ volatile ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+
+		return ((uint64_t) hi << 32) | lo;
+	#endif
+}
+
+static void swap_detect(void *opaque)
+{
+	// cpuid is queried directly since the library is linked without libgcc
+	uint32_t regs[4] = {0};
+	swap_cpuid(0, regs);
+
+	uint32_t max = regs[0];
+
+	swap_cpuid(1, regs);
+	bool ssse3 = regs[2] & (1 << 9);
+	bool osxsave = regs[2] & (1 << 27);
+	bool avx = regs[2] & (1 << 28);
+
+	bool avx2 = false;
+
+	if (max >= 7) {
+		swap_cpuid(7, regs);
+		avx2 = regs[1] & (1 << 5);
+	}
+
+	// The OS must also save the upper halves of the ymm registers
+	if (avx2 && (!avx || !osxsave || (swap_xgetbv() & 0x6) != 0x6))
+		avx2 = false;
+
+	SWAP_SIMD = avx2 ? SWAP_AVX2 : ssse3 ? SWAP_SSSE3 : SWAP_SCALAR;
+}
+
+static size_t swap_simd(const uint8_t *src, uint8_t *dst, size_t size, uint8_t width)
+{
+	MTY_Once(&SWAP_ONCE, swap_detect, NULL);
+
+	const uint8_t *mask = SWAP_MASK[width == 2 ? 0 : width == 4 ? 1 : 2];
+
+	switch (SWAP_SIMD) {
+		case SWAP_AVX2: {
+			size_t x = swap_avx2(src, dst, size, mask);
+			return x + swap_ssse3(src + x, dst + x, size - x, mask);
+		}
+		case SWAP_SSSE3:
+			return swap_ssse3(src, dst, size, mask);
+		default:
+			break;
+	}
+
+	return 0;
+}
+
+
+// ARM
+
+#elif defined(SWAP_NEON)
+
+static size_t swap_simd(const uint8_t *src, uint8_t *dst, size_t size, uint8_t width)
+{
+	size_t x = 0;
+
+	switch (width) {
+		case 2:
+			for (; x + 16 <= size; x += 16)
+				vst1q_u8(dst + x, vrev16q_u8(vld1q_u8(src + x)));
+			break;
+		case 4:
+			for (; x + 16 <= size; x += 16)
+				vst1q_u8(dst + x, vrev32q_u8(vld1q_u8(src + x)));
+			break;
+		case 8:
+			for (; x + 16 <= size; x += 16)
+				vst1q_u8(dst + x, vrev64q_u8(vld1q_u8(src + x)));
+			break;
+	}
+
+	return x;
+}
+
+
+// Other
+
+#else
+
+static size_t swap_simd(const uint8_t *src, uint8_t *dst, size_t size, uint8_t width)
+{
+	return 0;
+}
+
+#endif
+
+
+// Scalar tails
+
+static void swap16_scalar(const uint8_t *src, uint8_t *dst, size_t len)
+{
+	for (size_t x = 0; x < len; x++) {
+		uint16_t v = 0;
+		memcpy(&v, src + x * 2, 2);
+		v = SWAP16(v);
+		memcpy(dst + x * 2, &v, 2);
+	}
+}
+
+static void swap32_scalar(const uint8_t *src, uint8_t *dst, size_t len)
+{
+	for (size_t x = 0; x < len; x++) {
+		uint32_t v = 0;
+		memcpy(&v, src + x * 4, 4);
+		v = SWAP32(v);
+		memcpy(dst + x * 4, &v, 4);
+	}
+}
+
+static void swap64_scalar(const uint8_t *src, uint8_t *dst, size_t len)
+{
+	for (size_t x = 0; x < len; x++) {
+		uint64_t v = 0;
+		memcpy(&v, src + x * 8, 8);
+		v = SWAP64(v);
+		memcpy(dst + x * 8, &v, 8);
+	}
+}
+
+
+// Public
+
+void MTY_Swap16Array(const void *src, void *dst, size_t len)
+{
+	size_t x = swap_simd(src, dst, len * 2, 2);
+	swap16_scalar((const uint8_t *) src + x, (uint8_t *) dst + x, len - x / 2);
+}
+
+void MTY_Swap32Array(const void *src, void *dst, size_t len)
+{
+	size_t x = swap_simd(src, dst, len * 4, 4);
+	swap32_scalar((const uint8_t *) src + x, (uint8_t *) dst + x, len - x / 4);
+}
+
+void MTY_Swap64Array(const void *src, void *dst, size_t len)
+{
+	size_t x = swap_simd(src, dst, len * 8, 8);
+	swap64_scalar((const uint8_t *) src + x, (uint8_t *) dst + x, len - x / 8);
+}
+
+#if defined(SWAP_BIG_ENDIAN)
+static void swap_copy(const void *src, void *dst, size_t size)
+{
+	if (src != dst)
+		memmove(dst, src, size);
+}
+#endif
+
+void MTY_SwapToBE16Array(const void *src, void *dst, size_t len)
+{
+	#if defined(SWAP_BIG_ENDIAN)
+		swap_copy(src, dst, len * 2);
+	#else
+		MTY_Swap16Array(src, dst, len);
+	#endif
+}
+
+void MTY_SwapToBE32Array(const void *src, void *dst, size_t len)
+{
+	#if defined(SWAP_BIG_ENDIAN)
+		swap_copy(src, dst, len * 4);
+	#else
+		MTY_Swap32Array(src, dst, len);
+	#endif
+}
+
+void MTY_SwapToBE64Array(const void *src, void *dst, size_t len)
+{
+	#if defined(SWAP_BIG_ENDIAN)
+		swap_copy(src, dst, len * 8);
+	#else
+		MTY_Swap64Array(src, dst, len);
+	#endif
+}
+
+void MTY_SwapFromBE16Array(const void *src, void *dst, size_t len)
+{
+	MTY_SwapToBE16Array(src, dst, len);
+}
+
+void MTY_SwapFromBE32Array(const void *src, void *dst, size_t len)
+{
+	MTY_SwapToBE32Array(src, dst, len);
+}
+
+void MTY_SwapFromBE64Array(const void *src, void *dst, size_t len)
+{
+	MTY_SwapToBE64Array(src, dst, len);
+}
@@ -76,6 +76,674 @@ static bool test_time(void)
 }
 
 
+// timer
+
+#define TEST_TIMER_FIRES 64
+
+static MTY_Atomic64 TEST_TIMER_FIRED;
+static MTY_Atomic32 TEST_TIMER_COUNT;
+static MTY_Atomic32 TEST_TIMER_CANCELLED;
+static int64_t TEST_TIMER_TS[TEST_TIMER_FIRES];
+
+static void test_timer_once(void *opaque)
+{
+	MTY_Atomic64Set(&TEST_TIMER_FIRED, MTY_Timestamp());
+}
+
+static void test_timer_interval(void *opaque)
+{
+	int64_t ts = MTY_Timestamp();
+	int32_t n = MTY_Atomic32Add(&TEST_TIMER_COUNT, 1);
+
+	if (n <= TEST_TIMER_FIRES)
+		TEST_TIMER_TS[n - 1] = ts;
+}
+
+static void test_timer_cancelled(void *opaque)
+{
+	MTY_Atomic32Add(&TEST_TIMER_CANCELLED, 1);
+}
+
+static bool test_timer(void)
+{
+	MTY_TimerWheel *wheel = MTY_TimerWheelCreate(1, 2);
+	test_cmp("MTY_TimerWheel", wheel);
+
+	int64_t ts = MTY_Timestamp();
+
+	uint32_t once = MTY_TimerWheelAdd(wheel, 50, 0, test_timer_once, NULL);
+	uint32_t interval = MTY_TimerWheelAdd(wheel, 20, 20, test_timer_interval, NULL);
+	uint32_t cancelled = MTY_TimerWheelAdd(wheel, 30, 0, test_timer_cancelled, NULL);
+	test_cmp("MTY_TimerWheelAdd", once && interval && cancelled);
+
+	bool r = MTY_TimerWheelCancel(wheel, cancelled);
+	test_cmp("MTY_TimerWheel", r);
+
+	// Wall time is only used as a lower bound, a loaded machine may run timers late
+	for (uint32_t x = 0; x < 400; x++) {
+		if (MTY_Atomic64Get(&TEST_TIMER_FIRED) > 0 && MTY_Atomic32Get(&TEST_TIMER_COUNT) >= 5)
+			break;
+
+		MTY_Sleep(5);
+	}
+
+	r = MTY_TimerWheelCancel(wheel, interval);
+	test_cmp("MTY_TimerWheel", r);
+
+	int64_t fired = MTY_Atomic64Get(&TEST_TIMER_FIRED);
+	float diff = fired > 0 ? MTY_TimeDiff(ts, fired) : 0.0f;
+	test_cmpf("MTY_TimerWheelAdd", diff >= 50.0f, diff);
+
+	int32_t count = MTY_Atomic32Get(&TEST_TIMER_COUNT);
+	test_cmpi64("MTY_TimerWheelAdd", count >= 5, (int64_t) count);
+
+	// Fired one-shot timers are gone, cancelled ones never run
+	r = MTY_TimerWheelCancel(wheel, once);
+	test_cmp("MTY_TimerWheel", !r);
+
+	MTY_Sleep(50);
+
+	int32_t after = MTY_Atomic32Get(&TEST_TIMER_COUNT);
+	test_cmp("MTY_TimerWheel", after == count);
+
+	// The nth firing is never earlier than n intervals, even after skipping periods
+	bool early = false;
+
+	for (int32_t x = 0; x < count && x < TEST_TIMER_FIRES; x++)
+		early = early || MTY_TimeDiff(ts, TEST_TIMER_TS[x]) < 20.0f * (x + 1);
+
+	test_cmp("MTY_TimerWheelAdd", !early);
+
+	int32_t ran = MTY_Atomic32Get(&TEST_TIMER_CANCELLED);
+	test_cmp("MTY_TimerWheel", ran == 0);
+
+	MTY_TimerWheelDestroy(&wheel);
+	test_cmp("MTY_TimerWheel", !wheel);
+
+	return true;
+}
+
+
+// arena
+
+static bool test_arena(void)
+{
+	MTY_Arena *arena = MTY_ArenaCreate(64 * 1024);
+	test_cmp("MTY_ArenaCreate", arena);
+
+	uint8_t *first = MTY_ArenaAlloc(arena, 100);
+	uint8_t *prev = first;
+	bool aligned = ((uintptr_t) first & 15) == 0;
+	bool ordered = true;
+
+	// Enough allocations to spill into a second chunk
+	for (uint32_t x = 0; x < 1000; x++) {
+		uint8_t *p = MTY_ArenaAlloc(arena, 100);
+		memset(p, 0xAB, 100);
+
+		aligned = aligned && ((uintptr_t) p & 15) == 0;
+		ordered = ordered && (p >= prev + 100 || p < prev);
+		prev = p;
+	}
+
+	test_cmp("MTY_ArenaAlloc", aligned);
+	test_cmp("MTY_ArenaAlloc", ordered);
+
+	uintptr_t page = (uintptr_t) MTY_ArenaAllocAligned(arena, 10, 4096);
+	test_cmp("MTY_ArenaAlloc", page && (page & 4095) == 0);
+
+	void *bad = MTY_ArenaAllocAligned(arena, 10, 24);
+	test_cmp("MTY_ArenaAlloc", !bad);
+
+	uint8_t *large = MTY_ArenaAlloc(arena, 200 * 1024);
+	test_cmp("MTY_ArenaAlloc", large);
+	memset(large, 0xCD, 200 * 1024);
+
+	size_t mark = MTY_ArenaMark(arena);
+	void *a = MTY_ArenaAlloc(arena, 64);
+	MTY_ArenaRewind(arena, mark);
+	void *b = MTY_ArenaAlloc(arena, 64);
+	test_cmp("MTY_ArenaRewind", a == b);
+
+	MTY_ArenaReset(arena);
+	void *reset = MTY_ArenaAlloc(arena, 100);
+	test_cmp("MTY_ArenaReset", reset == first);
+
+	MTY_ArenaDestroy(&arena);
+	test_cmp("MTY_ArenaDestroy", !arena);
+
+	return true;
+}
+
+
+// pool
+
+#define TEST_POOL_OBJS 10
+
+static void *TEST_POOL_FREED[TEST_POOL_OBJS];
+
+static void *test_pool_thread(void *opaque)
+{
+	MTY_Pool *pool = opaque;
+
+	for (uint32_t x = 0; x < TEST_POOL_OBJS; x++)
+		TEST_POOL_FREED[x] = MTY_PoolAlloc(pool);
+
+	for (uint32_t x = 0; x < TEST_POOL_OBJS; x++)
+		MTY_PoolFree(pool, TEST_POOL_FREED[x]);
+
+	return NULL;
+}
+
+static bool test_pool(void)
+{
+	MTY_Pool *pool = MTY_PoolCreate(24);
+	test_cmp("MTY_PoolCreate", pool);
+
+	uint8_t *a = MTY_PoolAlloc(pool);
+	uint8_t *b = MTY_PoolAlloc(pool);
+	bool aligned = ((uintptr_t) a & 15) == 0 && ((uintptr_t) b & 15) == 0;
+	test_cmp("MTY_PoolAlloc", aligned);
+	test_cmp("MTY_PoolAlloc", a != b);
+
+	memset(a, 0xAB, 24);
+	MTY_PoolFree(pool, a);
+
+	// The thread cache hands the most recently freed object back zeroed
+	uint8_t *c = MTY_PoolAlloc(pool);
+	test_cmp("MTY_PoolFree", c == a);
+	test_cmp("MTY_PoolAlloc", c[0] == 0 && c[23] == 0);
+
+	MTY_PoolFree(pool, b);
+	MTY_PoolFree(pool, c);
+
+	// Objects cached by a thread go back to the pool when it exits
+	MTY_Thread *thread = MTY_ThreadCreate(test_pool_thread, pool);
+	MTY_ThreadDestroy(&thread);
+
+	uint32_t reused = 0;
+	void *objs[128];
+
+	for (uint32_t x = 0; x < 128; x++) {
+		objs[x] = MTY_PoolAlloc(pool);
+
+		for (uint32_t y = 0; y < TEST_POOL_OBJS; y++)
+			if (objs[x] == TEST_POOL_FREED[y])
+				reused++;
+	}
+
+	test_cmp("MTY_PoolFree", reused == TEST_POOL_OBJS);
+
+	for (uint32_t x = 0; x < 128; x++)
+		MTY_PoolFree(pool, objs[x]);
+
+	MTY_PoolDestroy(&pool);
+	test_cmp("MTY_PoolDestroy", !pool);
+
+	// There is no fixed limit on live pools
+	MTY_Pool *pools[300];
+	bool ok = true;
+
+	for (uint32_t x = 0; x < 300; x++) {
+		pools[x] = MTY_PoolCreate(8);
+		ok = ok && MTY_PoolAlloc(pools[x]);
+	}
+
+	for (uint32_t x = 0; x < 300; x++)
+		MTY_PoolDestroy(&pools[x]);
+
+	test_cmp("MTY_PoolCreate", ok);
+
+	return true;
+}
+
+
+// buffer
+
+static uint32_t TEST_BUFFER_RECYCLED;
+
+static void test_buffer_recycle(MTY_Buffer *buffer, void *opaque)
+{
+	// Pushing takes a new reference, reviving the buffer in the free queue
+	MTY_QueuePushBuffer(opaque, buffer);
+	TEST_BUFFER_RECYCLED++;
+}
+
+static void test_buffer_drop(MTY_Buffer *buffer, void *opaque)
+{
+	(*(uint32_t *) opaque)++;
+	MTY_BufferDestroy(&buffer);
+}
+
+static bool test_buffer(void)
+{
+	MTY_Queue *q = MTY_QueueCreate(4, 64);
+	MTY_Queue *freeq = MTY_QueueCreate(4, 64);
+
+	MTY_Buffer *buf = MTY_BufferCreate(64);
+	size_t size = MTY_BufferGetSize(buf);
+	test_cmp("MTY_BufferCreate", size == 64);
+
+	uint8_t *data = MTY_BufferGetData(buf);
+	MTY_BufferSetRecycle(buf, test_buffer_recycle, freeq);
+
+	MTY_Buffer *slice = MTY_BufferSlice(buf, 16, 32);
+	size = slice ? MTY_BufferGetSize(slice) : 0;
+	test_cmp("MTY_BufferSlice", size == 32);
+
+	uint8_t *sdata = MTY_BufferGetData(slice);
+	test_cmp("MTY_BufferSlice", sdata == data + 16);
+
+	MTY_Buffer *bad = MTY_BufferSlice(buf, 40, 32);
+	test_cmp("MTY_BufferSlice", !bad);
+
+	bool r = MTY_QueuePushBuffer(q, buf);
+	test_cmp("MTY_QueuePushBuffer", r);
+
+	// The queue and the slice still hold references
+	MTY_BufferRelease(&buf);
+	test_cmp("MTY_BufferRelease", !buf && TEST_BUFFER_RECYCLED == 0);
+
+	MTY_Buffer *popped = NULL;
+	r = MTY_QueuePopBuffer(q, 0, &popped);
+	test_cmp("MTY_QueuePopBuffer", r && popped);
+	test_cmp("MTY_QueuePopBuffer", MTY_BufferGetData(popped) == data);
+
+	MTY_BufferRelease(&popped);
+	test_cmp("MTY_BufferRelease", TEST_BUFFER_RECYCLED == 0);
+
+	// The last reference goes with the slice, which hands the buffer to the recycler
+	MTY_BufferRelease(&slice);
+	test_cmp("MTY_BufferRelease", TEST_BUFFER_RECYCLED == 1);
+
+	uint32_t len = MTY_QueueLength(freeq);
+	test_cmp("MTY_BufferRelease", len == 1);
+
+	r = MTY_QueuePopBuffer(freeq, 0, &popped);
+	test_cmp("MTY_QueuePopBuffer", r && popped);
+	test_cmp("MTY_QueuePopBuffer", MTY_BufferGetData(popped) == data);
+
+	MTY_BufferSetRecycle(popped, NULL, NULL);
+	MTY_BufferRelease(&popped);
+	test_cmp("MTY_BufferRelease", TEST_BUFFER_RECYCLED == 1);
+
+	MTY_QueueDestroy(&freeq);
+
+	// Destroying a queue releases the buffers still in it
+	uint32_t dropped = 0;
+	buf = MTY_BufferCreate(8);
+	MTY_BufferSetRecycle(buf, test_buffer_drop, &dropped);
+
+	MTY_QueuePushBuffer(q, buf);
+	MTY_BufferRelease(&buf);
+	MTY_QueueDestroy(&q);
+	test_cmp("MTY_QueueDestroy", dropped == 1);
+
+	return true;
+}
+
+
+// vec
+
+static bool test_vec(void)
+{
+	MTY_Vec *vec = MTY_VecCreate(sizeof(uint32_t), 0);
+	test_cmp("MTY_VecCreate", MTY_VecLength(vec) == 0);
+
+	// Growth must keep every element through each reallocation
+	for (uint32_t x = 0; x < 1000; x++)
+		*(uint32_t *) MTY_VecPush(vec) = x;
+
+	bool ok = MTY_VecLength(vec) == 1000;
+
+	for (uint32_t x = 0; x < 1000 && ok; x++)
+		ok = *(uint32_t *) MTY_VecGet(vec, x) == x;
+
+	test_cmp("MTY_VecPush", ok);
+	test_cmp("MTY_VecGet", !MTY_VecGet(vec, 1000));
+
+	uint32_t more[3] = {7, 8, 9};
+	MTY_VecAppend(vec, more, 3);
+
+	uint32_t *data = MTY_VecGetData(vec);
+	size_t len = MTY_VecLength(vec);
+	test_cmp("MTY_VecAppend", len == 1003 && data[1002] == 9);
+
+	MTY_VecClear(vec);
+	test_cmp("MTY_VecClear", MTY_VecLength(vec) == 0);
+
+	uint32_t *pushed = MTY_VecPush(vec);
+	test_cmp("MTY_VecPush", *pushed == 0);
+
+	data = MTY_VecDetach(&vec, &len);
+	test_cmp("MTY_VecDetach", !vec && data && len == 1);
+	MTY_Free(data);
+
+	MTY_StrBuf *sb = MTY_StrBufCreate(0);
+	test_cmp("MTY_StrBufCreate", !strcmp(MTY_StrBufGet(sb), ""));
+
+	for (uint32_t x = 0; x < 100; x++)
+		MTY_StrBufAppend(sb, "0123456789");
+
+	test_cmp("MTY_StrBufAppend", MTY_StrBufLength(sb) == 1000);
+
+	// Longer than the remaining capacity, so it is formatted twice
+	char big[600];
+	memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+
+	MTY_StrBufPrintf(sb, "%s-%d", big, 42);
+
+	const char *str = MTY_StrBufGet(sb);
+	size_t slen = MTY_StrBufLength(sb);
+	test_cmp("MTY_StrBufPrintf", slen == 1602 && strlen(str) == slen);
+	test_cmp("MTY_StrBufPrintf", !strcmp(str + 1599, "-42"));
+
+	MTY_StrBufAppendLen(sb, "abc", 2);
+	str = MTY_StrBufGet(sb);
+	test_cmp("MTY_StrBufAppend", !strcmp(str + 1602, "ab"));
+
+	MTY_StrBufClear(sb);
+	test_cmp("MTY_StrBufClear", !strcmp(MTY_StrBufGet(sb), ""));
+
+	MTY_StrBufAppend(sb, "end");
+	char *detached = MTY_StrBufDetach(&sb);
+	test_cmp("MTY_StrBufDetach", !sb && !strcmp(detached, "end"));
+	MTY_Free(detached);
+
+	return true;
+}
+
+
+// swap
+
+#define TEST_SWAP_LEN 67
+
+static bool test_swap(void)
+{
+	uint16_t src16[TEST_SWAP_LEN], dst16[TEST_SWAP_LEN + 1];
+	uint32_t src32[TEST_SWAP_LEN], dst32[TEST_SWAP_LEN + 1];
+	uint64_t src64[TEST_SWAP_LEN], dst64[TEST_SWAP_LEN + 1];
+
+	for (uint32_t x = 0; x < TEST_SWAP_LEN; x++) {
+		src16[x] = (uint16_t) (0x0102 * (x + 1));
+		src32[x] = 0x01020304 * (x + 1);
+		src64[x] = 0x0102030405060708ull * (x + 1);
+	}
+
+	// Every length up to past the widest vector, so each tail size is exercised
+	bool ok16 = true, ok32 = true, ok64 = true;
+
+	for (uint32_t len = 0; len < TEST_SWAP_LEN; len++) {
+		memset(dst16, 0xEE, sizeof(dst16));
+		memset(dst32, 0xEE, sizeof(dst32));
+		memset(dst64, 0xEE, sizeof(dst64));
+
+		MTY_Swap16Array(src16, dst16, len);
+		MTY_Swap32Array(src32, dst32, len);
+		MTY_Swap64Array(src64, dst64, len);
+
+		for (uint32_t x = 0; x < len; x++) {
+			ok16 = ok16 && dst16[x] == MTY_Swap16(src16[x]);
+			ok32 = ok32 && dst32[x] == MTY_Swap32(src32[x]);
+			ok64 = ok64 && dst64[x] == MTY_Swap64(src64[x]);
+		}
+
+		ok16 = ok16 && dst16[len] == 0xEEEE;
+		ok32 = ok32 && dst32[len] == 0xEEEEEEEE;
+		ok64 = ok64 && dst64[len] == 0xEEEEEEEEEEEEEEEEull;
+	}
+
+	test_cmp("MTY_Swap16Array", ok16);
+	test_cmp("MTY_Swap32Array", ok32);
+	test_cmp("MTY_Swap64Array", ok64);
+
+	MTY_SwapToBE32Array(src32, dst32, TEST_SWAP_LEN);
+	bool be = dst32[0] == MTY_SwapToBE32(src32[0]);
+
+	MTY_SwapFromBE32Array(dst32, dst32, TEST_SWAP_LEN);
+	bool round = !memcmp(dst32, src32, sizeof(src32));
+
+	test_cmp("MTY_SwapToBE32Array", be);
+	test_cmp("MTY_SwapFromBE32Arr", round);
+
+	return true;
+}
+
+
+// utf
+
+static bool test_utf(void)
+{
+	uint16_t u16[8];
+	uint32_t u32[8];
+	char u8[16];
+
+	// 'a', U+00E9, U+1F600
+	const char *valid = "a\xC3\xA9\xF0\x9F\x98\x80";
+
+	size_t n16 = MTY_UTF8ToUTF16(valid, u16, 8);
+	bool pair = n16 == 5 && u16[2] == 0xD83D && u16[3] == 0xDE00 && u16[4] == 0;
+	test_cmp("MTY_UTF8ToUTF16", pair);
+
+	size_t n8 = MTY_UTF16ToUTF8(u16, u8, 16);
+	test_cmp("MTY_UTF16ToUTF8", n8 == 8 && !strcmp(u8, valid));
+
+	size_t n32 = MTY_UTF8ToUTF32(valid, u32, 8);
+	bool astral = n32 == 4 && u32[2] == 0x1F600 && u32[3] == 0;
+	test_cmp("MTY_UTF8ToUTF32", astral);
+
+	n8 = MTY_UTF32ToUTF8(u32, u8, 16);
+	test_cmp("MTY_UTF32ToUTF8", n8 == 8 && !strcmp(u8, valid));
+
+	// Out of room stops at a code point boundary and still reports the full length
+	n16 = MTY_UTF8ToUTF16(valid, u16, 4);
+	bool cut = n16 == 5 && u16[1] == 0xE9 && u16[2] == 0;
+	test_cmp("MTY_UTF8ToUTF16", cut);
+
+	// Overlong, encoded surrogate, above U+10FFFF, truncated, stray continuation
+	const char *bad8[] = {"\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80",
+		"\xF4\x90\x80\x80", "a\xE2\x82", "\x80"};
+
+	bool strict = true;
+	for (size_t x = 0; x < sizeof(bad8) / sizeof(bad8[0]); x++)
+		strict = strict && MTY_UTF8ToUTF16(bad8[x], NULL, 0) == 0 &&
+			MTY_UTF8ToUTF32(bad8[x], NULL, 0) == 0;
+
+	test_cmp("MTY_UTF8ToUTF16", strict);
+
+	// Unpaired and reversed surrogates
+	const uint16_t lone[] = {'a', 0xD800, 'b', 0};
+	const uint16_t trail[] = {0xDC00, 0xD800, 0};
+	n8 = MTY_UTF16ToUTF8(lone, NULL, 0) + MTY_UTF16ToUTF8(trail, NULL, 0);
+	test_cmp("MTY_UTF16ToUTF8", n8 == 0);
+
+	const uint32_t big[] = {0x110000, 0};
+	const uint32_t sur[] = {0xDFFF, 0};
+	n8 = MTY_UTF32ToUTF8(big, NULL, 0) + MTY_UTF32ToUTF8(sur, NULL, 0);
+	test_cmp("MTY_UTF32ToUTF8", n8 == 0);
+
+	// The wide converters substitute U+FFFD instead
+	wchar_t big_w = (wchar_t) (WCHAR_MAX > 0xFFFF ? 0x110000 : 0xDC00);
+	const wchar_t wide[] = {'a', 0xD800, 'b', big_w, 0};
+
+	char *multi = MTY_WideToMultiD(wide);
+	bool replaced = !strcmp(multi, "a\xEF\xBF\xBD" "b\xEF\xBF\xBD");
+	test_cmp("MTY_WideToMultiD", replaced);
+	MTY_Free(multi);
+
+	wchar_t *w = MTY_MultiToWideD("a\xC0" "b");
+	replaced = w[0] == 'a' && w[1] == 0xFFFD && w[2] == 'b' && w[3] == 0;
+	test_cmp("MTY_MultiToWideD", replaced);
+	MTY_Free(w);
+
+	return true;
+}
+
+
+// alloc debug
+
+static bool test_alloc_debug(void)
+{
+	test_cmp("MTY_AllocDebugCheck", MTY_AllocDebugCheck() == 0);
+
+	// The guard directly follows the requested size
+	uint8_t *mem = MTY_AllocUninit(24, 1);
+	uint8_t guard = mem[24];
+	mem[24] = 0;
+
+	uint32_t found = MTY_AllocDebugCheck();
+	test_cmp("MTY_AllocDebugCheck", found == 1);
+
+	mem[24] = guard;
+	test_cmp("MTY_AllocDebugCheck", MTY_AllocDebugCheck() == 0);
+
+	// Freed blocks are quarantined and poisoned, a write after free is caught
+	MTY_Free(mem);
+	uint8_t poison = mem[0];
+	mem[0] = 0;
+
+	found = MTY_AllocDebugCheck();
+	test_cmp("MTY_AllocDebugCheck", found == 1);
+
+	mem[0] = poison;
+
+	// Live allocations are reported with their tag until freed
+	const char *prev = MTY_AllocProfileTag("test-leak");
+	void *leak = MTY_Alloc(40, 1);
+	MTY_AllocProfileTag(prev);
+
+	char *report = MTY_AllocDebugReport();
+	bool listed = strstr(report, "test-leak") != NULL;
+	test_cmp("MTY_AllocDebugRep", listed);
+	MTY_Free(report);
+
+	MTY_Free(leak);
+
+	report = MTY_AllocDebugReport();
+	listed = strstr(report, "test-leak") != NULL;
+	test_cmp("MTY_AllocDebugRep", !listed);
+	MTY_Free(report);
+
+	return true;
+}
+
+
+// histogram
+
+static bool test_histogram(void)
+{
+	MTY_Histogram *h = MTY_HistogramCreate();
+
+	uint64_t empty = MTY_HistogramPercentile(h, 50.0);
+	test_cmp("MTY_Histogram", empty == 0);
+
+	// Small values get exact buckets
+	for (uint64_t x = 1; x <= 200; x++)
+		MTY_HistogramRecord(h, x);
+
+	uint64_t p50 = MTY_HistogramPercentile(h, 50.0);
+	test_cmp("MTY_Histogram", p50 == 100);
+
+	MTY_HistogramReset(h);
+
+	MTY_HistogramStats stats = {0};
+	MTY_HistogramGetStats(h, &stats);
+	test_cmp("MTY_HistogramReset", stats.count == 0 && stats.max == 0);
+
+	// Larger values land within 1% above the exact rank, never below it
+	const uint64_t n = 100000;
+
+	for (uint64_t x = 1; x <= n; x++)
+		MTY_HistogramRecord(h, x);
+
+	const double pcts[] = {1.0, 25.0, 50.0, 90.0, 99.0, 99.9};
+	bool bounded = true;
+
+	for (size_t x = 0; x < sizeof(pcts) / sizeof(pcts[0]); x++) {
+		uint64_t exact = (uint64_t) (pcts[x] / 100.0 * (double) n);
+		uint64_t v = MTY_HistogramPercentile(h, pcts[x]);
+
+		bounded = bounded && v >= exact && (double) v <= (double) exact * 1.01;
+	}
+
+	test_cmp("MTY_Histogram", bounded);
+
+	// The ends are clamped to the recorded min and max
+	uint64_t lo = MTY_HistogramPercentile(h, 0.0);
+	uint64_t hi = MTY_HistogramPercentile(h, 100.0);
+	test_cmp("MTY_Histogram", lo == 1 && hi == n);
+
+	MTY_HistogramGetStats(h, &stats);
+	bool range = stats.count == n && stats.min == 1 && stats.max == n;
+	bool ordered = stats.p50 <= stats.p90 && stats.p90 <= stats.p99 && stats.p99 <= stats.p999;
+	bool mean = stats.mean == (double) (n + 1) / 2.0;
+	test_cmp("MTY_HistogramStats", range);
+	test_cmp("MTY_HistogramStats", ordered && stats.p999 <= n);
+	test_cmpf("MTY_HistogramStats", mean, stats.mean);
+
+	// The top bucket covers the full range
+	MTY_HistogramRecord(h, UINT64_MAX);
+	bool top = MTY_HistogramPercentile(h, 100.0) == UINT64_MAX;
+	test_cmp("MTY_Histogram", top);
+
+	MTY_HistogramDestroy(&h);
+
+	return true;
+}
+
+
+// log
+
+static bool test_log(void)
+{
+	// Suppressed messages are formatted lazily but still reach MTY_GetLog
+	MTY_LogSetRateLimit(1, 2);
+
+	for (int32_t x = 0; x < 5; x++)
+		MTY_Log("Rate limited %d %s", x, "message");
+
+	const char *last = MTY_GetLog();
+	bool lazy = strstr(last, "Rate limited 4 message") != NULL;
+	test_cmp("MTY_LogSetRateLimit", lazy);
+
+	MTY_LogSetRateLimit(0, 0);
+
+	return true;
+}
+
+
+// lock profile
+
+static bool test_lock_prof(void)
+{
+	MTY_LockProfileEnable(true);
+
+	MTY_Mutex *mutex = MTY_MutexCreateNamed("test-mutex");
+	MTY_Cond *cond = MTY_CondCreate();
+
+	// A timed out wait re-acquires the mutex without counting a new acquisition
+	MTY_MutexLock(mutex);
+	MTY_CondWait(cond, mutex, 1);
+	MTY_MutexUnlock(mutex);
+
+	char *report = MTY_LockProfileReport();
+	const char *row = strstr(report, "test-mutex");
+
+	long long acquired = 0;
+	bool parsed = row && sscanf(row + 10, "%lld", &acquired) == 1;
+	test_cmp("MTY_LockProfile", parsed && acquired == 1);
+	MTY_Free(report);
+
+	MTY_CondDestroy(&cond);
+	MTY_MutexDestroy(&mutex);
+
+	MTY_LockProfileEnable(false);
+
+	return true;
+}
+
+
 // fs
 
 #define TEST_FILE MTY_Path(".", "test.file")
@@ -105,11 +773,98 @@ static bool test_fs(void)
 	return true;
 }
 
+static bool test_file(void)
+{
+	// A small buffer so reads, writes, and seeks cross its edges
+	MTY_File *f = MTY_FileOpen(TEST_FILE, MTY_FILE_MODE_READ_WRITE, 16);
+	test_cmp("MTY_FileOpen", f);
+
+	const char *digits = "0123456789";
+	bool r = true;
+
+	for (uint32_t x = 0; x < 5; x++)
+		r = r && MTY_FileWrite(f, digits, 10);
+
+	// Larger than the buffer, written through
+	char big[50];
+	for (uint32_t x = 0; x < 50; x++)
+		big[x] = digits[x % 10];
+
+	r = r && MTY_FileWrite(f, big, 50);
+	test_cmp("MTY_FileWrite", r);
+
+	// Pending writes are flushed before seeking
+	int64_t end = MTY_FileSeek(f, 0, MTY_SEEK_END);
+	test_cmpi64("MTY_FileSeek", end == 100, end);
+
+	int64_t pos = MTY_FileSeek(f, 0, MTY_SEEK_SET);
+	test_cmp("MTY_FileSeek", pos == 0);
+
+	char buf[64] = {0};
+	size_t n = MTY_FileRead(f, buf, 5);
+	test_cmp("MTY_FileRead", n == 5 && !memcmp(buf, "01234", 5));
+
+	// A write after a read lands at the logical position, not past the read ahead
+	r = MTY_FileWrite(f, "ab", 2);
+	test_cmp("MTY_FileWrite", r);
+
+	n = MTY_FileRead(f, buf, 3);
+	test_cmp("MTY_FileRead", n == 3 && !memcmp(buf, "789", 3));
+
+	pos = MTY_FileSeek(f, -5, MTY_SEEK_CUR);
+	test_cmp("MTY_FileSeek", pos == 5);
+
+	n = MTY_FileRead(f, buf, 2);
+	test_cmp("MTY_FileRead", n == 2 && !memcmp(buf, "ab", 2));
+
+	// Positioned writes replace stale read ahead data
+	r = MTY_FileWriteAt(f, "YZ", 2, 7);
+	test_cmp("MTY_FileWriteAt", r);
+
+	n = MTY_FileRead(f, buf, 3);
+	test_cmp("MTY_FileRead", n == 3 && !memcmp(buf, "YZ9", 3));
+
+	// Positioned reads see buffered writes
+	r = MTY_FileWrite(f, "cd", 2);
+	test_cmp("MTY_FileWrite", r);
+
+	n = MTY_FileReadAt(f, buf, 4, 9);
+	test_cmp("MTY_FileReadAt", n == 4 && !memcmp(buf, "9cd2", 4));
+
+	n = MTY_FileRead(f, buf, 64);
+	test_cmp("MTY_FileRead", n == 64 && buf[0] == '2');
+
+	n = MTY_FileRead(f, buf, 64);
+	test_cmp("MTY_FileRead", n == 24);
+
+	MTY_FileClose(&f);
+	test_cmp("MTY_FileClose", !f);
+
+	f = MTY_FileOpen(TEST_FILE, MTY_FILE_MODE_APPEND, 16);
+	r = MTY_FileWriteText(f, "%s", "END");
+	MTY_FileClose(&f);
+	test_cmp("MTY_FileWriteText", r);
+
+	size_t size = 0;
+	char *data = MTY_ReadFile(TEST_FILE, &size);
+	bool tail = data && size == 103 && !memcmp(data + 100, "END", 3);
+	bool head = data && !memcmp(data, "01234abYZ9cd23", 14);
+	test_cmp("MTY_FileWriteText", tail && head);
+	MTY_Free(data);
+
+	MTY_DeleteFile(TEST_FILE);
+
+	return true;
+}
+
 
 // Main
 
 int32_t main(int32_t argc, char **argv)
 {
+	// Must come before anything allocates
+	MTY_AllocDebugEnable(true);
+
 	MTY_SetTimerResolution(1);
 
 	if (!test_time())
@@ -118,6 +873,42 @@ int32_t main(int32_t argc, char **argv)
 	if (!test_fs())
 		return 1;
 
+	if (!test_file())
+		return 1;
+
+	if (!test_timer())
+		return 1;
+
+	if (!test_arena())
+		return 1;
+
+	if (!test_pool())
+		return 1;
+
+	if (!test_buffer())
+		return 1;
+
+	if (!test_vec())
+		return 1;
+
+	if (!test_swap())
+		return 1;
+
+	if (!test_utf())
+		return 1;
+
+	if (!test_alloc_debug())
+		return 1;
+
+	if (!test_histogram())
+		return 1;
+
+	if (!test_log())
+		return 1;
+
+	if (!test_lock_prof())
+		return 1;
+
 	if (!test_aesgcm_performance())
 		return 1;
 
@@ -0,0 +1,13 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "matoya.h"
+
+// Runs on the calling thread as it exits, most recently registered first. Threads
+// not created by libmatoya are included, the main thread is not
+void thread_exit_hook(void (*func)(void *opaque), void *opaque);
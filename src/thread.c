@@ -4,12 +4,16 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
+#define _DEFAULT_SOURCE // syscall (mty-futex.h)
+
 #include "matoya.h"
 
 #include <string.h>
 
 #include "mty-rwlock.h"
 #include "mty-tls.h"
+#include "mty-futex.h"
+#include "lock-prof.h"
 
 struct MTY_Sync {
 	bool signal;
@@ -212,12 +216,14 @@ struct MTY_RWLock {
 	mty_rwlock rwlock;
 	MTY_Atomic32 yield;
 	uint8_t index;
+	struct lock_prof *prof;
 };
 
 static MTY_TLS struct rwlock_state {
 	uint16_t taken;
 	bool read;
 	bool write;
+	int64_t acquired;
 } RWLOCK_STATE[UINT8_MAX];
 
 static MTY_Atomic32 RWLOCK_INIT[UINT8_MAX];
@@ -233,26 +239,56 @@ static uint8_t rwlock_index(void)
 	return 0;
 }
 
-MTY_RWLock *MTY_RWLockCreate(void)
+MTY_RWLock *MTY_RWLockCreateNamed(const char *name)
 {
 	MTY_RWLock *ctx = MTY_Alloc(1, sizeof(MTY_RWLock));
 	ctx->index = rwlock_index();
+	ctx->prof = lock_prof_get(name);
 
 	mty_rwlock_create(&ctx->rwlock);
 
 	return ctx;
 }
 
+MTY_RWLock *MTY_RWLockCreate(void)
+{
+	return MTY_RWLockCreateNamed(NULL);
+}
+
+static void rwlock_released(MTY_RWLock *ctx, struct rwlock_state *rw)
+{
+	if (rw->acquired != 0) {
+		lock_prof_released(ctx->prof, rw->acquired);
+		rw->acquired = 0;
+	}
+}
+
 void MTY_RWLockReader(MTY_RWLock *ctx)
 {
 	struct rwlock_state *rw = &RWLOCK_STATE[ctx->index];
 
 	if (rw->taken == 0) {
+		bool active = lock_prof_active(ctx->prof);
+		int64_t begin = active ? MTY_Timestamp() : 0;
+		bool contended = false;
+
 		// Ensure that readers will yield to writers in a tight loop
-		while (MTY_Atomic32Get(&ctx->yield) > 0)
+		while (MTY_Atomic32Get(&ctx->yield) > 0) {
 			MTY_Sleep(0);
+			contended = true;
+		}
+
+		if (!active) {
+			mty_rwlock_reader(&ctx->rwlock);
+
+		} else if (!mty_rwlock_try_reader(&ctx->rwlock)) {
+			mty_rwlock_reader(&ctx->rwlock);
+			contended = true;
+		}
+
+		if (active)
+			rw->acquired = lock_prof_acquired(ctx->prof, contended, begin);
 
-		mty_rwlock_reader(&ctx->rwlock);
 		rw->read = true;
 	}
 
@@ -265,15 +301,32 @@ void MTY_RWLockWriter(MTY_RWLock *ctx)
 	struct rwlock_state *rw = &RWLOCK_STATE[ctx->index];
 
 	if (rw->read) {
+		rwlock_released(ctx, rw);
 		mty_rwlock_unlock_reader(&ctx->rwlock);
 		rw->read = false;
 		relock = true;
 	}
 
 	if (rw->taken == 0 || relock) {
+		bool active = lock_prof_active(ctx->prof);
+		int64_t begin = active ? MTY_Timestamp() : 0;
+		bool contended = false;
+
 		MTY_Atomic32Add(&ctx->yield, 1);
-		mty_rwlock_writer(&ctx->rwlock);
+
+		if (!active) {
+			mty_rwlock_writer(&ctx->rwlock);
+
+		} else if (!mty_rwlock_try_writer(&ctx->rwlock)) {
+			mty_rwlock_writer(&ctx->rwlock);
+			contended = true;
+		}
+
 		MTY_Atomic32Add(&ctx->yield, -1);
+
+		if (active)
+			rw->acquired = lock_prof_acquired(ctx->prof, contended, begin);
+
 		rw->write = true;
 	}
 
@@ -285,6 +338,8 @@ void MTY_RWLockUnlock(MTY_RWLock *ctx)
 	struct rwlock_state *rw = &RWLOCK_STATE[ctx->index];
 
 	if (--rw->taken == 0) {
+		rwlock_released(ctx, rw);
+
 		if (rw->read) {
 			mty_rwlock_unlock_reader(&ctx->rwlock);
 			rw->read = false;
@@ -312,37 +367,79 @@ void MTY_RWLockDestroy(MTY_RWLock **rwlock)
 }
 
 
+// Once
+
+enum {
+	ONCE_INIT    = 0,
+	ONCE_RUNNING = 1,
+	ONCE_DONE    = 2,
+};
+
+void MTY_Once(MTY_Atomic32 *once, void (*func)(void *opaque), const void *opaque)
+{
+	if (MTY_Atomic32Get(once) == ONCE_DONE)
+		return;
+
+	if (MTY_Atomic32CAS(once, ONCE_INIT, ONCE_RUNNING)) {
+		func((void *) opaque);
+
+		MTY_Atomic32Set(once, ONCE_DONE);
+		mty_futex_wake(once, true);
+		return;
+	}
+
+	while (MTY_Atomic32Get(once) == ONCE_RUNNING)
+		mty_futex_wait(once, ONCE_RUNNING);
+}
+
+
 // Global locks
 
-static MTY_Atomic32 THREAD_GINDEX = {1};
-static mty_rwlock THREAD_GLOCKS[UINT8_MAX];
+// The lock state lives entirely in the caller's atomic, 0 is unlocked, 1 is locked
+// with no waiters, and 2 is locked with possible waiters. Unlock only needs to
+// enter the kernel when it sees the lock was contended
+
+enum {
+	GLOCK_UNLOCKED  = 0,
+	GLOCK_LOCKED    = 1,
+	GLOCK_CONTENDED = 2,
+};
+
+#define GLOCK_SPIN 100
 
 void MTY_GlobalLock(MTY_Atomic32 *lock)
 {
-	entry: {
-		uint32_t index = MTY_Atomic32Get(lock);
-
-		// 0 means uninitialized, 1 means currently initializing
-		if (index < 2) {
-			if (MTY_Atomic32CAS(lock, 0, 1)) {
-				index = MTY_Atomic32Add(&THREAD_GINDEX, 1);
-				if (index >= UINT8_MAX)
-					MTY_Fatal("Global lock index of %u exceeded", UINT8_MAX);
-
-				mty_rwlock_create(&THREAD_GLOCKS[index]);
-				MTY_Atomic32Set(lock, index);
-
-			} else {
-				MTY_Sleep(0);
-				goto entry;
-			}
+	if (MTY_Atomic32CAS(lock, GLOCK_UNLOCKED, GLOCK_LOCKED))
+		return;
+
+	// Short critical sections are often released before it is worth sleeping
+	for (uint32_t x = 0; x < GLOCK_SPIN; x++)
+		if (MTY_Atomic32Get(lock) == GLOCK_UNLOCKED && MTY_Atomic32CAS(lock, GLOCK_UNLOCKED, GLOCK_LOCKED))
+			return;
+
+	while (true) {
+		int32_t state = MTY_Atomic32Get(lock);
+
+		// Once a thread has waited it can't know if others are still waiting, so it
+		// takes the lock as contended to guarantee the next unlock wakes someone
+		if (state == GLOCK_UNLOCKED) {
+			if (MTY_Atomic32CAS(lock, GLOCK_UNLOCKED, GLOCK_CONTENDED))
+				return;
+
+			continue;
 		}
 
-		mty_rwlock_writer(&THREAD_GLOCKS[index]);
+		if (state == GLOCK_LOCKED && !MTY_Atomic32CAS(lock, GLOCK_LOCKED, GLOCK_CONTENDED))
+			continue;
+
+		mty_futex_wait(lock, GLOCK_CONTENDED);
 	}
 }
 
 void MTY_GlobalUnlock(MTY_Atomic32 *lock)
 {
-	mty_rwlock_unlock_writer(&THREAD_GLOCKS[MTY_Atomic32Get(lock)]);
+	if (MTY_Atomic32Add(lock, -1) != GLOCK_UNLOCKED) {
+		MTY_Atomic32Set(lock, GLOCK_UNLOCKED);
+		mty_futex_wake(lock, false);
+	}
 }
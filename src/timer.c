@@ -0,0 +1,485 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "matoya.h"
+
+#include <string.h>
+#include <math.h>
+
+#define TIMER_LEVELS     5
+#define TIMER_SLOT_BITS  6
+#define TIMER_SLOTS      (1 << TIMER_SLOT_BITS)
+#define TIMER_SLOT_MASK  (TIMER_SLOTS - 1)
+#define TIMER_MAX_TICKS  ((1ull << (TIMER_LEVELS * TIMER_SLOT_BITS)) - 1)
+
+#define TIMER_INDEX_BITS 20
+#define TIMER_INDEX_MASK ((1u << TIMER_INDEX_BITS) - 1)
+#define TIMER_NULL       UINT32_MAX
+
+#define TIMER_TASKS      1024
+
+struct timer_node {
+	uint32_t id;
+	uint32_t prev;
+	uint32_t next;
+	uint8_t level;
+	uint8_t slot;
+
+	uint64_t expires;
+	uint64_t interval;
+	void (*func)(void *opaque);
+	void *opaque;
+};
+
+struct timer_task {
+	void (*func)(void *opaque);
+	void *opaque;
+};
+
+struct MTY_TimerWheel {
+	uint32_t resolution;
+
+	MTY_Thread *thread;
+	MTY_Mutex *mutex;
+	MTY_Cond *cond;
+	bool running;
+
+	MTY_Thread **workers;
+	uint32_t num_workers;
+	MTY_Mutex *task_mutex;
+	MTY_Cond *task_cond;
+	struct timer_task tasks[TIMER_TASKS];
+	uint32_t task_pos;
+	uint32_t task_len;
+
+	int64_t ts;
+	float remainder;
+	uint64_t now;
+	uint64_t target;
+
+	uint32_t heads[TIMER_LEVELS][TIMER_SLOTS];
+	uint64_t occupied[TIMER_LEVELS];
+
+	struct timer_node *nodes;
+	uint32_t num_nodes;
+	uint32_t free_list;
+	uint32_t generation;
+};
+
+
+// Wheel
+
+static void timer_link(MTY_TimerWheel *ctx, uint32_t index)
+{
+	struct timer_node *n = &ctx->nodes[index];
+
+	uint64_t delta = n->expires - ctx->now;
+	if (delta > TIMER_MAX_TICKS) {
+		delta = TIMER_MAX_TICKS;
+		n->expires = ctx->now + delta;
+	}
+
+	// The level is the first whose span covers the remaining ticks, the slot
+	// is taken from the absolute expiry so cascading lands it correctly
+	uint8_t level = 0;
+	while (level < TIMER_LEVELS - 1 && delta >= (1ull << ((level + 1) * TIMER_SLOT_BITS)))
+		level++;
+
+	uint8_t slot = (n->expires >> (level * TIMER_SLOT_BITS)) & TIMER_SLOT_MASK;
+
+	n->level = level;
+	n->slot = slot;
+	n->prev = TIMER_NULL;
+	n->next = ctx->heads[level][slot];
+
+	if (n->next != TIMER_NULL)
+		ctx->nodes[n->next].prev = index;
+
+	ctx->heads[level][slot] = index;
+	ctx->occupied[level] |= 1ull << slot;
+}
+
+static void timer_unlink(MTY_TimerWheel *ctx, uint32_t index)
+{
+	struct timer_node *n = &ctx->nodes[index];
+
+	if (n->prev != TIMER_NULL) {
+		ctx->nodes[n->prev].next = n->next;
+
+	} else {
+		ctx->heads[n->level][n->slot] = n->next;
+	}
+
+	if (n->next != TIMER_NULL)
+		ctx->nodes[n->next].prev = n->prev;
+
+	if (ctx->heads[n->level][n->slot] == TIMER_NULL)
+		ctx->occupied[n->level] &= ~(1ull << n->slot);
+}
+
+static uint32_t timer_alloc(MTY_TimerWheel *ctx)
+{
+	if (ctx->free_list == TIMER_NULL) {
+		uint32_t len = ctx->num_nodes == 0 ? 64 : ctx->num_nodes * 2;
+
+		if (len > TIMER_INDEX_MASK + 1) {
+			if (ctx->num_nodes == TIMER_INDEX_MASK + 1)
+				return TIMER_NULL;
+
+			len = TIMER_INDEX_MASK + 1;
+		}
+
+		ctx->nodes = MTY_Realloc(ctx->nodes, len, sizeof(struct timer_node));
+
+		for (uint32_t x = len; x > ctx->num_nodes; x--) {
+			struct timer_node *n = &ctx->nodes[x - 1];
+			memset(n, 0, sizeof(struct timer_node));
+			n->next = ctx->free_list;
+			ctx->free_list = x - 1;
+		}
+
+		ctx->num_nodes = len;
+	}
+
+	uint32_t index = ctx->free_list;
+	ctx->free_list = ctx->nodes[index].next;
+
+	// The generation keeps stale ids from cancelling a reused node, and is never 0
+	// so that an id of 0 can be used as an error
+	if (++ctx->generation > UINT32_MAX >> TIMER_INDEX_BITS)
+		ctx->generation = 1;
+
+	ctx->nodes[index].id = (ctx->generation << TIMER_INDEX_BITS) | index;
+
+	return index;
+}
+
+static void timer_free(MTY_TimerWheel *ctx, uint32_t index)
+{
+	struct timer_node *n = &ctx->nodes[index];
+	memset(n, 0, sizeof(struct timer_node));
+
+	n->next = ctx->free_list;
+	ctx->free_list = index;
+}
+
+static void timer_cascade(MTY_TimerWheel *ctx, uint8_t level)
+{
+	uint8_t slot = (ctx->now >> (level * TIMER_SLOT_BITS)) & TIMER_SLOT_MASK;
+
+	uint32_t index = ctx->heads[level][slot];
+	ctx->heads[level][slot] = TIMER_NULL;
+	ctx->occupied[level] &= ~(1ull << slot);
+
+	while (index != TIMER_NULL) {
+		uint32_t next = ctx->nodes[index].next;
+		timer_link(ctx, index);
+		index = next;
+	}
+}
+
+static bool timer_empty(MTY_TimerWheel *ctx)
+{
+	for (uint8_t x = 0; x < TIMER_LEVELS; x++)
+		if (ctx->occupied[x])
+			return false;
+
+	return true;
+}
+
+static uint64_t timer_next_event(MTY_TimerWheel *ctx)
+{
+	// Ticks until either the next occupied slot in the first level or the next
+	// cascade, whichever is sooner. Between them there is nothing to do
+	uint8_t pos = ctx->now & TIMER_SLOT_MASK;
+	uint64_t wrap = TIMER_SLOTS - pos;
+
+	uint64_t rot = ctx->occupied[0] >> pos;
+	if (pos > 0)
+		rot |= ctx->occupied[0] << (TIMER_SLOTS - pos);
+
+	// Start at 1 since the current slot has already been run
+	uint64_t next = wrap;
+
+	for (uint8_t x = 1; x < TIMER_SLOTS; x++) {
+		if (rot & (1ull << x)) {
+			next = x;
+			break;
+		}
+	}
+
+	for (uint8_t x = 1; x < TIMER_LEVELS; x++)
+		if (ctx->occupied[x])
+			return MTY_MIN(next, wrap);
+
+	return next;
+}
+
+
+// Dispatch
+
+static void *timer_worker(void *opaque)
+{
+	MTY_TimerWheel *ctx = opaque;
+
+	MTY_MutexLock(ctx->task_mutex);
+
+	while (true) {
+		while (ctx->running && ctx->task_len == 0)
+			MTY_CondWait(ctx->task_cond, ctx->task_mutex, -1);
+
+		if (ctx->task_len == 0)
+			break;
+
+		struct timer_task task = ctx->tasks[ctx->task_pos];
+		ctx->task_pos = (ctx->task_pos + 1) % TIMER_TASKS;
+		ctx->task_len--;
+
+		MTY_MutexUnlock(ctx->task_mutex);
+		task.func(task.opaque);
+		MTY_MutexLock(ctx->task_mutex);
+	}
+
+	MTY_MutexUnlock(ctx->task_mutex);
+
+	return NULL;
+}
+
+static void timer_dispatch(MTY_TimerWheel *ctx, void (*func)(void *opaque), void *opaque)
+{
+	if (ctx->num_workers > 0) {
+		MTY_MutexLock(ctx->task_mutex);
+
+		bool queued = ctx->task_len < TIMER_TASKS;
+
+		if (queued) {
+			struct timer_task *task = &ctx->tasks[(ctx->task_pos + ctx->task_len) % TIMER_TASKS];
+			task->func = func;
+			task->opaque = opaque;
+			ctx->task_len++;
+
+			MTY_CondWake(ctx->task_cond);
+		}
+
+		MTY_MutexUnlock(ctx->task_mutex);
+
+		if (queued)
+			return;
+	}
+
+	// No workers, or the workers are too far behind
+	func(opaque);
+}
+
+static void timer_run_slot(MTY_TimerWheel *ctx)
+{
+	uint8_t slot = ctx->now & TIMER_SLOT_MASK;
+
+	while (ctx->heads[0][slot] != TIMER_NULL) {
+		uint32_t index = ctx->heads[0][slot];
+		struct timer_node *n = &ctx->nodes[index];
+
+		void (*func)(void *opaque) = n->func;
+		void *opaque = n->opaque;
+
+		timer_unlink(ctx, index);
+
+		if (n->interval > 0) {
+			// Re-arm from the scheduled time so lag doesn't accumulate, periods the
+			// wheel has already fallen behind on are skipped rather than run back to back
+			n->expires += n->interval;
+
+			if (n->expires <= ctx->target)
+				n->expires += ((ctx->target - n->expires) / n->interval + 1) * n->interval;
+
+			timer_link(ctx, index);
+
+		} else {
+			timer_free(ctx, index);
+		}
+
+		MTY_MutexUnlock(ctx->mutex);
+		timer_dispatch(ctx, func, opaque);
+		MTY_MutexLock(ctx->mutex);
+	}
+}
+
+static void timer_advance(MTY_TimerWheel *ctx)
+{
+	int64_t ts = MTY_Timestamp();
+	ctx->remainder += MTY_TimeDiff(ctx->ts, ts);
+	ctx->ts = ts;
+
+	uint64_t ticks = (uint64_t) (ctx->remainder / ctx->resolution);
+	ctx->remainder -= (float) ticks * ctx->resolution;
+
+	// The lock is released while dispatching, so the target is kept in the context
+	// for MTY_TimerWheelAdd to measure from
+	ctx->target += ticks;
+
+	while (ctx->now < ctx->target) {
+		if (timer_empty(ctx)) {
+			ctx->now = ctx->target;
+			break;
+		}
+
+		ctx->now++;
+
+		for (uint8_t x = 1; x < TIMER_LEVELS; x++) {
+			if (ctx->now & ((1ull << (x * TIMER_SLOT_BITS)) - 1))
+				break;
+
+			timer_cascade(ctx, x);
+		}
+
+		timer_run_slot(ctx);
+	}
+}
+
+static void *timer_thread(void *opaque)
+{
+	MTY_TimerWheel *ctx = opaque;
+
+	MTY_MutexLock(ctx->mutex);
+
+	while (ctx->running) {
+		timer_advance(ctx);
+
+		int32_t timeout = -1;
+
+		// Rounded up and at least 1 ms, waking early would only find nothing to run and
+		// spin on the sub-millisecond remainder
+		if (!timer_empty(ctx)) {
+			uint64_t ticks = timer_next_event(ctx);
+			double ms = ceil((double) (ticks * ctx->resolution) - ctx->remainder);
+
+			timeout = ms < 1.0 ? 1 : ms > (double) INT32_MAX ? INT32_MAX : (int32_t) ms;
+		}
+
+		MTY_CondWait(ctx->cond, ctx->mutex, timeout);
+	}
+
+	MTY_MutexUnlock(ctx->mutex);
+
+	return NULL;
+}
+
+
+// Public
+
+MTY_TimerWheel *MTY_TimerWheelCreate(uint32_t resolution, uint32_t workers)
+{
+	MTY_TimerWheel *ctx = MTY_Alloc(1, sizeof(MTY_TimerWheel));
+	ctx->resolution = resolution > 0 ? resolution : 1;
+	ctx->free_list = TIMER_NULL;
+	ctx->running = true;
+	ctx->ts = MTY_Timestamp();
+
+	memset(ctx->heads, 0xFF, sizeof(ctx->heads));
+
+	ctx->mutex = MTY_MutexCreateNamed("MTY_TimerWheel");
+	ctx->cond = MTY_CondCreate();
+
+	ctx->task_mutex = MTY_MutexCreateNamed("MTY_TimerWheel tasks");
+	ctx->task_cond = MTY_CondCreate();
+	ctx->num_workers = workers;
+	ctx->workers = MTY_Alloc(workers > 0 ? workers : 1, sizeof(MTY_Thread *));
+
+	for (uint32_t x = 0; x < workers; x++)
+		ctx->workers[x] = MTY_ThreadCreate(timer_worker, ctx);
+
+	ctx->thread = MTY_ThreadCreate(timer_thread, ctx);
+
+	return ctx;
+}
+
+uint32_t MTY_TimerWheelAdd(MTY_TimerWheel *ctx, uint32_t timeout, uint32_t interval,
+	void (*func)(void *opaque), const void *opaque)
+{
+	MTY_MutexLock(ctx->mutex);
+
+	// The wheel only advances on its own thread and may lag behind the clock,
+	// so the delay is measured from the current time rather than the wheel position.
+	// Rounding the lag and timeout up together keeps timers from firing early
+	double lag = ctx->remainder + MTY_TimeDiff(ctx->ts, MTY_Timestamp());
+	uint64_t delay = (uint64_t) ceil((lag + timeout) / ctx->resolution);
+
+	uint32_t id = 0;
+	uint32_t index = timer_alloc(ctx);
+
+	if (index != TIMER_NULL) {
+		struct timer_node *n = &ctx->nodes[index];
+		n->func = func;
+		n->opaque = (void *) opaque;
+		n->interval = interval > 0 ? MTY_MAX(interval / ctx->resolution, 1) : 0;
+		n->expires = ctx->target + MTY_MAX(delay, 1);
+
+		timer_link(ctx, index);
+		id = n->id;
+
+		MTY_CondWake(ctx->cond);
+
+	} else {
+		MTY_Log("Maximum number of timers reached");
+	}
+
+	MTY_MutexUnlock(ctx->mutex);
+
+	return id;
+}
+
+bool MTY_TimerWheelCancel(MTY_TimerWheel *ctx, uint32_t id)
+{
+	bool r = false;
+	uint32_t index = id & TIMER_INDEX_MASK;
+
+	MTY_MutexLock(ctx->mutex);
+
+	if (id != 0 && index < ctx->num_nodes && ctx->nodes[index].id == id) {
+		timer_unlink(ctx, index);
+		timer_free(ctx, index);
+		r = true;
+	}
+
+	MTY_MutexUnlock(ctx->mutex);
+
+	return r;
+}
+
+void MTY_TimerWheelDestroy(MTY_TimerWheel **wheel)
+{
+	if (!wheel || !*wheel)
+		return;
+
+	MTY_TimerWheel *ctx = *wheel;
+
+	MTY_MutexLock(ctx->mutex);
+	ctx->running = false;
+	MTY_CondWake(ctx->cond);
+	MTY_MutexUnlock(ctx->mutex);
+
+	MTY_ThreadDestroy(&ctx->thread);
+
+	// Workers finish whatever was already queued before exiting
+	MTY_MutexLock(ctx->task_mutex);
+	MTY_CondWakeAll(ctx->task_cond);
+	MTY_MutexUnlock(ctx->task_mutex);
+
+	for (uint32_t x = 0; x < ctx->num_workers; x++)
+		MTY_ThreadDestroy(&ctx->workers[x]);
+
+	MTY_Free(ctx->workers);
+	MTY_CondDestroy(&ctx->task_cond);
+	MTY_MutexDestroy(&ctx->task_mutex);
+
+	MTY_CondDestroy(&ctx->cond);
+	MTY_MutexDestroy(&ctx->mutex);
+
+	MTY_Free(ctx->nodes);
+
+	MTY_Free(ctx);
+	*wheel = NULL;
+}
@@ -7,6 +7,7 @@
 #include "matoya.h"
 
 #include "crypto-dl.h"
+#include "metrics.h"
 
 struct MTY_AESGCM {
 	EVP_CIPHER_CTX *enc;
@@ -59,7 +60,7 @@ MTY_AESGCM *MTY_AESGCMCreate(const void *key)
 	return ctx;
 }
 
-bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
+static bool aes_gcm_encrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
 	void *hash, void *cipherText)
 {
 	int32_t e = EVP_CipherInit_ex(ctx->enc, NULL, NULL, NULL, nonce, 1);
@@ -90,6 +91,21 @@ bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText
 	return true;
 }
 
+bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
+	void *hash, void *cipherText)
+{
+	MTY_ProfileBegin("MTY_AESGCMEncrypt");
+
+	bool r = aes_gcm_encrypt(ctx, nonce, plainText, size, hash, cipherText);
+
+	MTY_ProfileEnd();
+
+	if (r)
+		metrics_encrypted(size);
+
+	return r;
+}
+
 bool MTY_AESGCMDecrypt(MTY_AESGCM *ctx, const void *nonce, const void *cipherText, size_t size,
 	const void *hash, void *plainText)
 {
@@ -10,6 +10,8 @@
 
 #include "CommonCryptorSPI.h"
 
+#include "metrics.h"
+
 struct MTY_AESGCM {
 	CCCryptorRef dec;
 	CCCryptorRef enc;
@@ -41,7 +43,7 @@ MTY_AESGCM *MTY_AESGCMCreate(const void *key)
 	return ctx;
 }
 
-bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
+static bool aes_gcm_encrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
 	void *hash, void *cipherText)
 {
 	CCCryptorStatus e = CCCryptorGCMReset(ctx->enc);
@@ -72,6 +74,21 @@ bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText
 	return true;
 }
 
+bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText, size_t size,
+	void *hash, void *cipherText)
+{
+	MTY_ProfileBegin("MTY_AESGCMEncrypt");
+
+	bool r = aes_gcm_encrypt(ctx, nonce, plainText, size, hash, cipherText);
+
+	MTY_ProfileEnd();
+
+	if (r)
+		metrics_encrypted(size);
+
+	return r;
+}
+
 bool MTY_AESGCMDecrypt(MTY_AESGCM *ctx, const void *nonce, const void *cipherText, size_t size,
 	const void *hash, void *plainText)
 {
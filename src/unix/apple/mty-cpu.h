@@ -0,0 +1,42 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <sys/types.h>
+#include <sys/sysctl.h>
+
+static uint64_t cpu_sysctl(const char *name)
+{
+	// Values may be 32 or 64 bits, the buffer is zeroed so either fits
+	uint64_t v = 0;
+	size_t size = sizeof(uint64_t);
+
+	if (sysctlbyname(name, &v, &size, NULL, 0) != 0)
+		return 0;
+
+	return v;
+}
+
+static void mty_cpu_topology(MTY_CPUTopology *topo)
+{
+	topo->packages = (uint32_t) cpu_sysctl("hw.packages");
+	topo->cores = (uint32_t) cpu_sysctl("hw.physicalcpu");
+	topo->threads = (uint32_t) cpu_sysctl("hw.logicalcpu");
+	topo->cacheLine = (uint32_t) cpu_sysctl("hw.cachelinesize");
+	topo->cacheL1 = (uint32_t) cpu_sysctl("hw.l1dcachesize");
+	topo->cacheL2 = (uint32_t) cpu_sysctl("hw.l2cachesize");
+	topo->cacheL3 = (uint32_t) cpu_sysctl("hw.l3cachesize");
+
+	if (topo->cores == 0 || topo->threads == 0)
+		return;
+
+	// XNU numbers SMT siblings adjacently
+	uint32_t step = topo->threads / topo->cores;
+
+	for (uint32_t x = 0; x < topo->threads && x < 64; x += step)
+		topo->coreMask |= (uint64_t) 1 << x;
+}
@@ -0,0 +1,39 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <errno.h>
+
+// There is no public address wait before macOS 14.4 / iOS 17.4, the ulock calls
+// are what libc++ uses for std::atomic::wait on every Apple platform
+
+#define UL_COMPARE_AND_WAIT 1
+#define ULF_WAKE_ALL        0x00000100
+#define ULF_NO_ERRNO        0x01000000
+
+int __ulock_wait(uint32_t operation, void *addr, uint64_t value, uint32_t timeout);
+int __ulock_wake(uint32_t operation, void *addr, uint64_t wake_value);
+
+static void mty_futex_wait(MTY_Atomic32 *addr, int32_t value)
+{
+	int32_t e = __ulock_wait(UL_COMPARE_AND_WAIT | ULF_NO_ERRNO, (void *) &addr->value, (uint32_t) value, 0);
+
+	// Negative errors, EFAULT can be returned spuriously and is treated like EINTR
+	if (e < 0 && -e != EINTR && -e != EFAULT)
+		MTY_Fatal("'__ulock_wait' failed with error %d", -e);
+}
+
+static void mty_futex_wake(MTY_Atomic32 *addr, bool all)
+{
+	uint32_t op = UL_COMPARE_AND_WAIT | ULF_NO_ERRNO | (all ? ULF_WAKE_ALL : 0);
+
+	int32_t e = __ulock_wake(op, (void *) &addr->value, 0);
+
+	// ENOENT means there were no waiters
+	if (e < 0 && -e != ENOENT && -e != EINTR)
+		MTY_Fatal("'__ulock_wake' failed with error %d", -e);
+}
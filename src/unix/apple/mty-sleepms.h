@@ -4,4 +4,32 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
-#include "../linux/mty-sleepms.h"
+#pragma once
+
+#include <time.h>
+#include <errno.h>
+
+static void mty_sleep_ms(uint32_t timeout)
+{
+	struct timespec ts = {0};
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000 * 1000;
+
+	if (nanosleep(&ts, NULL) != 0)
+		MTY_Log("'nanosleep' failed with errno %d", errno);
+}
+
+static void mty_sleep_us(uint64_t us)
+{
+	// No clock_nanosleep, the remainder is carried across interruptions instead
+	struct timespec ts = {0};
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000;
+
+	while (nanosleep(&ts, &ts) != 0) {
+		if (errno != EINTR) {
+			MTY_Log("'nanosleep' failed with errno %d", errno);
+			break;
+		}
+	}
+}
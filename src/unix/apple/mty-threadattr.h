@@ -0,0 +1,37 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <pthread.h>
+#include <pthread/qos.h>
+
+static void mty_thread_set_name(const char *name)
+{
+	int32_t e = pthread_setname_np(name);
+	if (e != 0)
+		MTY_Log("'pthread_setname_np' failed with error %d", e);
+}
+
+static void mty_thread_set_affinity(uint64_t mask)
+{
+	// Apple platforms do not support hard processor affinity
+}
+
+static void mty_thread_set_priority(MTY_ThreadPriority priority)
+{
+	qos_class_t qos = QOS_CLASS_DEFAULT;
+
+	switch (priority) {
+		case MTY_THREAD_PRIORITY_LOW:      qos = QOS_CLASS_UTILITY;          break;
+		case MTY_THREAD_PRIORITY_HIGH:     qos = QOS_CLASS_USER_INITIATED;   break;
+		case MTY_THREAD_PRIORITY_REALTIME: qos = QOS_CLASS_USER_INTERACTIVE; break;
+	}
+
+	int32_t e = pthread_set_qos_class_self_np(qos, 0);
+	if (e != 0)
+		MTY_Log("'pthread_set_qos_class_self_np' failed with error %d", e);
+}
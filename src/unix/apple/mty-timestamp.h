@@ -20,5 +20,11 @@ static float mty_frequency(void)
 	if (e != KERN_SUCCESS)
 		MTY_Fatal("'mach_timebase_info' failed with error %d", e);
 
-	return timebase.numer / timebase.denom / 1000000.0f;
+	return (float) timebase.numer / (float) timebase.denom / 1000000.0f;
+}
+
+static int64_t mty_timestamp_fast(void)
+{
+	// mach_absolute_time is already a user space counter read
+	return mach_absolute_time();
 }
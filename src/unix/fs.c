@@ -6,6 +6,7 @@
 
 #define _DEFAULT_SOURCE  // DT_DIR
 #define _DARWIN_C_SOURCE // flock, DT_DIR
+#define _FILE_OFFSET_BITS 64 // 64-bit st_size and mmap offsets on 32-bit targets
 
 #include "matoya.h"
 
@@ -19,6 +20,7 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <dirent.h>
 
 #include "mty-fs.h"
@@ -166,7 +168,8 @@ MTY_LockFile *MTY_LockFileCreate(const char *path, MTY_FileMode mode)
 	int32_t open_flags = 0;
 	int32_t flock_flags = LOCK_SH;
 
-	if (mode == MTY_FILE_MODE_WRITE) {
+	// Any mode that writes takes the lock exclusively
+	if (mode == MTY_FILE_MODE_WRITE || mode == MTY_FILE_MODE_APPEND || mode == MTY_FILE_MODE_READ_WRITE) {
 		open_flags = O_CREAT;
 		flock_flags = LOCK_EX;
 	}
@@ -207,6 +210,68 @@ void MTY_LockFileDestroy(MTY_LockFile **lock)
 	*lock = NULL;
 }
 
+void *MTY_MapFile(const char *path, MTY_MapFlag flags, size_t *size)
+{
+	size_t tmp = 0;
+	if (!size)
+		size = &tmp;
+
+	*size = 0;
+
+	bool rw = flags & MTY_MAP_READ_WRITE;
+
+	int32_t f = open(path, rw ? O_RDWR : O_RDONLY);
+	if (f == -1) {
+		MTY_Log("'open' failed to open '%s' with errno %d", MTY_GetFileName(path, true), errno);
+		return NULL;
+	}
+
+	void *mem = NULL;
+
+	struct stat st;
+	if (fstat(f, &st) != 0) {
+		MTY_Log("'fstat' failed with errno %d", errno);
+		goto except;
+	}
+
+	if (st.st_size == 0)
+		goto except;
+
+	mem = mmap(NULL, st.st_size, PROT_READ | (rw ? PROT_WRITE : 0), MAP_SHARED, f, 0);
+
+	if (mem == MAP_FAILED) {
+		MTY_Log("'mmap' failed with errno %d", errno);
+		mem = NULL;
+		goto except;
+	}
+
+	*size = st.st_size;
+
+	// Sequential doubles readahead and drops pages behind the cursor, random disables readahead
+	int32_t advice = (flags & MTY_MAP_SEQUENTIAL) ? MADV_SEQUENTIAL :
+		(flags & MTY_MAP_RANDOM) ? MADV_RANDOM : MADV_NORMAL;
+
+	if (advice != MADV_NORMAL && madvise(mem, *size, advice) != 0)
+		MTY_Log("'madvise' failed with errno %d", errno);
+
+	except:
+
+	// The mapping holds its own reference to the file
+	if (close(f) != 0)
+		MTY_Log("'close' failed with errno %d", errno);
+
+	return mem;
+}
+
+void MTY_UnmapFile(void *mem, size_t size)
+{
+	if (!mem)
+		return;
+
+	if (munmap(mem, size) != 0)
+		MTY_Log("'munmap' failed with errno %d", errno);
+}
+
 const char *MTY_GetFileName(const char *path, bool extension)
 {
 	const char *name = strrchr(path, '/');
@@ -248,6 +313,7 @@ static int32_t fs_file_compare(const void *p1, const void *p2)
 MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 {
 	MTY_FileList *fl = MTY_Alloc(1, sizeof(MTY_FileList));
+	MTY_Vec *files = MTY_VecCreate(sizeof(MTY_FileDesc), 0);
 	char *pathd = MTY_Strdup(path);
 
 	bool ok = false;
@@ -264,12 +330,10 @@ MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 		bool is_dir = ent->d_type == DT_DIR;
 
 		if (is_dir || strstr(name, filter ? filter : "")) {
-			fl->files = MTY_Realloc(fl->files, fl->len + 1, sizeof(MTY_FileDesc));
-
-			fl->files[fl->len].dir = is_dir;
-			fl->files[fl->len].name = MTY_Strdup(name);
-			fl->files[fl->len].path = MTY_Strdup(MTY_Path(pathd, name));
-			fl->len++;
+			MTY_FileDesc *desc = MTY_VecPush(files);
+			desc->dir = is_dir;
+			desc->name = MTY_Strdup(name);
+			desc->path = MTY_Strdup(MTY_Path(pathd, name));
 		}
 
 		ent = readdir(dir);
@@ -281,6 +345,10 @@ MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 
 	MTY_Free(pathd);
 
+	size_t len = 0;
+	fl->files = MTY_VecDetach(&files, &len);
+	fl->len = (uint32_t) len;
+
 	if (fl->len > 0)
 		MTY_Sort(fl->files, fl->len, sizeof(MTY_FileDesc), fs_file_compare);
 
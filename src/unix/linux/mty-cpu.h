@@ -0,0 +1,178 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+static bool cpu_read_sysfs(const char *path, char *buf, size_t size)
+{
+	FILE *f = fopen(path, "r");
+	if (!f)
+		return false;
+
+	bool r = fgets(buf, (int32_t) size, f) != NULL;
+	fclose(f);
+
+	return r;
+}
+
+static uint32_t cpu_read_uint(const char *path)
+{
+	char buf[32];
+	if (!cpu_read_sysfs(path, buf, 32))
+		return 0;
+
+	char *end = NULL;
+	uint32_t v = strtoul(buf, &end, 10);
+
+	// Cache sizes are reported like "32K"
+	if (end && *end == 'K') {
+		v *= 1024;
+
+	} else if (end && *end == 'M') {
+		v *= 1024 * 1024;
+	}
+
+	return v;
+}
+
+static void cpu_read_caches(MTY_CPUTopology *topo)
+{
+	char path[128];
+	char type[32];
+
+	for (uint32_t x = 0; x < 8; x++) {
+		snprintf(path, 128, "/sys/devices/system/cpu/cpu0/cache/index%u/type", x);
+		if (!cpu_read_sysfs(path, type, 32))
+			break;
+
+		if (!strncmp(type, "Instruction", 11))
+			continue;
+
+		snprintf(path, 128, "/sys/devices/system/cpu/cpu0/cache/index%u/level", x);
+		uint32_t level = cpu_read_uint(path);
+
+		snprintf(path, 128, "/sys/devices/system/cpu/cpu0/cache/index%u/size", x);
+		uint32_t size = cpu_read_uint(path);
+
+		snprintf(path, 128, "/sys/devices/system/cpu/cpu0/cache/index%u/coherency_line_size", x);
+		uint32_t line = cpu_read_uint(path);
+
+		if (line > 0)
+			topo->cacheLine = line;
+
+		switch (level) {
+			case 1: topo->cacheL1 = size; break;
+			case 2: topo->cacheL2 = size; break;
+			case 3: topo->cacheL3 = size; break;
+		}
+	}
+}
+
+static uint32_t cpu_parse_list(const char *s, uint32_t *cpus)
+{
+	// Lists look like "0-3,6,8-11", with gaps where processors are offline
+	uint32_t n = 0;
+
+	while (*s >= '0' && *s <= '9') {
+		char *end = NULL;
+		uint32_t first = strtoul(s, &end, 10);
+		uint32_t last = first;
+
+		if (*end == '-')
+			last = strtoul(end + 1, &end, 10);
+
+		for (uint32_t x = first; x <= last; x++, n++)
+			if (cpus)
+				cpus[n] = x;
+
+		s = *end == ',' ? end + 1 : end;
+	}
+
+	return n;
+}
+
+static uint32_t cpu_read_online(uint32_t **cpus)
+{
+	char buf[1024];
+	uint32_t n = 0;
+
+	if (cpu_read_sysfs("/sys/devices/system/cpu/online", buf, 1024))
+		n = cpu_parse_list(buf, NULL);
+
+	if (n > 0) {
+		*cpus = MTY_Alloc(n, sizeof(uint32_t));
+		cpu_parse_list(buf, *cpus);
+
+		return n;
+	}
+
+	// Without sysfs assume the online processors are numbered contiguously
+	long c = sysconf(_SC_NPROCESSORS_ONLN);
+	n = c > 0 ? (uint32_t) c : 1;
+
+	*cpus = MTY_Alloc(n, sizeof(uint32_t));
+
+	for (uint32_t x = 0; x < n; x++)
+		(*cpus)[x] = x;
+
+	return n;
+}
+
+static void mty_cpu_topology(MTY_CPUTopology *topo)
+{
+	uint32_t *cpus = NULL;
+	topo->threads = cpu_read_online(&cpus);
+
+	// Each logical processor is identified by its (package, core) pair, the first
+	// logical processor seen for a pair is its primary and the rest are SMT siblings
+	uint64_t *ids = MTY_Alloc(topo->threads, sizeof(uint64_t));
+	uint32_t max_package = 0;
+
+	for (uint32_t x = 0; x < topo->threads; x++) {
+		uint32_t cpu = cpus[x];
+		char path[128];
+
+		snprintf(path, 128, "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", cpu);
+		uint32_t package = cpu_read_uint(path);
+
+		snprintf(path, 128, "/sys/devices/system/cpu/cpu%u/topology/core_id", cpu);
+		char buf[32];
+		bool known = cpu_read_sysfs(path, buf, 32);
+
+		// Without topology information treat every logical processor as a core
+		uint64_t id = known ? ((uint64_t) package << 32) | strtoul(buf, NULL, 10) : UINT64_MAX - cpu;
+		bool primary = true;
+
+		for (uint32_t y = 0; y < x && primary; y++)
+			if (ids[y] == id)
+				primary = false;
+
+		ids[x] = id;
+
+		if (primary) {
+			topo->cores++;
+
+			if (cpu < 64)
+				topo->coreMask |= (uint64_t) 1 << cpu;
+		}
+
+		if (package > max_package)
+			max_package = package;
+	}
+
+	MTY_Free(ids);
+	MTY_Free(cpus);
+
+	topo->packages = max_package + 1;
+
+	cpu_read_caches(topo);
+}
@@ -0,0 +1,26 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <errno.h>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static void mty_futex_wait(MTY_Atomic32 *addr, int32_t value)
+{
+	if (syscall(SYS_futex, &addr->value, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0) != 0)
+		if (errno != EAGAIN && errno != EINTR)
+			MTY_Fatal("'futex' failed with errno %d", errno);
+}
+
+static void mty_futex_wake(MTY_Atomic32 *addr, bool all)
+{
+	if (syscall(SYS_futex, &addr->value, FUTEX_WAKE_PRIVATE, all ? INT32_MAX : 1, NULL, NULL, 0) == -1)
+		MTY_Fatal("'futex' failed with errno %d", errno);
+}
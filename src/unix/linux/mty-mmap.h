@@ -0,0 +1,57 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <errno.h>
+
+#include <sys/mman.h>
+
+static void *mty_mmap(size_t size)
+{
+	void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+
+	if (mem == MAP_FAILED)
+		MTY_Fatal("'mmap' failed with errno %d", errno);
+
+	return mem;
+}
+
+static void mty_munmap(void *mem, size_t size)
+{
+	if (munmap(mem, size) != 0)
+		MTY_Log("'munmap' failed with errno %d", errno);
+}
+
+static void *mty_mmap_huge(size_t size)
+{
+	#if defined(MAP_HUGETLB)
+		// Only succeeds if the system has reserved huge pages
+		void *huge = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_HUGETLB, -1, 0);
+
+		if (huge != MAP_FAILED)
+			return huge;
+	#endif
+
+	void *mem = mty_mmap(size);
+
+	#if defined(MADV_HUGEPAGE)
+		// Transparent huge pages, may be disabled system wide
+		madvise(mem, size, MADV_HUGEPAGE);
+	#endif
+
+	return mem;
+}
+
+static bool mty_mlock(void *mem, size_t size)
+{
+	if (mlock(mem, size) != 0) {
+		MTY_Log("'mlock' failed with errno %d", errno);
+		return false;
+	}
+
+	return true;
+}
@@ -18,3 +18,23 @@ static void mty_sleep_ms(uint32_t timeout)
 	if (nanosleep(&ts, NULL) != 0)
 		MTY_Log("'nanosleep' failed with errno %d", errno);
 }
+
+static void mty_sleep_us(uint64_t us)
+{
+	struct timespec ts = {0};
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+		MTY_Log("'clock_gettime' failed with errno %d", errno);
+		return;
+	}
+
+	uint64_t ns = ts.tv_nsec + (us % 1000000) * 1000;
+	ts.tv_sec += us / 1000000 + ns / 1000000000;
+	ts.tv_nsec = ns % 1000000000;
+
+	// An absolute deadline makes retrying after a signal exact
+	int32_t e = 0;
+	while ((e = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR);
+
+	if (e != 0)
+		MTY_Log("'clock_nanosleep' failed with error %d", e);
+}
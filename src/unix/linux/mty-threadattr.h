@@ -0,0 +1,65 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <errno.h>
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+static MTY_Atomic32 THREADATTR_SCHED_LOGGED;
+static MTY_Atomic32 THREADATTR_NICE_LOGGED;
+
+static void mty_thread_set_name(const char *name)
+{
+	// The kernel truncates thread names to 15 characters
+	if (prctl(PR_SET_NAME, name, 0, 0, 0) != 0)
+		MTY_Log("'prctl' failed with errno %d", errno);
+}
+
+static void mty_thread_set_affinity(uint64_t mask)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (uint32_t x = 0; x < 64; x++)
+		if (mask & ((uint64_t) 1 << x))
+			CPU_SET(x, &set);
+
+	if (sched_setaffinity(0, sizeof(cpu_set_t), &set) != 0)
+		MTY_Log("'sched_setaffinity' failed with errno %d", errno);
+}
+
+static void mty_thread_set_priority(MTY_ThreadPriority priority)
+{
+	if (priority == MTY_THREAD_PRIORITY_REALTIME) {
+		struct sched_param param = {0};
+		param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+
+		int32_t e = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if (e == 0)
+			return;
+
+		// Usually EPERM without CAP_SYS_NICE, fall back to the highest nice value. The
+		// failure repeats for every thread so it is only logged once
+		if (MTY_Atomic32CAS(&THREADATTR_SCHED_LOGGED, 0, 1))
+			MTY_Log("'pthread_setschedparam' failed with error %d", e);
+
+		priority = MTY_THREAD_PRIORITY_HIGH;
+	}
+
+	int32_t nice = priority == MTY_THREAD_PRIORITY_HIGH ? -10 :
+		priority == MTY_THREAD_PRIORITY_LOW ? 10 : 0;
+
+	// Linux applies nice values per thread rather than per process
+	if (setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), nice) != 0 &&
+		MTY_Atomic32CAS(&THREADATTR_NICE_LOGGED, 0, 1))
+		MTY_Log("'setpriority' failed with errno %d", errno);
+}
@@ -9,6 +9,11 @@
 #include <time.h>
 #include <errno.h>
 
+#if defined(__x86_64__)
+	#include <cpuid.h>
+	#include <x86intrin.h>
+#endif
+
 static int64_t mty_timestamp(void)
 {
 	struct timespec ts = {0};
@@ -27,3 +32,103 @@ static float mty_frequency(void)
 {
 	return 0.001f;
 }
+
+
+// Cycle counters, converted to the same microsecond units as mty_timestamp. The rate is
+// only measured once so the two clocks slowly drift apart
+
+#if defined(__x86_64__) || defined(__aarch64__)
+
+static struct timestamp_cycles {
+	bool enabled;
+	int64_t base;
+	uint64_t start;
+	uint64_t mult;
+} TIMESTAMP_CYCLES;
+
+static MTY_Atomic32 TIMESTAMP_CYCLES_ONCE;
+
+static uint64_t mty_cycles(void)
+{
+	#if defined(__x86_64__)
+		return __rdtsc();
+	#else
+		uint64_t v;
+		__asm__ volatile ("isb; mrs %0, cntvct_el0" : "=r" (v));
+
+		return v;
+	#endif
+}
+
+static bool mty_cycles_stable(uint64_t *hz)
+{
+	#if defined(__x86_64__)
+		// Without an invariant TSC the rate changes with power states, and the rate
+		// itself isn't reliably exposed so it is measured
+		uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+		*hz = 0;
+
+		return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1 << 8));
+	#else
+		__asm__ volatile ("mrs %0, cntfrq_el0" : "=r" (*hz));
+
+		return *hz != 0;
+	#endif
+}
+
+static void mty_cycles_calibrate(void *opaque)
+{
+	struct timestamp_cycles *ctx = &TIMESTAMP_CYCLES;
+
+	uint64_t hz = 0;
+	if (!mty_cycles_stable(&hz))
+		return;
+
+	uint64_t c0 = mty_cycles();
+	ctx->base = mty_timestamp();
+	ctx->start = c0 / 2 + mty_cycles() / 2;
+
+	// Measured once against the clock, the counter is read on both sides of each clock
+	// read to bound the error
+	if (hz == 0) {
+		struct timespec req = {0, 20 * 1000 * 1000};
+		nanosleep(&req, NULL);
+
+		c0 = mty_cycles();
+		int64_t t = mty_timestamp();
+		uint64_t c = c0 / 2 + mty_cycles() / 2;
+
+		if (t <= ctx->base)
+			return;
+
+		hz = (uint64_t) ((double) (c - ctx->start) * 1000000.0 / (double) (t - ctx->base));
+	}
+
+	if (hz == 0)
+		return;
+
+	// Division stays in double, 128-bit division would need a libgcc helper
+	ctx->mult = (uint64_t) (1000000.0 * 4294967296.0 / (double) hz);
+	ctx->enabled = true;
+}
+
+static int64_t mty_timestamp_fast(void)
+{
+	MTY_Once(&TIMESTAMP_CYCLES_ONCE, mty_cycles_calibrate, NULL);
+
+	struct timestamp_cycles *ctx = &TIMESTAMP_CYCLES;
+
+	if (!ctx->enabled)
+		return mty_timestamp();
+
+	return ctx->base + (int64_t) (((unsigned __int128) (mty_cycles() - ctx->start) * ctx->mult) >> 32);
+}
+
+#else
+
+static int64_t mty_timestamp_fast(void)
+{
+	return mty_timestamp();
+}
+
+#endif
@@ -8,26 +8,23 @@
 #define _DARWIN_C_SOURCE // htonll, ntohll (mty-swap.h)
 
 #include <stdlib.h>
-#include <string.h>
-#include <errno.h>
-#include <wchar.h>
 
-#include "matoya.h"
+#include "mem-sys.h"
 
-void *MTY_AllocAligned(size_t size, size_t align)
+void *mem_sys_aligned_alloc(size_t size, size_t align)
 {
 	void *mem = NULL;
 	int32_t e = posix_memalign(&mem, align, size);
 
-	if (e != 0)
-		MTY_Fatal("'posix_memalign' failed with error %d", e);
-
-	memset(mem, 0, size);
+	if (e != 0) {
+		MTY_Log("'posix_memalign' failed with error %d", e);
+		return NULL;
+	}
 
 	return mem;
 }
 
-void MTY_FreeAligned(void *mem)
+void mem_sys_aligned_free(void *mem)
 {
 	free(mem);
 }
@@ -100,39 +97,3 @@ uint64_t MTY_SwapFromBE64(uint64_t value)
 		return value;
 	#endif
 }
-
-bool MTY_WideToMulti(const wchar_t *src, char *dst, size_t len)
-{
-	size_t n = wcstombs(dst, src, len);
-
-	if (n > 0 && n != (size_t) -1) {
-		if (n == len) {
-			MTY_Log("Conversion truncated");
-			dst[len - 1] = L'\0';
-		}
-	} else {
-		MTY_Log("'wcstombs' failed with errno %d", errno);
-		memset(dst, 0, len);
-		return false;
-	}
-
-	return true;
-}
-
-bool MTY_MultiToWide(const char *src, wchar_t *dst, uint32_t len)
-{
-	size_t n = mbstowcs(dst, src, len);
-
-	if (n > 0 && n != (size_t) -1) {
-		if (n == len) {
-			MTY_Log("Conversion truncated");
-			dst[len - 1] = L'\0';
-		}
-	} else {
-		MTY_Log("'mbstowcs' failed with errno %d", errno);
-		memset(dst, 0, len * sizeof(wchar_t));
-		return false;
-	}
-
-	return true;
-}
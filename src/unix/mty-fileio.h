@@ -0,0 +1,112 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define MTY_FILEIO_INVALID ((intptr_t) -1)
+#define MTY_FILEIO_CHUNK   (1024 * 1024 * 1024)
+
+static intptr_t mty_fileio_open(const char *path, MTY_FileMode mode)
+{
+	int32_t flags = O_RDONLY;
+
+	switch (mode) {
+		case MTY_FILE_MODE_WRITE:      flags = O_WRONLY | O_CREAT | O_TRUNC;  break;
+		case MTY_FILE_MODE_APPEND:     flags = O_WRONLY | O_CREAT | O_APPEND; break;
+		case MTY_FILE_MODE_READ_WRITE: flags = O_RDWR | O_CREAT;              break;
+		default:
+			break;
+	}
+
+	// Same permissions as fopen, masked by the umask
+	int32_t f = open(path, flags, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+
+	if (f == -1) {
+		MTY_Log("'open' failed to open '%s' with errno %d", MTY_GetFileName(path, true), errno);
+		return MTY_FILEIO_INVALID;
+	}
+
+	return f;
+}
+
+static int64_t mty_fileio_read(intptr_t f, void *data, size_t size, int64_t offset)
+{
+	size_t total = 0;
+
+	while (total < size) {
+		size_t chunk = size - total > MTY_FILEIO_CHUNK ? MTY_FILEIO_CHUNK : size - total;
+		uint8_t *ptr = (uint8_t *) data + total;
+
+		ssize_t n = offset >= 0 ? pread((int32_t) f, ptr, chunk, (off_t) (offset + total)) :
+			read((int32_t) f, ptr, chunk);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			MTY_Log("'%s' failed with errno %d", offset >= 0 ? "pread" : "read", errno);
+			return -1;
+		}
+
+		if (n == 0)
+			break;
+
+		total += n;
+	}
+
+	return total;
+}
+
+// On Linux pwrite on an O_APPEND descriptor ignores the offset and appends, so
+// positioned writes on a file opened with MTY_FILE_MODE_APPEND land at the end
+static bool mty_fileio_write(intptr_t f, const void *data, size_t size, int64_t offset)
+{
+	for (size_t total = 0; total < size;) {
+		size_t chunk = size - total > MTY_FILEIO_CHUNK ? MTY_FILEIO_CHUNK : size - total;
+		const uint8_t *ptr = (const uint8_t *) data + total;
+
+		ssize_t n = offset >= 0 ? pwrite((int32_t) f, ptr, chunk, (off_t) (offset + total)) :
+			write((int32_t) f, ptr, chunk);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			MTY_Log("'%s' failed with errno %d", offset >= 0 ? "pwrite" : "write", errno);
+			return false;
+		}
+
+		total += n;
+	}
+
+	return true;
+}
+
+static int64_t mty_fileio_seek(intptr_t f, int64_t offset, MTY_Seek whence)
+{
+	int32_t w = whence == MTY_SEEK_CUR ? SEEK_CUR : whence == MTY_SEEK_END ? SEEK_END : SEEK_SET;
+
+	off_t pos = lseek((int32_t) f, (off_t) offset, w);
+
+	if (pos == (off_t) -1) {
+		MTY_Log("'lseek' failed with errno %d", errno);
+		return -1;
+	}
+
+	return pos;
+}
+
+static void mty_fileio_close(intptr_t f)
+{
+	if (close((int32_t) f) != 0)
+		MTY_Log("'close' failed with errno %d", errno);
+}
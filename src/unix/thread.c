@@ -4,8 +4,11 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
+#define _GNU_SOURCE // sched_setaffinity, CPU_SET (mty-threadattr.h)
+
 #include "matoya.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -13,6 +16,12 @@
 
 #include "mty-pthread.h"
 #include "mty-gettime.h"
+#include "mty-threadattr.h"
+#include "mty-cpu.h"
+#include "lock-prof.h"
+#include "thread-exit.h"
+
+#define THREAD_NAME_MAX 64
 
 
 // Thread
@@ -23,12 +32,27 @@ struct MTY_Thread {
 	void *(*func)(void *opaque);
 	void *opaque;
 	void *ret;
+
+	char name[THREAD_NAME_MAX];
+	uint64_t affinity;
+	MTY_ThreadPriority priority;
 };
 
 static void *thread_func(void *opaque)
 {
 	MTY_Thread *ctx = (MTY_Thread *) opaque;
 
+	// Attributes are applied from the new thread since some platforms only
+	// support naming and prioritizing the calling thread
+	if (ctx->name[0])
+		mty_thread_set_name(ctx->name);
+
+	if (ctx->affinity != 0)
+		mty_thread_set_affinity(ctx->affinity);
+
+	if (ctx->priority != MTY_THREAD_PRIORITY_NORMAL)
+		mty_thread_set_priority(ctx->priority);
+
 	ctx->ret = ctx->func(ctx->opaque);
 
 	if (ctx->detach)
@@ -37,18 +61,43 @@ static void *thread_func(void *opaque)
 	return NULL;
 }
 
-static MTY_Thread *thread_create(void *(*func)(void *opaque), const void *opaque, bool detach)
+static MTY_Thread *thread_create(void *(*func)(void *opaque), const void *opaque, bool detach,
+	const MTY_ThreadDesc *desc)
 {
 	MTY_Thread *ctx = MTY_Alloc(1, sizeof(MTY_Thread));
 	ctx->func = func;
 	ctx->opaque = (void *) opaque;
 	ctx->detach = detach;
 
-	int32_t e = pthread_create(&ctx->thread, NULL, thread_func, ctx);
+	pthread_attr_t attr;
+	int32_t e = pthread_attr_init(&attr);
+	if (e != 0)
+		MTY_Fatal("'pthread_attr_init' failed with error %d", e);
+
+	if (desc) {
+		if (desc->name)
+			snprintf(ctx->name, THREAD_NAME_MAX, "%s", desc->name);
+
+		ctx->affinity = desc->affinity;
+		ctx->priority = desc->priority;
+
+		if (desc->stackSize > 0) {
+			// Round up to 64 KB so the size is a multiple of the page size everywhere
+			e = pthread_attr_setstacksize(&attr, (desc->stackSize + 0xFFFF) & ~(size_t) 0xFFFF);
+			if (e != 0)
+				MTY_Log("'pthread_attr_setstacksize' failed with error %d", e);
+		}
+	}
+
+	e = pthread_create(&ctx->thread, &attr, thread_func, ctx);
 
 	if (e != 0)
 		MTY_Fatal("'pthread_create' failed with error %d", e);
 
+	e = pthread_attr_destroy(&attr);
+	if (e != 0)
+		MTY_Log("'pthread_attr_destroy' failed with error %d", e);
+
 	if (ctx->detach) {
 		e = pthread_detach(ctx->thread);
 		if (e != 0)
@@ -63,15 +112,20 @@ static MTY_Thread *thread_create(void *(*func)(void *opaque), const void *opaque
 
 MTY_Thread *MTY_ThreadCreate(void *(*func)(void *opaque), const void *opaque)
 {
-	return thread_create(func, opaque, false);
+	return thread_create(func, opaque, false, NULL);
+}
+
+MTY_Thread *MTY_ThreadCreateEx(void *(*func)(void *opaque), const void *opaque, const MTY_ThreadDesc *desc)
+{
+	return thread_create(func, opaque, false, desc);
 }
 
 void MTY_ThreadDetach(void *(*func)(void *opaque), const void *opaque)
 {
-	thread_create(func, opaque, true);
+	thread_create(func, opaque, true, NULL);
 }
 
-int64_t MTY_ThreadIDGet(MTY_Thread *ctx)
+int64_t MTY_ThreadGetID(MTY_Thread *ctx)
 {
 	return (int64_t) (ctx ? ctx->thread : pthread_self());
 }
@@ -98,15 +152,88 @@ void *MTY_ThreadDestroy(MTY_Thread **thread)
 }
 
 
+// Exit hooks
+
+struct thread_exit {
+	struct thread_exit *next;
+	void (*func)(void *opaque);
+	void *opaque;
+};
+
+static pthread_key_t THREAD_EXIT_KEY;
+static MTY_Atomic32 THREAD_EXIT_ONCE;
+
+static void thread_exit_run(void *value)
+{
+	for (struct thread_exit *hook = value; hook;) {
+		struct thread_exit *next = hook->next;
+
+		hook->func(hook->opaque);
+		MTY_Free(hook);
+
+		hook = next;
+	}
+}
+
+static void thread_exit_init(void *opaque)
+{
+	int32_t e = pthread_key_create(&THREAD_EXIT_KEY, thread_exit_run);
+	if (e != 0)
+		MTY_Fatal("'pthread_key_create' failed with error %d", e);
+}
+
+void thread_exit_hook(void (*func)(void *opaque), void *opaque)
+{
+	MTY_Once(&THREAD_EXIT_ONCE, thread_exit_init, NULL);
+
+	struct thread_exit *hook = MTY_Alloc(1, sizeof(struct thread_exit));
+	hook->func = func;
+	hook->opaque = opaque;
+	hook->next = pthread_getspecific(THREAD_EXIT_KEY);
+
+	int32_t e = pthread_setspecific(THREAD_EXIT_KEY, hook);
+	if (e != 0)
+		MTY_Fatal("'pthread_setspecific' failed with error %d", e);
+}
+
+
+// CPU
+
+void MTY_GetCPUTopology(MTY_CPUTopology *topology)
+{
+	memset(topology, 0, sizeof(MTY_CPUTopology));
+
+	mty_cpu_topology(topology);
+
+	if (topology->threads == 0)
+		topology->threads = 1;
+
+	if (topology->cores == 0 || topology->cores > topology->threads)
+		topology->cores = topology->threads;
+
+	if (topology->packages == 0)
+		topology->packages = 1;
+
+	if (topology->cacheLine == 0)
+		topology->cacheLine = 64;
+
+	if (topology->coreMask == 0)
+		topology->coreMask = 1;
+}
+
+
 // Mutex
 
 struct MTY_Mutex {
 	pthread_mutex_t mutex;
+	struct lock_prof *prof;
+	int64_t acquired;
 };
 
-MTY_Mutex *MTY_MutexCreate(void)
+MTY_Mutex *MTY_MutexCreateNamed(const char *name)
 {
 	MTY_Mutex *ctx = MTY_Alloc(1, sizeof(MTY_Mutex));
+	ctx->prof = lock_prof_get(name);
 
 	int32_t e = pthread_mutex_init(&ctx->mutex, NULL);
 	if (e != 0)
@@ -115,14 +242,12 @@ MTY_Mutex *MTY_MutexCreate(void)
 	return ctx;
 }
 
-void MTY_MutexLock(MTY_Mutex *ctx)
+MTY_Mutex *MTY_MutexCreate(void)
 {
-	int32_t e = pthread_mutex_lock(&ctx->mutex);
-	if (e != 0)
-		MTY_Fatal("'pthread_mutex_lock' failed with error %d", e);
+	return MTY_MutexCreateNamed(NULL);
 }
 
-bool MTY_MutexTryLock(MTY_Mutex *ctx)
+static bool mutex_trylock(MTY_Mutex *ctx)
 {
 	int32_t e = pthread_mutex_trylock(&ctx->mutex);
 
@@ -136,8 +261,48 @@ bool MTY_MutexTryLock(MTY_Mutex *ctx)
 	return true;
 }
 
+static void mutex_lock(MTY_Mutex *ctx)
+{
+	int32_t e = pthread_mutex_lock(&ctx->mutex);
+	if (e != 0)
+		MTY_Fatal("'pthread_mutex_lock' failed with error %d", e);
+}
+
+void MTY_MutexLock(MTY_Mutex *ctx)
+{
+	if (!lock_prof_active(ctx->prof)) {
+		mutex_lock(ctx);
+		return;
+	}
+
+	int64_t begin = MTY_Timestamp();
+	bool contended = !mutex_trylock(ctx);
+
+	if (contended)
+		mutex_lock(ctx);
+
+	ctx->acquired = lock_prof_acquired(ctx->prof, contended, begin);
+}
+
+bool MTY_MutexTryLock(MTY_Mutex *ctx)
+{
+	bool r = mutex_trylock(ctx);
+
+	if (r && lock_prof_active(ctx->prof))
+		ctx->acquired = lock_prof_acquired(ctx->prof, false, 0);
+
+	return r;
+}
+
 void MTY_MutexUnlock(MTY_Mutex *ctx)
 {
+	// Checking 'acquired' rather than the enabled flag keeps the hold time
+	// correct if profiling is toggled while the mutex is held
+	if (ctx->acquired != 0) {
+		lock_prof_released(ctx->prof, ctx->acquired);
+		ctx->acquired = 0;
+	}
+
 	int32_t e = pthread_mutex_unlock(&ctx->mutex);
 	if (e != 0)
 		MTY_Fatal("'pthread_mutex_unlock' failed with error %d", e);
@@ -163,11 +328,13 @@ void MTY_MutexDestroy(MTY_Mutex **mutex)
 
 struct MTY_Cond {
 	pthread_cond_t cond;
+	struct lock_prof *prof;
 };
 
-MTY_Cond *MTY_CondCreate(void)
+MTY_Cond *MTY_CondCreateNamed(const char *name)
 {
 	MTY_Cond *ctx = MTY_Alloc(1, sizeof(MTY_Cond));
+	ctx->prof = lock_prof_get(name);
 
 	int32_t e = pthread_cond_init(&ctx->cond, NULL);
 	if (e != 0)
@@ -176,7 +343,12 @@ MTY_Cond *MTY_CondCreate(void)
 	return ctx;
 }
 
-bool MTY_CondWait(MTY_Cond *ctx, MTY_Mutex *mutex, int32_t timeout)
+MTY_Cond *MTY_CondCreate(void)
+{
+	return MTY_CondCreateNamed(NULL);
+}
+
+static bool cond_wait(MTY_Cond *ctx, MTY_Mutex *mutex, int32_t timeout)
 {
 	// Use pthread_cond_timedwait
 	if (timeout >= 0) {
@@ -206,6 +378,32 @@ bool MTY_CondWait(MTY_Cond *ctx, MTY_Mutex *mutex, int32_t timeout)
 	return true;
 }
 
+bool MTY_CondWait(MTY_Cond *ctx, MTY_Mutex *mutex, int32_t timeout)
+{
+	// The mutex is released for the duration of the wait, so it should not count
+	// towards its hold time
+	bool relock = mutex->acquired != 0;
+
+	if (relock) {
+		lock_prof_released(mutex->prof, mutex->acquired);
+		mutex->acquired = 0;
+	}
+
+	bool active = lock_prof_active(ctx->prof);
+	int64_t begin = active ? MTY_Timestamp() : 0;
+
+	bool r = cond_wait(ctx, mutex, timeout);
+
+	if (active)
+		lock_prof_waited(ctx->prof, !r, begin);
+
+	// Only the hold time restarts, waking is not a new acquisition
+	if (relock)
+		mutex->acquired = MTY_Timestamp();
+
+	return r;
+}
+
 void MTY_CondWake(MTY_Cond *ctx)
 {
 	int32_t e = pthread_cond_signal(&ctx->cond);
@@ -6,24 +6,31 @@
 
 #include "matoya.h"
 
-#include "mty-tls.h"
 #include "mty-timestamp.h"
 #include "mty-sleepms.h"
+#include "time-sleep.h"
 
-static MTY_TLS bool TIME_FREQ_INIT;
-static MTY_TLS float TIME_FREQUENCY;
+static MTY_Atomic32 TIME_FREQ_ONCE;
+static float TIME_FREQUENCY;
+
+static void time_frequency(void *opaque)
+{
+	TIME_FREQUENCY = mty_frequency();
+}
 
 int64_t MTY_Timestamp(void)
 {
 	return mty_timestamp();
 }
 
+int64_t MTY_TimestampFast(void)
+{
+	return mty_timestamp_fast();
+}
+
 float MTY_TimeDiff(int64_t begin, int64_t end)
 {
-	if (!TIME_FREQ_INIT) {
-		TIME_FREQUENCY = mty_frequency();
-		TIME_FREQ_INIT = true;
-	}
+	MTY_Once(&TIME_FREQ_ONCE, time_frequency, NULL);
 
 	return (float) (end - begin) * TIME_FREQUENCY;
 }
@@ -35,6 +42,11 @@ void MTY_Sleep(uint32_t timeout)
 	mty_sleep_ms(timeout);
 }
 
+void time_sleep_us(uint64_t us)
+{
+	mty_sleep_us(us);
+}
+
 void MTY_SetTimerResolution(uint32_t res)
 {
 }
@@ -0,0 +1,10 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#define mty_futex_wait(addr, value) ((void) (addr), (void) (value))
+#define mty_futex_wake(addr, all) ((void) (addr), (void) (all))
@@ -0,0 +1,12 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#define mty_mmap(size) MTY_Alloc(size, 1)
+#define mty_munmap(mem, size) MTY_Free(mem)
+#define mty_mmap_huge(size) mty_mmap(size)
+#define mty_mlock(mem, size) ((void) (mem), (void) (size), false)
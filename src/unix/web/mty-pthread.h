@@ -8,6 +8,10 @@
 
 typedef int32_t pthread_t;
 
+typedef struct pthread_attr_t {
+	uint8_t _;
+} pthread_attr_t;
+
 typedef struct pthread_mutex_t {
 	uint8_t _;
 } pthread_mutex_t;
@@ -27,6 +31,10 @@ typedef struct pthread_rwlockattr_t {
 #define PTHREAD_MUTEX_INITIALIZER {0}
 #define PTHREAD_COND_INITIALIZER {0}
 
+#define pthread_attr_init(attr) ((void) (attr), 0)
+#define pthread_attr_destroy(attr) 0
+#define pthread_attr_setstacksize(attr, size) 0
+
 #define pthread_create(t, attr, func, opaque) ((func)(opaque), 0)
 #define pthread_join(t, ret) 0
 #define pthread_detach(t) 0
@@ -53,3 +61,5 @@ typedef struct pthread_rwlockattr_t {
 #define pthread_rwlock_lock(rw) 0
 #define pthread_rwlock_rdlock(rw) 0
 #define pthread_rwlock_wrlock(rw) 0
+#define pthread_rwlock_tryrdlock(rw) 0
+#define pthread_rwlock_trywrlock(rw) 0
@@ -7,3 +7,4 @@
 #pragma once
 
 #define mty_sleep_ms(ms) ((void) (ms))
+#define mty_sleep_us(us) ((void) (us))
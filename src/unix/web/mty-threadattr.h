@@ -0,0 +1,11 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#define mty_thread_set_name(name) ((void) (name))
+#define mty_thread_set_affinity(mask) ((void) (mask))
+#define mty_thread_set_priority(priority) ((void) (priority))
@@ -0,0 +1,551 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "matoya.h"
+
+#include <string.h>
+#include <wchar.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define UTF_SSE2
+	#include <emmintrin.h>
+
+#elif defined(__aarch64__)
+	#define UTF_NEON
+	#include <arm_neon.h>
+#endif
+
+#define UTF_INVALID     UINT32_MAX
+#define UTF_REPLACEMENT 0xFFFD
+
+
+// ASCII runs
+
+static size_t utf8_ascii(const uint8_t *s, size_t n)
+{
+	size_t x = 0;
+
+	#if defined(UTF_SSE2)
+		for (; x + 16 <= n; x += 16)
+			if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (s + x))) != 0)
+				break;
+
+	#elif defined(UTF_NEON)
+		for (; x + 16 <= n; x += 16)
+			if (vmaxvq_u8(vld1q_u8(s + x)) >= 0x80)
+				break;
+	#endif
+
+	while (x < n && s[x] < 0x80)
+		x++;
+
+	return x;
+}
+
+static size_t utf16_ascii(const uint16_t *s, size_t n)
+{
+	size_t x = 0;
+
+	#if defined(UTF_SSE2)
+		const __m128i mask = _mm_set1_epi16((int16_t) 0xFF80);
+		const __m128i zero = _mm_setzero_si128();
+
+		for (; x + 8 <= n; x += 8) {
+			__m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *) (s + x)), mask);
+
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(v, zero)) != 0xFFFF)
+				break;
+		}
+
+	#elif defined(UTF_NEON)
+		for (; x + 8 <= n; x += 8)
+			if (vmaxvq_u16(vld1q_u16(s + x)) >= 0x80)
+				break;
+	#endif
+
+	while (x < n && s[x] < 0x80)
+		x++;
+
+	return x;
+}
+
+static size_t utf32_ascii(const uint32_t *s, size_t n)
+{
+	size_t x = 0;
+
+	#if defined(UTF_SSE2)
+		const __m128i mask = _mm_set1_epi32((int32_t) 0xFFFFFF80);
+		const __m128i zero = _mm_setzero_si128();
+
+		for (; x + 4 <= n; x += 4) {
+			__m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *) (s + x)), mask);
+
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, zero)) != 0xFFFF)
+				break;
+		}
+
+	#elif defined(UTF_NEON)
+		for (; x + 4 <= n; x += 4)
+			if (vmaxvq_u32(vld1q_u32(s + x)) >= 0x80)
+				break;
+	#endif
+
+	while (x < n && s[x] < 0x80)
+		x++;
+
+	return x;
+}
+
+
+// Code points
+
+static bool utf_valid(uint32_t cp)
+{
+	return cp <= 0x10FFFF && (cp < 0xD800 || cp > 0xDFFF);
+}
+
+static uint32_t utf8_decode(const uint8_t *s, size_t n, size_t *i)
+{
+	uint8_t c = s[*i];
+	uint32_t cp = 0;
+	uint32_t min = 0;
+	size_t len = 0;
+
+	if ((c & 0xE0) == 0xC0) {
+		cp = c & 0x1F;
+		min = 0x80;
+		len = 2;
+
+	} else if ((c & 0xF0) == 0xE0) {
+		cp = c & 0x0F;
+		min = 0x800;
+		len = 3;
+
+	} else if ((c & 0xF8) == 0xF0) {
+		cp = c & 0x07;
+		min = 0x10000;
+		len = 4;
+
+	} else if (c < 0x80) {
+		(*i)++;
+		return c;
+
+	} else {
+		return UTF_INVALID;
+	}
+
+	if (len > n - *i)
+		return UTF_INVALID;
+
+	for (size_t x = 1; x < len; x++) {
+		uint8_t cc = s[*i + x];
+
+		if ((cc & 0xC0) != 0x80)
+			return UTF_INVALID;
+
+		cp = (cp << 6) | (cc & 0x3F);
+	}
+
+	// Overlong encodings, surrogates and values past U+10FFFF are rejected
+	if (cp < min || !utf_valid(cp))
+		return UTF_INVALID;
+
+	*i += len;
+
+	return cp;
+}
+
+static size_t utf8_encode(uint32_t cp, uint8_t *out)
+{
+	if (cp < 0x80) {
+		out[0] = (uint8_t) cp;
+		return 1;
+	}
+
+	if (cp < 0x800) {
+		out[0] = (uint8_t) (0xC0 | (cp >> 6));
+		out[1] = (uint8_t) (0x80 | (cp & 0x3F));
+		return 2;
+	}
+
+	if (cp < 0x10000) {
+		out[0] = (uint8_t) (0xE0 | (cp >> 12));
+		out[1] = (uint8_t) (0x80 | ((cp >> 6) & 0x3F));
+		out[2] = (uint8_t) (0x80 | (cp & 0x3F));
+		return 3;
+	}
+
+	out[0] = (uint8_t) (0xF0 | (cp >> 18));
+	out[1] = (uint8_t) (0x80 | ((cp >> 12) & 0x3F));
+	out[2] = (uint8_t) (0x80 | ((cp >> 6) & 0x3F));
+	out[3] = (uint8_t) (0x80 | (cp & 0x3F));
+	return 4;
+}
+
+static uint32_t utf16_decode(const uint16_t *s, size_t n, size_t *i)
+{
+	uint32_t u = s[*i];
+
+	if (u >= 0xD800 && u <= 0xDBFF) {
+		if (*i + 1 >= n || s[*i + 1] < 0xDC00 || s[*i + 1] > 0xDFFF)
+			return UTF_INVALID;
+
+		uint32_t cp = 0x10000 + ((u - 0xD800) << 10) + (s[*i + 1] - 0xDC00);
+		*i += 2;
+
+		return cp;
+	}
+
+	if (u >= 0xDC00 && u <= 0xDFFF)
+		return UTF_INVALID;
+
+	(*i)++;
+
+	return u;
+}
+
+static size_t utf16_encode(uint32_t cp, uint16_t *out)
+{
+	if (cp < 0x10000) {
+		out[0] = (uint16_t) cp;
+		return 1;
+	}
+
+	cp -= 0x10000;
+	out[0] = (uint16_t) (0xD800 + (cp >> 10));
+	out[1] = (uint16_t) (0xDC00 + (cp & 0x3FF));
+	return 2;
+}
+
+
+// Output
+
+// Converters write at most 'len' units including the null terminator and stop
+// at a code point boundary when out of room. They return the number of units
+// the complete conversion requires including the terminator, or 0 if the input
+// is invalid, so passing a NULL 'dst' is a length query. When 'lossy' is set,
+// each invalid unit is replaced with U+FFFD instead
+
+struct utf_out {
+	void *dst;
+	size_t unit;
+	size_t cap;
+	size_t written;
+	size_t n;
+	bool term;
+	bool full;
+};
+
+static void utf_out_init(struct utf_out *out, void *dst, size_t unit, size_t len)
+{
+	out->dst = dst;
+	out->unit = unit;
+	out->term = dst && len > 0;
+	out->cap = out->term ? len - 1 : 0;
+	out->written = 0;
+	out->n = 0;
+	out->full = !out->term;
+}
+
+static size_t utf_out_room(struct utf_out *out, size_t run)
+{
+	if (out->full)
+		return 0;
+
+	size_t room = out->cap - out->written;
+
+	return run < room ? run : room;
+}
+
+static void utf_out_advance(struct utf_out *out, size_t written, size_t count)
+{
+	out->written += written;
+	out->n += count;
+
+	if (written < count)
+		out->full = true;
+}
+
+static void utf_out_write(struct utf_out *out, const void *units, size_t count)
+{
+	bool fits = !out->full && out->written + count <= out->cap;
+
+	if (fits)
+		memcpy((uint8_t *) out->dst + out->written * out->unit, units, count * out->unit);
+
+	utf_out_advance(out, fits ? count : 0, count);
+}
+
+static size_t utf_out_finish(struct utf_out *out, bool ok)
+{
+	if (out->term)
+		memset((uint8_t *) out->dst + (ok ? out->written : 0) * out->unit, 0, out->unit);
+
+	return ok ? out->n + 1 : 0;
+}
+
+static size_t utf16_len(const uint16_t *s)
+{
+	size_t n = 0;
+
+	while (s[n])
+		n++;
+
+	return n;
+}
+
+static size_t utf32_len(const uint32_t *s)
+{
+	size_t n = 0;
+
+	while (s[n])
+		n++;
+
+	return n;
+}
+
+
+// Conversions
+
+static size_t utf8_to_utf16(const char *src, uint16_t *dst, size_t len, bool lossy)
+{
+	const uint8_t *s = (const uint8_t *) src;
+	size_t n = strlen(src);
+
+	struct utf_out out;
+	utf_out_init(&out, dst, sizeof(uint16_t), len);
+
+	for (size_t i = 0; i < n;) {
+		size_t run = utf8_ascii(s + i, n - i);
+
+		if (run > 0) {
+			size_t w = utf_out_room(&out, run);
+
+			for (size_t x = 0; x < w; x++)
+				dst[out.written + x] = s[i + x];
+
+			utf_out_advance(&out, w, run);
+			i += run;
+			continue;
+		}
+
+		uint32_t cp = utf8_decode(s, n, &i);
+
+		if (cp == UTF_INVALID) {
+			if (!lossy)
+				return utf_out_finish(&out, false);
+
+			cp = UTF_REPLACEMENT;
+			i++;
+		}
+
+		uint16_t units[2];
+		utf_out_write(&out, units, utf16_encode(cp, units));
+	}
+
+	return utf_out_finish(&out, true);
+}
+
+static size_t utf16_to_utf8(const uint16_t *src, char *dst, size_t len, bool lossy)
+{
+	size_t n = utf16_len(src);
+
+	struct utf_out out;
+	utf_out_init(&out, dst, 1, len);
+
+	for (size_t i = 0; i < n;) {
+		size_t run = utf16_ascii(src + i, n - i);
+
+		if (run > 0) {
+			size_t w = utf_out_room(&out, run);
+
+			for (size_t x = 0; x < w; x++)
+				dst[out.written + x] = (char) src[i + x];
+
+			utf_out_advance(&out, w, run);
+			i += run;
+			continue;
+		}
+
+		uint32_t cp = utf16_decode(src, n, &i);
+
+		// Windows names may hold unpaired surrogates
+		if (cp == UTF_INVALID) {
+			if (!lossy)
+				return utf_out_finish(&out, false);
+
+			cp = UTF_REPLACEMENT;
+			i++;
+		}
+
+		uint8_t units[4];
+		utf_out_write(&out, units, utf8_encode(cp, units));
+	}
+
+	return utf_out_finish(&out, true);
+}
+
+static size_t utf8_to_utf32(const char *src, uint32_t *dst, size_t len, bool lossy)
+{
+	const uint8_t *s = (const uint8_t *) src;
+	size_t n = strlen(src);
+
+	struct utf_out out;
+	utf_out_init(&out, dst, sizeof(uint32_t), len);
+
+	for (size_t i = 0; i < n;) {
+		size_t run = utf8_ascii(s + i, n - i);
+
+		if (run > 0) {
+			size_t w = utf_out_room(&out, run);
+
+			for (size_t x = 0; x < w; x++)
+				dst[out.written + x] = s[i + x];
+
+			utf_out_advance(&out, w, run);
+			i += run;
+			continue;
+		}
+
+		uint32_t cp = utf8_decode(s, n, &i);
+
+		if (cp == UTF_INVALID) {
+			if (!lossy)
+				return utf_out_finish(&out, false);
+
+			cp = UTF_REPLACEMENT;
+			i++;
+		}
+
+		utf_out_write(&out, &cp, 1);
+	}
+
+	return utf_out_finish(&out, true);
+}
+
+static size_t utf32_to_utf8(const uint32_t *src, char *dst, size_t len, bool lossy)
+{
+	size_t n = utf32_len(src);
+
+	struct utf_out out;
+	utf_out_init(&out, dst, 1, len);
+
+	for (size_t i = 0; i < n;) {
+		size_t run = utf32_ascii(src + i, n - i);
+
+		if (run > 0) {
+			size_t w = utf_out_room(&out, run);
+
+			for (size_t x = 0; x < w; x++)
+				dst[out.written + x] = (char) src[i + x];
+
+			utf_out_advance(&out, w, run);
+			i += run;
+			continue;
+		}
+
+		uint32_t cp = src[i++];
+
+		if (!utf_valid(cp)) {
+			if (!lossy)
+				return utf_out_finish(&out, false);
+
+			cp = UTF_REPLACEMENT;
+		}
+
+		uint8_t units[4];
+		utf_out_write(&out, units, utf8_encode(cp, units));
+	}
+
+	return utf_out_finish(&out, true);
+}
+
+
+// Public
+
+size_t MTY_UTF8ToUTF16(const char *src, uint16_t *dst, size_t len)
+{
+	return utf8_to_utf16(src, dst, len, false);
+}
+
+size_t MTY_UTF16ToUTF8(const uint16_t *src, char *dst, size_t len)
+{
+	return utf16_to_utf8(src, dst, len, false);
+}
+
+size_t MTY_UTF8ToUTF32(const char *src, uint32_t *dst, size_t len)
+{
+	return utf8_to_utf32(src, dst, len, false);
+}
+
+size_t MTY_UTF32ToUTF8(const uint32_t *src, char *dst, size_t len)
+{
+	return utf32_to_utf8(src, dst, len, false);
+}
+
+
+// wchar_t is UTF-16 on Windows and UTF-32 everywhere else. Invalid input is replaced
+// rather than rejected so a name that can't round trip still converts
+
+bool MTY_WideToMulti(const wchar_t *src, char *dst, size_t len)
+{
+	#if WCHAR_MAX > 0xFFFF
+		size_t n = utf32_to_utf8((const uint32_t *) src, dst, len, true);
+	#else
+		size_t n = utf16_to_utf8((const uint16_t *) src, dst, len, true);
+	#endif
+
+	return n > 0;
+}
+
+char *MTY_WideToMultiD(const wchar_t *src)
+{
+	if (!src)
+		return NULL;
+
+	#if WCHAR_MAX > 0xFFFF
+		size_t len = utf32_to_utf8((const uint32_t *) src, NULL, 0, true);
+	#else
+		size_t len = utf16_to_utf8((const uint16_t *) src, NULL, 0, true);
+	#endif
+
+	char *dst = MTY_Alloc(len > 0 ? len : 1, 1);
+
+	if (len > 0)
+		MTY_WideToMulti(src, dst, len);
+
+	return dst;
+}
+
+bool MTY_MultiToWide(const char *src, wchar_t *dst, uint32_t len)
+{
+	#if WCHAR_MAX > 0xFFFF
+		size_t n = utf8_to_utf32(src, (uint32_t *) dst, len, true);
+	#else
+		size_t n = utf8_to_utf16(src, (uint16_t *) dst, len, true);
+	#endif
+
+	return n > 0;
+}
+
+wchar_t *MTY_MultiToWideD(const char *src)
+{
+	if (!src)
+		return NULL;
+
+	#if WCHAR_MAX > 0xFFFF
+		size_t len = utf8_to_utf32(src, NULL, 0, true);
+	#else
+		size_t len = utf8_to_utf16(src, NULL, 0, true);
+	#endif
+
+	wchar_t *dst = MTY_Alloc(len > 0 ? len : 1, sizeof(wchar_t));
+
+	if (len > 0)
+		MTY_MultiToWide(src, dst, (uint32_t) len);
+
+	return dst;
+}
@@ -0,0 +1,225 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "matoya.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define VEC_MIN_CAPACITY 8
+
+struct MTY_Vec {
+	size_t elsize;
+	size_t len;
+	size_t cap;
+	uint8_t *data;
+};
+
+struct MTY_StrBuf {
+	size_t len;
+	size_t cap;
+	char *str;
+};
+
+static size_t vec_grow(size_t cap, size_t need, size_t elsize)
+{
+	// The capacity in bytes must fit in a size_t
+	size_t max = SIZE_MAX / (elsize > 0 ? elsize : 1);
+
+	if (need > max)
+		MTY_Fatal("Capacity of %zu elements of %zu bytes overflows", need, elsize);
+
+	size_t new_cap = cap > 0 ? cap : VEC_MIN_CAPACITY;
+
+	while (new_cap < need)
+		new_cap = new_cap > max / 2 ? max : new_cap * 2;
+
+	return new_cap < max ? new_cap : max;
+}
+
+
+// Vec
+
+MTY_Vec *MTY_VecCreate(size_t elsize, size_t reserve)
+{
+	MTY_Vec *ctx = MTY_Alloc(1, sizeof(MTY_Vec));
+	ctx->elsize = elsize;
+
+	MTY_VecReserve(ctx, reserve);
+
+	return ctx;
+}
+
+void MTY_VecReserve(MTY_Vec *ctx, size_t len)
+{
+	if (len <= ctx->cap)
+		return;
+
+	size_t cap = vec_grow(ctx->cap, len, ctx->elsize);
+
+	ctx->data = MTY_ReallocSized(ctx->data, ctx->cap * ctx->elsize, cap, ctx->elsize);
+	ctx->cap = cap;
+}
+
+void *MTY_VecPush(MTY_Vec *ctx)
+{
+	MTY_VecReserve(ctx, ctx->len + 1);
+
+	void *el = ctx->data + ctx->len++ * ctx->elsize;
+	memset(el, 0, ctx->elsize);
+
+	return el;
+}
+
+void MTY_VecAppend(MTY_Vec *ctx, const void *elements, size_t len)
+{
+	MTY_VecReserve(ctx, ctx->len + len);
+
+	memcpy(ctx->data + ctx->len * ctx->elsize, elements, len * ctx->elsize);
+	ctx->len += len;
+}
+
+void *MTY_VecGet(MTY_Vec *ctx, size_t index)
+{
+	return index < ctx->len ? ctx->data + index * ctx->elsize : NULL;
+}
+
+void *MTY_VecGetData(MTY_Vec *ctx)
+{
+	return ctx->data;
+}
+
+size_t MTY_VecLength(MTY_Vec *ctx)
+{
+	return ctx->len;
+}
+
+void MTY_VecClear(MTY_Vec *ctx)
+{
+	ctx->len = 0;
+}
+
+void *MTY_VecDetach(MTY_Vec **vec, size_t *len)
+{
+	if (!vec || !*vec)
+		return NULL;
+
+	MTY_Vec *ctx = *vec;
+	void *data = ctx->data;
+
+	if (len)
+		*len = ctx->len;
+
+	MTY_Free(ctx);
+	*vec = NULL;
+
+	return data;
+}
+
+void MTY_VecDestroy(MTY_Vec **vec)
+{
+	MTY_Free(MTY_VecDetach(vec, NULL));
+}
+
+
+// StrBuf
+
+MTY_StrBuf *MTY_StrBufCreate(size_t reserve)
+{
+	MTY_StrBuf *ctx = MTY_Alloc(1, sizeof(MTY_StrBuf));
+
+	// Always keep room for the null terminator so the string is valid when empty
+	MTY_StrBufReserve(ctx, reserve);
+
+	return ctx;
+}
+
+void MTY_StrBufReserve(MTY_StrBuf *ctx, size_t len)
+{
+	if (len + 1 <= ctx->cap)
+		return;
+
+	size_t cap = vec_grow(ctx->cap, len + 1, 1);
+
+	ctx->str = MTY_ReallocSized(ctx->str, ctx->cap, cap, 1);
+	ctx->str[ctx->len] = '\0';
+	ctx->cap = cap;
+}
+
+void MTY_StrBufAppendLen(MTY_StrBuf *ctx, const char *str, size_t len)
+{
+	MTY_StrBufReserve(ctx, ctx->len + len);
+
+	memcpy(ctx->str + ctx->len, str, len);
+	ctx->len += len;
+	ctx->str[ctx->len] = '\0';
+}
+
+void MTY_StrBufAppend(MTY_StrBuf *ctx, const char *str)
+{
+	MTY_StrBufAppendLen(ctx, str, strlen(str));
+}
+
+void MTY_StrBufPrintf(MTY_StrBuf *ctx, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+
+	va_list args_copy;
+	va_copy(args_copy, args);
+
+	size_t avail = ctx->cap - ctx->len;
+	int32_t n = vsnprintf(ctx->str + ctx->len, avail, fmt, args);
+
+	if (n >= 0 && (size_t) n >= avail) {
+		MTY_StrBufReserve(ctx, ctx->len + n);
+		n = vsnprintf(ctx->str + ctx->len, ctx->cap - ctx->len, fmt, args_copy);
+	}
+
+	if (n > 0)
+		ctx->len += n;
+
+	ctx->str[ctx->len] = '\0';
+
+	va_end(args_copy);
+	va_end(args);
+}
+
+const char *MTY_StrBufGet(MTY_StrBuf *ctx)
+{
+	return ctx->str;
+}
+
+size_t MTY_StrBufLength(MTY_StrBuf *ctx)
+{
+	return ctx->len;
+}
+
+void MTY_StrBufClear(MTY_StrBuf *ctx)
+{
+	ctx->len = 0;
+	ctx->str[0] = '\0';
+}
+
+char *MTY_StrBufDetach(MTY_StrBuf **sb)
+{
+	if (!sb || !*sb)
+		return NULL;
+
+	MTY_StrBuf *ctx = *sb;
+	char *str = ctx->str;
+
+	MTY_Free(ctx);
+	*sb = NULL;
+
+	return str;
+}
+
+void MTY_StrBufDestroy(MTY_StrBuf **sb)
+{
+	MTY_Free(MTY_StrBufDetach(sb));
+}
@@ -12,6 +12,8 @@
 #include <windows.h>
 #include <bcrypt.h>
 
+#include "metrics.h"
+
 struct MTY_AESGCM {
 	BCRYPT_ALG_HANDLE ahandle;
 	BCRYPT_KEY_HANDLE khandle;
@@ -62,11 +64,20 @@ bool MTY_AESGCMEncrypt(MTY_AESGCM *ctx, const void *nonce, const void *plainText
 	info.pbTag = hash;
 	info.cbTag = 16;
 
+	MTY_ProfileBegin("MTY_AESGCMEncrypt");
+
 	ULONG output = 0;
 	NTSTATUS e = BCryptEncrypt(ctx->khandle, (UCHAR *) plainText, (ULONG) size, &info,
 		NULL, 0, cipherText, (ULONG) size, &output, 0);
 
-	return e == STATUS_SUCCESS;
+	MTY_ProfileEnd();
+
+	if (e != STATUS_SUCCESS)
+		return false;
+
+	metrics_encrypted(size);
+
+	return true;
 }
 
 bool MTY_AESGCMDecrypt(MTY_AESGCM *ctx, const void *nonce, const void *cipherText, size_t size,
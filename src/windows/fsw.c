@@ -201,10 +201,11 @@ MTY_LockFile *MTY_LockFileCreate(const char *path, MTY_FileMode mode)
 	DWORD access = GENERIC_READ;
 	DWORD create = OPEN_EXISTING;
 
-	if (mode == MTY_FILE_MODE_WRITE) {
+	// Any mode that writes takes the lock exclusively, only MTY_FILE_MODE_WRITE truncates
+	if (mode == MTY_FILE_MODE_WRITE || mode == MTY_FILE_MODE_APPEND || mode == MTY_FILE_MODE_READ_WRITE) {
 		share = 0;
 		access = GENERIC_WRITE;
-		create = CREATE_ALWAYS;
+		create = mode == MTY_FILE_MODE_WRITE ? CREATE_ALWAYS : OPEN_ALWAYS;
 	}
 
 	wchar_t *pathw = MTY_MultiToWideD(path);
@@ -232,6 +233,76 @@ void MTY_LockFileDestroy(MTY_LockFile **lock)
 	*lock = NULL;
 }
 
+void *MTY_MapFile(const char *path, MTY_MapFlag flags, size_t *size)
+{
+	size_t tmp = 0;
+	if (!size)
+		size = &tmp;
+
+	*size = 0;
+
+	bool rw = flags & MTY_MAP_READ_WRITE;
+
+	// The cache manager reads ahead more aggressively for sequential scans
+	DWORD attrs = (flags & MTY_MAP_SEQUENTIAL) ? FILE_FLAG_SEQUENTIAL_SCAN :
+		(flags & MTY_MAP_RANDOM) ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL;
+
+	wchar_t *pathw = MTY_MultiToWideD(path);
+	HANDLE f = CreateFile(pathw, GENERIC_READ | (rw ? GENERIC_WRITE : 0), FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL, OPEN_EXISTING, attrs, NULL);
+	MTY_Free(pathw);
+
+	if (f == INVALID_HANDLE_VALUE) {
+		MTY_Log("'CreateFile' failed with error 0x%X", GetLastError());
+		return NULL;
+	}
+
+	void *mem = NULL;
+	HANDLE mapping = NULL;
+
+	LARGE_INTEGER fsize = {0};
+	if (!GetFileSizeEx(f, &fsize)) {
+		MTY_Log("'GetFileSizeEx' failed with error 0x%X", GetLastError());
+		goto except;
+	}
+
+	if (fsize.QuadPart == 0)
+		goto except;
+
+	mapping = CreateFileMapping(f, NULL, rw ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		MTY_Log("'CreateFileMapping' failed with error 0x%X", GetLastError());
+		goto except;
+	}
+
+	mem = MapViewOfFile(mapping, rw ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+	if (!mem) {
+		MTY_Log("'MapViewOfFile' failed with error 0x%X", GetLastError());
+		goto except;
+	}
+
+	*size = (size_t) fsize.QuadPart;
+
+	except:
+
+	// The view holds its own references to the mapping and file
+	if (mapping)
+		CloseHandle(mapping);
+
+	CloseHandle(f);
+
+	return mem;
+}
+
+void MTY_UnmapFile(void *mem, size_t size)
+{
+	if (!mem)
+		return;
+
+	if (!UnmapViewOfFile(mem))
+		MTY_Log("'UnmapViewOfFile' failed with error 0x%X", GetLastError());
+}
+
 const char *MTY_GetFileName(const char *path, bool extension)
 {
 	const char *name = strrchr(path, '\\');
@@ -279,6 +350,7 @@ static int32_t fs_file_compare(const void *p1, const void *p2)
 MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 {
 	MTY_FileList *fl = MTY_Alloc(1, sizeof(MTY_FileList));
+	MTY_Vec *files = MTY_VecCreate(sizeof(MTY_FileDesc), 0);
 	char *pathd = MTY_Strdup(path);
 
 	WIN32_FIND_DATA ent;
@@ -295,13 +367,12 @@ MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 		bool is_dir = ent.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
 
 		if (is_dir || wcsstr(namew, filterw ? filterw : L"")) {
-			fl->files = MTY_Realloc(fl->files, fl->len + 1, sizeof(MTY_FileDesc));
-
 			char *name = MTY_WideToMultiD(namew);
-			fl->files[fl->len].name = name;
-			fl->files[fl->len].path = MTY_Strdup(MTY_Path(pathd, name));
-			fl->files[fl->len].dir = is_dir;
-			fl->len++;
+
+			MTY_FileDesc *desc = MTY_VecPush(files);
+			desc->name = name;
+			desc->path = MTY_Strdup(MTY_Path(pathd, name));
+			desc->dir = is_dir;
 		}
 
 		ok = FindNextFile(dir, &ent);
@@ -313,6 +384,10 @@ MTY_FileList *MTY_GetFileList(const char *path, const char *filter)
 	MTY_Free(filterw);
 	MTY_Free(pathd);
 
+	size_t len = 0;
+	fl->files = MTY_VecDetach(&files, &len);
+	fl->len = (uint32_t) len;
+
 	if (fl->len > 0)
 		MTY_Sort(fl->files, fl->len, sizeof(MTY_FileDesc), fs_file_compare);
 
@@ -4,26 +4,18 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
-#include "matoya.h"
+#include "mem-sys.h"
 
-#include <stdio.h>
 #include <stdlib.h>
 
 #include <winsock2.h>
 
-void *MTY_AllocAligned(size_t size, size_t align)
+void *mem_sys_aligned_alloc(size_t size, size_t align)
 {
-	void *mem = _aligned_malloc(size, align);
-
-	if (!mem)
-		MTY_Fatal("'_aligned_malloc' failed");
-
-	memset(mem, 0, size);
-
-	return mem;
+	return _aligned_malloc(size, align);
 }
 
-void MTY_FreeAligned(void *mem)
+void mem_sys_aligned_free(void *mem)
 {
 	_aligned_free(mem);
 }
@@ -72,43 +64,3 @@ uint64_t MTY_SwapFromBE64(uint64_t value)
 {
 	return ntohll(value);
 }
-
-bool MTY_WideToMulti(const wchar_t *src, char *dst, size_t len)
-{
-	int32_t n = WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, src, -1, dst,
-		(int32_t) len, NULL, NULL);
-
-	// WideCharToMultiByte will null terminate the output if -1 is supplied for the 'src' length,
-	// otherwise it will fail
-	if (n <= 0) {
-		DWORD e = GetLastError();
-		if (e != ERROR_NO_UNICODE_TRANSLATION)
-			MTY_Log("'WideCharToMultiByte' failed with error 0x%X", e);
-
-		// Fall back to current code page translation
-		snprintf(dst, len, "%ls", src);
-		return false;
-	}
-
-	return true;
-}
-
-bool MTY_MultiToWide(const char *src, wchar_t *dst, uint32_t len)
-{
-	int32_t n = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, src, -1, dst,
-		(int32_t) len);
-
-	// MutliByteToWideChar will null terminate the output if -1 is supplied for the 'src' length,
-	// otherwise it will fail
-	if (n <= 0) {
-		DWORD e = GetLastError();
-		if (e != ERROR_NO_UNICODE_TRANSLATION)
-			MTY_Log("'MultiByteToWideChar' failed with error 0x%X", e);
-
-		// Fall back to current code page translation
-		_snwprintf_s(dst, len, _TRUNCATE, L"%hs", src);
-		return false;
-	}
-
-	return true;
-}
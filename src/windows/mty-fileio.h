@@ -0,0 +1,141 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <windows.h>
+
+#define MTY_FILEIO_INVALID ((intptr_t) INVALID_HANDLE_VALUE)
+#define MTY_FILEIO_CHUNK   (1024 * 1024 * 1024)
+
+static intptr_t mty_fileio_open(const char *path, MTY_FileMode mode)
+{
+	DWORD access = GENERIC_READ;
+	DWORD create = OPEN_EXISTING;
+
+	switch (mode) {
+		case MTY_FILE_MODE_WRITE:
+			access = GENERIC_WRITE;
+			create = CREATE_ALWAYS;
+			break;
+		case MTY_FILE_MODE_APPEND:
+			// Without the rest of GENERIC_WRITE every write lands at the end of the file
+			access = FILE_APPEND_DATA;
+			create = OPEN_ALWAYS;
+			break;
+		case MTY_FILE_MODE_READ_WRITE:
+			access = GENERIC_READ | GENERIC_WRITE;
+			create = OPEN_ALWAYS;
+			break;
+		default:
+			break;
+	}
+
+	wchar_t *pathw = MTY_MultiToWideD(path);
+	HANDLE f = CreateFile(pathw, access, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, create,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	MTY_Free(pathw);
+
+	if (f == INVALID_HANDLE_VALUE) {
+		MTY_Log("'CreateFile' failed to open '%s' with error 0x%X", MTY_GetFileName(path, true), GetLastError());
+		return MTY_FILEIO_INVALID;
+	}
+
+	return (intptr_t) f;
+}
+
+static int64_t mty_fileio_seek(intptr_t f, int64_t offset, MTY_Seek whence)
+{
+	DWORD w = whence == MTY_SEEK_CUR ? FILE_CURRENT : whence == MTY_SEEK_END ? FILE_END : FILE_BEGIN;
+
+	LARGE_INTEGER dist = {0};
+	dist.QuadPart = offset;
+
+	LARGE_INTEGER pos = {0};
+	if (!SetFilePointerEx((HANDLE) f, dist, &pos, w)) {
+		MTY_Log("'SetFilePointerEx' failed with error 0x%X", GetLastError());
+		return -1;
+	}
+
+	return pos.QuadPart;
+}
+
+static int64_t mty_fileio_read(intptr_t f, void *data, size_t size, int64_t offset)
+{
+	// Positional IO on a synchronous handle still moves the file pointer
+	int64_t cur = offset >= 0 ? mty_fileio_seek(f, 0, MTY_SEEK_CUR) : 0;
+	if (cur < 0)
+		return -1;
+
+	size_t total = 0;
+
+	while (total < size) {
+		DWORD chunk = (DWORD) (size - total > MTY_FILEIO_CHUNK ? MTY_FILEIO_CHUNK : size - total);
+
+		OVERLAPPED ov = {0};
+		ov.Offset = (DWORD) (offset + total);
+		ov.OffsetHigh = (DWORD) ((uint64_t) (offset + total) >> 32);
+
+		DWORD n = 0;
+		if (!ReadFile((HANDLE) f, (uint8_t *) data + total, chunk, &n, offset >= 0 ? &ov : NULL)) {
+			DWORD e = GetLastError();
+
+			if (e == ERROR_HANDLE_EOF)
+				break;
+
+			MTY_Log("'ReadFile' failed with error 0x%X", e);
+			total = SIZE_MAX;
+			break;
+		}
+
+		if (n == 0)
+			break;
+
+		total += n;
+	}
+
+	if (offset >= 0)
+		mty_fileio_seek(f, cur, MTY_SEEK_SET);
+
+	return total == SIZE_MAX ? -1 : (int64_t) total;
+}
+
+static bool mty_fileio_write(intptr_t f, const void *data, size_t size, int64_t offset)
+{
+	int64_t cur = offset >= 0 ? mty_fileio_seek(f, 0, MTY_SEEK_CUR) : 0;
+	if (cur < 0)
+		return false;
+
+	bool r = true;
+
+	for (size_t total = 0; total < size;) {
+		DWORD chunk = (DWORD) (size - total > MTY_FILEIO_CHUNK ? MTY_FILEIO_CHUNK : size - total);
+
+		OVERLAPPED ov = {0};
+		ov.Offset = (DWORD) (offset + total);
+		ov.OffsetHigh = (DWORD) ((uint64_t) (offset + total) >> 32);
+
+		DWORD n = 0;
+		if (!WriteFile((HANDLE) f, (const uint8_t *) data + total, chunk, &n, offset >= 0 ? &ov : NULL)) {
+			MTY_Log("'WriteFile' failed with error 0x%X", GetLastError());
+			r = false;
+			break;
+		}
+
+		total += n;
+	}
+
+	if (offset >= 0)
+		mty_fileio_seek(f, cur, MTY_SEEK_SET);
+
+	return r;
+}
+
+static void mty_fileio_close(intptr_t f)
+{
+	if (!CloseHandle((HANDLE) f))
+		MTY_Log("'CloseHandle' failed with error 0x%X", GetLastError());
+}
@@ -0,0 +1,25 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <windows.h>
+
+static void mty_futex_wait(MTY_Atomic32 *addr, int32_t value)
+{
+	if (!WaitOnAddress(&addr->value, &value, sizeof(int32_t), INFINITE))
+		MTY_Fatal("'WaitOnAddress' failed with error 0x%X", GetLastError());
+}
+
+static void mty_futex_wake(MTY_Atomic32 *addr, bool all)
+{
+	if (all) {
+		WakeByAddressAll((PVOID) &addr->value);
+
+	} else {
+		WakeByAddressSingle((PVOID) &addr->value);
+	}
+}
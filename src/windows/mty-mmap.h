@@ -0,0 +1,50 @@
+// Copyright (c) 2020 Christopher D. Dickson <cdd@matoya.group>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <windows.h>
+
+static void *mty_mmap(size_t size)
+{
+	void *mem = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+	if (!mem)
+		MTY_Fatal("'VirtualAlloc' failed with error 0x%X", GetLastError());
+
+	return mem;
+}
+
+static void mty_munmap(void *mem, size_t size)
+{
+	if (!VirtualFree(mem, 0, MEM_RELEASE))
+		MTY_Log("'VirtualFree' failed with error 0x%X", GetLastError());
+}
+
+static void *mty_mmap_huge(size_t size)
+{
+	// Requires SeLockMemoryPrivilege, otherwise fall back to normal pages
+	SIZE_T large = GetLargePageMinimum();
+
+	if (large > 0 && size % large == 0) {
+		void *mem = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+		if (mem)
+			return mem;
+	}
+
+	return mty_mmap(size);
+}
+
+static bool mty_mlock(void *mem, size_t size)
+{
+	if (!VirtualLock(mem, size)) {
+		MTY_Log("'VirtualLock' failed with error 0x%X", GetLastError());
+		return false;
+	}
+
+	return true;
+}
@@ -6,10 +6,17 @@
 
 #include "matoya.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <windows.h>
 
+#include "lock-prof.h"
+#include "thread-exit.h"
+
+#define THREAD_NAME_MAX 64
+
 
 // Thread
 
@@ -19,12 +26,58 @@ struct MTY_Thread {
 	void *(*func)(void *opaque);
 	void *opaque;
 	void *ret;
+
+	char name[THREAD_NAME_MAX];
+	uint64_t affinity;
+	MTY_ThreadPriority priority;
 };
 
+static void thread_set_name(const char *name)
+{
+	// SetThreadDescription is only available on Windows 10 1607+
+	HRESULT (WINAPI *_SetThreadDescription)(HANDLE hThread, PCWSTR lpThreadDescription) =
+		(void *) GetProcAddress(GetModuleHandle(L"kernel32.dll"), "SetThreadDescription");
+
+	if (!_SetThreadDescription)
+		return;
+
+	wchar_t *namew = MTY_MultiToWideD(name);
+
+	HRESULT e = _SetThreadDescription(GetCurrentThread(), namew);
+	if (e != S_OK)
+		MTY_Log("'SetThreadDescription' failed with HRESULT 0x%X", e);
+
+	MTY_Free(namew);
+}
+
+static void thread_set_priority(MTY_ThreadPriority priority)
+{
+	int32_t p = THREAD_PRIORITY_NORMAL;
+
+	switch (priority) {
+		case MTY_THREAD_PRIORITY_LOW:      p = THREAD_PRIORITY_BELOW_NORMAL;  break;
+		case MTY_THREAD_PRIORITY_HIGH:     p = THREAD_PRIORITY_HIGHEST;       break;
+		case MTY_THREAD_PRIORITY_REALTIME: p = THREAD_PRIORITY_TIME_CRITICAL; break;
+	}
+
+	if (!SetThreadPriority(GetCurrentThread(), p))
+		MTY_Log("'SetThreadPriority' failed with error 0x%X", GetLastError());
+}
+
 static DWORD WINAPI thread_func(LPVOID *lpParameter)
 {
 	MTY_Thread *ctx = (MTY_Thread *) lpParameter;
 
+	if (ctx->name[0])
+		thread_set_name(ctx->name);
+
+	if (ctx->affinity != 0)
+		if (!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) ctx->affinity))
+			MTY_Log("'SetThreadAffinityMask' failed with error 0x%X", GetLastError());
+
+	if (ctx->priority != MTY_THREAD_PRIORITY_NORMAL)
+		thread_set_priority(ctx->priority);
+
 	ctx->ret = ctx->func(ctx->opaque);
 
 	if (ctx->detach)
@@ -33,14 +86,27 @@ static DWORD WINAPI thread_func(LPVOID *lpParameter)
 	return 0;
 }
 
-static MTY_Thread *thread_create(void *(*func)(void *opaque), const void *opaque, bool detach)
+static MTY_Thread *thread_create(void *(*func)(void *opaque), const void *opaque, bool detach,
+	const MTY_ThreadDesc *desc)
 {
 	MTY_Thread *ctx = MTY_Alloc(1, sizeof(MTY_Thread));
 	ctx->func = func;
 	ctx->opaque = (void *) opaque;
 	ctx->detach = detach;
 
-	ctx->thread = CreateThread(NULL, 0, thread_func, ctx, 0, NULL);
+	SIZE_T stack_size = 0;
+
+	if (desc) {
+		if (desc->name)
+			snprintf(ctx->name, THREAD_NAME_MAX, "%s", desc->name);
+
+		ctx->affinity = desc->affinity;
+		ctx->priority = desc->priority;
+		stack_size = desc->stackSize;
+	}
+
+	ctx->thread = CreateThread(NULL, stack_size, thread_func, ctx,
+		stack_size > 0 ? STACK_SIZE_PARAM_IS_A_RESERVATION : 0, NULL);
 
 	if (!ctx->thread)
 		MTY_Fatal("'CreateThread' failed with error 0x%X", GetLastError());
@@ -58,15 +124,20 @@ static MTY_Thread *thread_create(void *(*func)(void *opaque), const void *opaque
 
 MTY_Thread *MTY_ThreadCreate(void *(*func)(void *opaque), const void *opaque)
 {
-	return thread_create(func, opaque, false);
+	return thread_create(func, opaque, false, NULL);
+}
+
+MTY_Thread *MTY_ThreadCreateEx(void *(*func)(void *opaque), const void *opaque, const MTY_ThreadDesc *desc)
+{
+	return thread_create(func, opaque, false, desc);
 }
 
 void MTY_ThreadDetach(void *(*func)(void *opaque), const void *opaque)
 {
-	thread_create(func, opaque, true);
+	thread_create(func, opaque, true, NULL);
 }
 
-int64_t MTY_ThreadIDGet(MTY_Thread *ctx)
+int64_t MTY_ThreadGetID(MTY_Thread *ctx)
 {
 	return ctx ? GetThreadId(ctx->thread) : GetCurrentThreadId();
 }
@@ -95,33 +166,174 @@ void *MTY_ThreadDestroy(MTY_Thread **thread)
 }
 
 
+// Exit hooks
+
+struct thread_exit {
+	struct thread_exit *next;
+	void (*func)(void *opaque);
+	void *opaque;
+};
+
+static DWORD THREAD_EXIT_INDEX = FLS_OUT_OF_INDEXES;
+static MTY_Atomic32 THREAD_EXIT_ONCE;
+
+static void WINAPI thread_exit_run(void *value)
+{
+	for (struct thread_exit *hook = value; hook;) {
+		struct thread_exit *next = hook->next;
+
+		hook->func(hook->opaque);
+		MTY_Free(hook);
+
+		hook = next;
+	}
+}
+
+static void thread_exit_init(void *opaque)
+{
+	// Fiber local storage callbacks also run when a thread exits
+	THREAD_EXIT_INDEX = FlsAlloc(thread_exit_run);
+	if (THREAD_EXIT_INDEX == FLS_OUT_OF_INDEXES)
+		MTY_Fatal("'FlsAlloc' failed with error 0x%X", GetLastError());
+}
+
+void thread_exit_hook(void (*func)(void *opaque), void *opaque)
+{
+	MTY_Once(&THREAD_EXIT_ONCE, thread_exit_init, NULL);
+
+	struct thread_exit *hook = MTY_Alloc(1, sizeof(struct thread_exit));
+	hook->func = func;
+	hook->opaque = opaque;
+	hook->next = FlsGetValue(THREAD_EXIT_INDEX);
+
+	if (!FlsSetValue(THREAD_EXIT_INDEX, hook))
+		MTY_Fatal("'FlsSetValue' failed with error 0x%X", GetLastError());
+}
+
+
+// CPU
+
+void MTY_GetCPUTopology(MTY_CPUTopology *topology)
+{
+	memset(topology, 0, sizeof(MTY_CPUTopology));
+
+	DWORD size = 0;
+	GetLogicalProcessorInformation(NULL, &size);
+
+	SYSTEM_LOGICAL_PROCESSOR_INFORMATION *info = MTY_Alloc(size, 1);
+
+	if (GetLogicalProcessorInformation(info, &size)) {
+		for (DWORD x = 0; x < size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION); x++) {
+			SYSTEM_LOGICAL_PROCESSOR_INFORMATION *i = &info[x];
+
+			switch (i->Relationship) {
+				case RelationProcessorPackage:
+					topology->packages++;
+					break;
+				case RelationProcessorCore:
+					topology->cores++;
+
+					for (ULONG_PTR m = i->ProcessorMask; m; m &= m - 1)
+						topology->threads++;
+
+					// The lowest set bit is the primary logical processor of the core
+					topology->coreMask |= i->ProcessorMask & (~i->ProcessorMask + 1);
+					break;
+				case RelationCache:
+					if (i->Cache.Type == CacheInstruction)
+						break;
+
+					topology->cacheLine = i->Cache.LineSize;
+
+					switch (i->Cache.Level) {
+						case 1: topology->cacheL1 = i->Cache.Size; break;
+						case 2: topology->cacheL2 = i->Cache.Size; break;
+						case 3: topology->cacheL3 = i->Cache.Size; break;
+					}
+					break;
+			}
+		}
+	} else {
+		MTY_Log("'GetLogicalProcessorInformation' failed with error 0x%X", GetLastError());
+	}
+
+	MTY_Free(info);
+
+	if (topology->threads == 0)
+		topology->threads = 1;
+
+	if (topology->cores == 0)
+		topology->cores = topology->threads;
+
+	if (topology->packages == 0)
+		topology->packages = 1;
+
+	if (topology->cacheLine == 0)
+		topology->cacheLine = 64;
+
+	if (topology->coreMask == 0)
+		topology->coreMask = 1;
+}
+
+
 // Mutex
 
 struct MTY_Mutex {
 	CRITICAL_SECTION mutex;
+	struct lock_prof *prof;
+	int64_t acquired;
 };
 
-MTY_Mutex *MTY_MutexCreate(void)
+MTY_Mutex *MTY_MutexCreateNamed(const char *name)
 {
 	MTY_Mutex *ctx = MTY_Alloc(1, sizeof(MTY_Mutex));
+	ctx->prof = lock_prof_get(name);
 
 	InitializeCriticalSection(&ctx->mutex);
 
 	return ctx;
 }
 
+MTY_Mutex *MTY_MutexCreate(void)
+{
+	return MTY_MutexCreateNamed(NULL);
+}
+
 void MTY_MutexLock(MTY_Mutex *ctx)
 {
-	EnterCriticalSection(&ctx->mutex);
+	if (!lock_prof_active(ctx->prof)) {
+		EnterCriticalSection(&ctx->mutex);
+		return;
+	}
+
+	int64_t begin = MTY_Timestamp();
+	bool contended = !TryEnterCriticalSection(&ctx->mutex);
+
+	if (contended)
+		EnterCriticalSection(&ctx->mutex);
+
+	// Critical sections are recursive, only the outermost lock is measured
+	if (ctx->mutex.RecursionCount == 1)
+		ctx->acquired = lock_prof_acquired(ctx->prof, contended, begin);
 }
 
 bool MTY_MutexTryLock(MTY_Mutex *ctx)
 {
-	return TryEnterCriticalSection(&ctx->mutex);
+	bool r = TryEnterCriticalSection(&ctx->mutex);
+
+	if (r && ctx->mutex.RecursionCount == 1 && lock_prof_active(ctx->prof))
+		ctx->acquired = lock_prof_acquired(ctx->prof, false, 0);
+
+	return r;
 }
 
 void MTY_MutexUnlock(MTY_Mutex *ctx)
 {
+	if (ctx->acquired != 0 && ctx->mutex.RecursionCount == 1) {
+		lock_prof_released(ctx->prof, ctx->acquired);
+		ctx->acquired = 0;
+	}
+
 	LeaveCriticalSection(&ctx->mutex);
 }
 
@@ -143,22 +355,41 @@ void MTY_MutexDestroy(MTY_Mutex **mutex)
 
 struct MTY_Cond {
 	CONDITION_VARIABLE cond;
+	struct lock_prof *prof;
 };
 
-MTY_Cond *MTY_CondCreate(void)
+MTY_Cond *MTY_CondCreateNamed(const char *name)
 {
 	MTY_Cond *ctx = MTY_Alloc(1, sizeof(MTY_Cond));
+	ctx->prof = lock_prof_get(name);
 
 	InitializeConditionVariable(&ctx->cond);
 
 	return ctx;
 }
 
+MTY_Cond *MTY_CondCreate(void)
+{
+	return MTY_CondCreateNamed(NULL);
+}
+
 bool MTY_CondWait(MTY_Cond *ctx, MTY_Mutex *mutex, int32_t timeout)
 {
 	bool r = true;
 	timeout = timeout < 0 ? INFINITE : timeout;
 
+	// The mutex is released for the duration of the wait, so it should not count
+	// towards its hold time
+	bool relock = mutex->acquired != 0;
+
+	if (relock) {
+		lock_prof_released(mutex->prof, mutex->acquired);
+		mutex->acquired = 0;
+	}
+
+	bool active = lock_prof_active(ctx->prof);
+	int64_t begin = active ? MTY_Timestamp() : 0;
+
 	BOOL success = SleepConditionVariableCS(&ctx->cond, &mutex->mutex, timeout);
 
 	if (!success) {
@@ -172,6 +403,13 @@ bool MTY_CondWait(MTY_Cond *ctx, MTY_Mutex *mutex, int32_t timeout)
 		}
 	}
 
+	if (active)
+		lock_prof_waited(ctx->prof, !r, begin);
+
+	// Only the hold time restarts, waking is not a new acquisition
+	if (relock)
+		mutex->acquired = MTY_Timestamp();
+
 	return r;
 }
 
@@ -10,9 +10,23 @@
 #include <timeapi.h>
 
 #include "mty-tls.h"
+#include "thread-exit.h"
+#include "time-sleep.h"
 
-static MTY_TLS bool TIME_FREQ_INIT;
-static MTY_TLS float TIME_FREQUENCY;
+#if !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+	#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+static MTY_Atomic32 TIME_FREQ_ONCE;
+static float TIME_FREQUENCY;
+static MTY_TLS HANDLE TIME_TIMER;
+
+static void time_frequency(void *opaque)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	TIME_FREQUENCY = (float) frequency.QuadPart / 1000.0f;
+}
 
 int64_t MTY_Timestamp(void)
 {
@@ -22,14 +36,15 @@ int64_t MTY_Timestamp(void)
 	return ts.QuadPart;
 }
 
+int64_t MTY_TimestampFast(void)
+{
+	// QueryPerformanceCounter already reads the invariant TSC in user space where available
+	return MTY_Timestamp();
+}
+
 float MTY_TimeDiff(int64_t begin, int64_t end)
 {
-	if (!TIME_FREQ_INIT) {
-		LARGE_INTEGER frequency;
-		QueryPerformanceFrequency(&frequency);
-		TIME_FREQUENCY = (float) frequency.QuadPart / 1000.0f;
-		TIME_FREQ_INIT = true;
-	}
+	MTY_Once(&TIME_FREQ_ONCE, time_frequency, NULL);
 
 	return (float) (end - begin) / TIME_FREQUENCY;
 }
@@ -61,6 +76,45 @@ void MTY_Sleep(uint32_t timeout)
 		MTY_Log("'CloseHandle' failed with error 0x%X", GetLastError());
 }
 
+static void time_timer_close(void *opaque)
+{
+	if (!CloseHandle(TIME_TIMER))
+		MTY_Log("'CloseHandle' failed with error 0x%X", GetLastError());
+
+	TIME_TIMER = NULL;
+}
+
+void time_sleep_us(uint64_t us)
+{
+	// The timer is kept for the life of the thread, precise sleeps tend to come every frame
+	if (!TIME_TIMER) {
+		// High resolution timers need Windows 10 1803, older systems get the regular kind
+		TIME_TIMER = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+
+		if (!TIME_TIMER)
+			TIME_TIMER = CreateWaitableTimer(NULL, TRUE, NULL);
+
+		if (!TIME_TIMER) {
+			MTY_Log("'CreateWaitableTimer' failed with error 0x%X", GetLastError());
+			return;
+		}
+
+		thread_exit_hook(time_timer_close, NULL);
+	}
+
+	LARGE_INTEGER ft;
+	ft.QuadPart = -10 * (int64_t) us;
+
+	if (SetWaitableTimer(TIME_TIMER, &ft, 0, NULL, NULL, FALSE)) {
+		DWORD e = WaitForSingleObject(TIME_TIMER, INFINITE);
+		if (e != WAIT_OBJECT_0)
+			MTY_Log("'WaitForSingleObject' returned %d", e);
+
+	} else {
+		MTY_Log("'SetWaitableTimer' failed with error 0x%X", GetLastError());
+	}
+}
+
 void MTY_SetTimerResolution(uint32_t res)
 {
 	MMRESULT e = timeBeginPeriod(res);